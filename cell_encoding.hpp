@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Encoding of base image texels, shared by the GPU generation passes (through shaders/cell_encoding.glsl), the CPU
+// reference volume and the volume file.
+//
+// Texels either hold a brick index in their low CELL_INDEX_BITS bits with all other bits clear, or have one of the flags
+// above them set. Bits 28 and 29 are reserved for further cell kinds, such as uniform non-default material.
+static constexpr uint32_t CELL_INDEX_BITS = 28;
+
+static constexpr uint32_t CELL_INDEX_MASK = (1u << CELL_INDEX_BITS) - 1;
+
+static constexpr uint32_t EMPTY_CELL = 0x80000000;
+
+static constexpr uint32_t FULL_CELL = 0x40000000;
+
+inline bool is_brick_cell(uint32_t value) noexcept
+{
+	return (value & ~CELL_INDEX_MASK) == 0;
+}
@@ -0,0 +1,427 @@
+#include "cpu_tracer.hpp"
+
+#include "parallel_for.hpp"
+
+#include "cell_encoding.hpp"
+
+#include <immintrin.h>
+
+#include <cmath>
+
+// Per-level constants, with level l in lane l, looked up per lane with a permute. The lane for level_cnt, which wraps
+// around to lane 0 with MAX_LEVEL_CNT levels, is only read by lanes that are already done.
+struct level_tables
+{
+	// Window bounds relative to the level's base, which is the frame base in cells of the level
+	__m256i window_min[3];
+
+	__m256i level_base[3];
+
+	__m256 cell_size;
+
+	__m256 inverse_cell_size;
+};
+
+static_assert(cpu_volume::MAX_LEVEL_CNT <= 8, "Level tables hold one lane per level");
+
+// Traces up to PACKET_SIZE rays in lockstep. Every iteration advances each unfinished lane by one base cell or brick
+// voxel, like step_ray in trace_common.glsl, except that times are kept in level 0 units throughout.
+static void trace_packet(const cpu_volume& volume, const level_tables& tables, const int32_t frame_base[3], const cpu_ray_query* queries, uint32_t ray_cnt, cpu_ray_hit* out_hits) noexcept
+{
+	const int32_t brick_dim = static_cast<int32_t>(volume.brick_dim);
+
+	const int32_t base_dim = static_cast<int32_t>(volume.base_dim);
+
+	const int32_t base_width = static_cast<int32_t>(volume.base_width);
+
+	// Shift counts for multiplying by brick_dim and its square, which are only known at runtime
+	const __m128i brick_shift = _mm_cvtsi32_si128(static_cast<int32_t>(volume.brick_dim_log2));
+
+	const __m128i brick_shift2 = _mm_cvtsi32_si128(static_cast<int32_t>(volume.brick_dim_log2 * 2));
+
+	const int32_t axis_strides[3]{ 1, base_width, base_width * base_dim };
+
+	alignas(32) float origin_lanes[3][cpu_tracer::PACKET_SIZE];
+
+	alignas(32) float direction_lanes[3][cpu_tracer::PACKET_SIZE];
+
+	alignas(32) float max_time_lanes[cpu_tracer::PACKET_SIZE];
+
+	for (uint32_t l = 0; l != cpu_tracer::PACKET_SIZE; ++l)
+	{
+		// Unused lanes trace a dummy ray, which starts out done
+		const cpu_ray_query& query = queries[l < ray_cnt ? l : 0];
+
+		const float length = sqrtf(query.direction[0] * query.direction[0] + query.direction[1] * query.direction[1] + query.direction[2] * query.direction[2]);
+
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			origin_lanes[a][l] = query.origin[a] - static_cast<float>(frame_base[a]);
+
+			// Turn -0 into +0, so that axes the ray does not move along are stepped in the positive direction with an
+			// infinite time, rather than a NaN one
+			direction_lanes[a][l] = query.direction[a] == 0.0F ? 0.0F : query.direction[a] / length;
+		}
+
+		max_time_lanes[l] = query.max_time;
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+
+	const __m256 one = _mm256_set1_ps(1.0F);
+
+	const __m256i one_i = _mm256_set1_epi32(1);
+
+	__m256 origin[3];
+
+	__m256 direction[3];
+
+	__m256 coefficient[3];
+
+	// 1 where the ray moves in the positive direction and 0 otherwise, added to the cell or voxel index to get the boundary it leaves through
+	__m256 step_offset[3];
+
+	__m256i step_sign[3];
+
+	__m256i cell[3];
+
+	__m256i voxel[3];
+
+	for (uint32_t a = 0; a != 3; ++a)
+	{
+		origin[a] = _mm256_load_ps(origin_lanes[a]);
+
+		direction[a] = _mm256_load_ps(direction_lanes[a]);
+
+		coefficient[a] = _mm256_div_ps(one, direction[a]);
+
+		const __m256 is_positive = _mm256_cmp_ps(coefficient[a], zero, _CMP_GE_OQ);
+
+		step_offset[a] = _mm256_and_ps(is_positive, one);
+
+		step_sign[a] = _mm256_sub_epi32(_mm256_and_si256(_mm256_castps_si256(is_positive), _mm256_set1_epi32(2)), one_i);
+
+		cell[a] = _mm256_cvttps_epi32(_mm256_floor_ps(origin[a]));
+
+		voxel[a] = _mm256_setzero_si256();
+	}
+
+	const __m256 max_time = _mm256_load_ps(max_time_lanes);
+
+	// Distance at which the current cell or voxel was entered, and the axis through which it was, or 3 before the first step
+	__m256 time = zero;
+
+	__m256i axis = _mm256_set1_epi32(3);
+
+	__m256i level = _mm256_setzero_si256();
+
+	__m256i brick = _mm256_setzero_si256();
+
+	// Lanes are all ones while set
+	__m256i in_brick = _mm256_setzero_si256();
+
+	__m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int32_t>(ray_cnt)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+	// Writes the results of the lanes in mask, which have hit the voxel they are in, or missed if is_miss is set
+	auto store_lanes = [&](__m256i mask, bool is_miss) noexcept
+	{
+		alignas(32) int32_t lane_cells[3][cpu_tracer::PACKET_SIZE];
+
+		alignas(32) int32_t lane_voxels[3][cpu_tracer::PACKET_SIZE];
+
+		alignas(32) int32_t lane_levels[cpu_tracer::PACKET_SIZE];
+
+		alignas(32) int32_t lane_axes[cpu_tracer::PACKET_SIZE];
+
+		alignas(32) float lane_times[cpu_tracer::PACKET_SIZE];
+
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lane_cells[a]), cell[a]);
+
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lane_voxels[a]), voxel[a]);
+		}
+
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lane_levels), level);
+
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lane_axes), axis);
+
+		_mm256_store_ps(lane_times, time);
+
+		for (uint32_t bits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(mask))); bits != 0; bits &= bits - 1)
+		{
+			const uint32_t l = static_cast<uint32_t>(_tzcnt_u32(bits));
+
+			cpu_ray_hit& hit = out_hits[l];
+
+			hit = {};
+
+			if (is_miss)
+			{
+				hit.time = INFINITY;
+
+				hit.face = cpu_tracer::RAY_HIT_MISS;
+
+				continue;
+			}
+
+			const uint32_t hit_level = static_cast<uint32_t>(lane_levels[l]);
+
+			for (uint32_t a = 0; a != 3; ++a)
+				hit.voxel[a] = ((lane_cells[a][l] + (frame_base[a] >> hit_level)) * brick_dim + lane_voxels[a][l]) * (1 << hit_level);
+
+			hit.time = lane_times[l];
+
+			hit.level = hit_level;
+
+			const uint32_t hit_axis = static_cast<uint32_t>(lane_axes[l]);
+
+			hit.face = hit_axis == 3 ? cpu_tracer::RAY_HIT_INSIDE : hit_axis * 2 + (direction_lanes[hit_axis][l] < 0.0F ? 1 : 0);
+		}
+	};
+
+	while (!_mm256_testz_si256(active, active))
+	{
+		// Lanes that left the coarsest level or went past their max_time
+
+		const __m256i past_levels = _mm256_andnot_si256(in_brick, _mm256_cmpeq_epi32(level, _mm256_set1_epi32(static_cast<int32_t>(volume.level_cnt))));
+
+		const __m256i past_max_time = _mm256_castps_si256(_mm256_cmp_ps(time, max_time, _CMP_GT_OQ));
+
+		const __m256i missed = _mm256_and_si256(active, _mm256_or_si256(past_levels, past_max_time));
+
+		if (!_mm256_testz_si256(missed, missed))
+		{
+			store_lanes(missed, true);
+
+			active = _mm256_andnot_si256(missed, active);
+		}
+
+		const __m256i was_in_brick = _mm256_and_si256(active, in_brick);
+
+		const __m256i in_cell = _mm256_andnot_si256(in_brick, active);
+
+		// Lanes outside their level's window move on to the next coarser one. Level bases are even below the
+		// coarsest level, so halving the relative cell index rounds like halving the absolute one.
+
+		__m256i window_offset = _mm256_setzero_si256();
+
+		for (uint32_t a = 0; a != 3; ++a)
+			window_offset = _mm256_or_si256(window_offset, _mm256_sub_epi32(cell[a], _mm256_permutevar8x32_epi32(tables.window_min[a], level)));
+
+		const __m256i is_outside = _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(window_offset, _mm256_set1_epi32(~(base_dim - 1))), _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+
+		const __m256i level_up = _mm256_and_si256(in_cell, is_outside);
+
+		level = _mm256_add_epi32(level, _mm256_and_si256(level_up, one_i));
+
+		for (uint32_t a = 0; a != 3; ++a)
+			cell[a] = _mm256_blendv_epi8(cell[a], _mm256_srai_epi32(cell[a], 1), level_up);
+
+		// Look up the base cells of the remaining lanes outside a brick
+
+		const __m256i looked_up = _mm256_andnot_si256(is_outside, in_cell);
+
+		__m256i texel = _mm256_mullo_epi32(level, _mm256_set1_epi32(base_dim));
+
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			const __m256i wrapped = _mm256_and_si256(_mm256_add_epi32(cell[a], _mm256_permutevar8x32_epi32(tables.level_base[a], level)), _mm256_set1_epi32(base_dim - 1));
+
+			texel = _mm256_add_epi32(texel, _mm256_mullo_epi32(wrapped, _mm256_set1_epi32(axis_strides[a])));
+		}
+
+		const __m256i base_value = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(volume.base.data()), texel, looked_up, 4);
+
+		const __m256i empty_flag = _mm256_set1_epi32(static_cast<int32_t>(EMPTY_CELL));
+
+		const __m256i full_flag = _mm256_set1_epi32(static_cast<int32_t>(FULL_CELL));
+
+		const __m256i is_empty = _mm256_and_si256(looked_up, _mm256_cmpeq_epi32(_mm256_and_si256(base_value, empty_flag), empty_flag));
+
+		const __m256i is_full = _mm256_andnot_si256(is_empty, _mm256_and_si256(looked_up, _mm256_cmpeq_epi32(_mm256_and_si256(base_value, full_flag), full_flag)));
+
+		const __m256i is_brick = _mm256_andnot_si256(_mm256_or_si256(is_empty, is_full), looked_up);
+
+		const __m256i enters_cell = _mm256_or_si256(is_full, is_brick);
+
+		if (!_mm256_testz_si256(enters_cell, enters_cell))
+		{
+			// Voxel holding the point where the ray entered the cell, which full cells report as their hit
+			const __m256 voxel_scale = _mm256_mul_ps(_mm256_permutevar8x32_ps(tables.inverse_cell_size, level), _mm256_set1_ps(static_cast<float>(brick_dim)));
+
+			for (uint32_t a = 0; a != 3; ++a)
+			{
+				const __m256 entry_position = _mm256_add_ps(origin[a], _mm256_mul_ps(direction[a], time));
+
+				__m256i entry_voxel = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(entry_position, voxel_scale))), _mm256_sll_epi32(cell[a], brick_shift));
+
+				entry_voxel = _mm256_min_epi32(_mm256_max_epi32(entry_voxel, _mm256_setzero_si256()), _mm256_set1_epi32(brick_dim - 1));
+
+				voxel[a] = _mm256_blendv_epi8(voxel[a], entry_voxel, enters_cell);
+			}
+
+			brick = _mm256_blendv_epi8(brick, base_value, is_brick);
+
+			in_brick = _mm256_or_si256(in_brick, is_brick);
+
+			if (!_mm256_testz_si256(is_full, is_full))
+			{
+				store_lanes(is_full, false);
+
+				active = _mm256_andnot_si256(is_full, active);
+			}
+		}
+
+		// Look at the voxels of lanes that were inside a brick before this iteration, unless they stepped out of it
+
+		const __m256i voxel_bits = _mm256_or_si256(_mm256_or_si256(voxel[0], voxel[1]), voxel[2]);
+
+		const __m256i leaves_brick = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(voxel_bits, _mm256_set1_epi32(~(brick_dim - 1))), _mm256_setzero_si256()), was_in_brick);
+
+		const __m256i looks_at_voxel = _mm256_andnot_si256(leaves_brick, was_in_brick);
+
+		const __m256i voxel_offset = _mm256_add_epi32(_mm256_add_epi32(voxel[0], _mm256_sll_epi32(voxel[1], brick_shift)), _mm256_sll_epi32(voxel[2], brick_shift2));
+
+		const __m256i word_index = _mm256_add_epi32(_mm256_mullo_epi32(brick, _mm256_set1_epi32(static_cast<int32_t>(volume.brick_words))), _mm256_srli_epi32(voxel_offset, 5));
+
+		const __m256i brick_word = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(volume.bricks.data()), word_index, looks_at_voxel, 4);
+
+		const __m256i voxel_bit = _mm256_and_si256(_mm256_srlv_epi32(brick_word, _mm256_and_si256(voxel_offset, _mm256_set1_epi32(31))), one_i);
+
+		const __m256i is_filled = _mm256_and_si256(looks_at_voxel, _mm256_cmpeq_epi32(voxel_bit, one_i));
+
+		if (!_mm256_testz_si256(is_filled, is_filled))
+		{
+			store_lanes(is_filled, false);
+
+			active = _mm256_andnot_si256(is_filled, active);
+		}
+
+		in_brick = _mm256_andnot_si256(leaves_brick, in_brick);
+
+		// Step into the next cell or voxel, which is the same computation on grids of different sizes
+
+		const __m256i steps_cell = _mm256_or_si256(is_empty, leaves_brick);
+
+		const __m256i steps_voxel = _mm256_andnot_si256(is_filled, looks_at_voxel);
+
+		const __m256i steps = _mm256_or_si256(steps_cell, steps_voxel);
+
+		if (_mm256_testz_si256(steps, steps))
+			continue;
+
+		const __m256 cell_size = _mm256_permutevar8x32_ps(tables.cell_size, level);
+
+		const __m256 grid_size = _mm256_blendv_ps(cell_size, _mm256_mul_ps(cell_size, _mm256_set1_ps(1.0F / static_cast<float>(brick_dim))), _mm256_castsi256_ps(steps_voxel));
+
+		__m256 axis_times[3];
+
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			const __m256i grid_index = _mm256_blendv_epi8(cell[a], _mm256_add_epi32(_mm256_sll_epi32(cell[a], brick_shift), voxel[a]), steps_voxel);
+
+			const __m256 boundary = _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(grid_index), step_offset[a]), grid_size);
+
+			axis_times[a] = _mm256_mul_ps(_mm256_sub_ps(boundary, origin[a]), coefficient[a]);
+		}
+
+		const __m256 min_time = _mm256_min_ps(_mm256_min_ps(axis_times[0], axis_times[1]), axis_times[2]);
+
+		const __m256i is_x = _mm256_castps_si256(_mm256_cmp_ps(min_time, axis_times[0], _CMP_EQ_OQ));
+
+		const __m256i is_y = _mm256_andnot_si256(is_x, _mm256_castps_si256(_mm256_cmp_ps(min_time, axis_times[1], _CMP_EQ_OQ)));
+
+		const __m256i is_z = _mm256_andnot_si256(_mm256_or_si256(is_x, is_y), _mm256_set1_epi32(-1));
+
+		const __m256i step_axes[3]{ is_x, is_y, is_z };
+
+		time = _mm256_blendv_ps(time, min_time, _mm256_castsi256_ps(steps));
+
+		axis = _mm256_blendv_epi8(axis, _mm256_add_epi32(_mm256_and_si256(is_y, one_i), _mm256_and_si256(is_z, _mm256_set1_epi32(2))), steps);
+
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			cell[a] = _mm256_add_epi32(cell[a], _mm256_and_si256(_mm256_and_si256(step_axes[a], steps_cell), step_sign[a]));
+
+			voxel[a] = _mm256_add_epi32(voxel[a], _mm256_and_si256(_mm256_and_si256(step_axes[a], steps_voxel), step_sign[a]));
+		}
+	}
+}
+
+void cpu_tracer::create(uint32_t thread_cnt) noexcept
+{
+	m_workers.create(thread_cnt);
+}
+
+void cpu_tracer::destroy() noexcept
+{
+	m_workers.destroy();
+}
+
+och::status cpu_tracer::trace(const cpu_volume& volume, const cpu_ray_query* queries, uint32_t query_cnt, cpu_ray_hit* out_hits) noexcept
+{
+	if (static_cast<uint64_t>(volume.brick_cnt) * volume.brick_words > cpu_volume::MAX_BRICK_WORDS)
+		return to_status(och::error::argument_too_large);
+
+	// Rays are traced relative to the anchor rounded down to a whole cell of the coarsest level, like in trace_common.glsl
+	int32_t frame_base[3];
+
+	for (uint32_t a = 0; a != 3; ++a)
+		frame_base[a] = (volume.anchor[a] >> volume.level_cnt) << volume.level_cnt;
+
+	alignas(32) int32_t window_min_lanes[3][PACKET_SIZE]{};
+
+	alignas(32) int32_t level_base_lanes[3][PACKET_SIZE]{};
+
+	alignas(32) float cell_size_lanes[PACKET_SIZE]{};
+
+	alignas(32) float inverse_cell_size_lanes[PACKET_SIZE]{};
+
+	for (uint32_t l = 0; l != volume.level_cnt; ++l)
+	{
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			level_base_lanes[a][l] = frame_base[a] >> l;
+
+			window_min_lanes[a][l] = volume.level_window_min(volume.anchor[a], l) - level_base_lanes[a][l];
+		}
+
+		cell_size_lanes[l] = static_cast<float>(1 << l);
+
+		inverse_cell_size_lanes[l] = 1.0F / static_cast<float>(1 << l);
+	}
+
+	level_tables tables;
+
+	for (uint32_t a = 0; a != 3; ++a)
+	{
+		tables.window_min[a] = _mm256_load_si256(reinterpret_cast<const __m256i*>(window_min_lanes[a]));
+
+		tables.level_base[a] = _mm256_load_si256(reinterpret_cast<const __m256i*>(level_base_lanes[a]));
+	}
+
+	tables.cell_size = _mm256_load_ps(cell_size_lanes);
+
+	tables.inverse_cell_size = _mm256_load_ps(inverse_cell_size_lanes);
+
+	const uint32_t packet_cnt = (query_cnt + PACKET_SIZE - 1) / PACKET_SIZE;
+
+	const uint32_t task_cnt = (packet_cnt + TASK_PACKET_CNT - 1) / TASK_PACKET_CNT;
+
+	m_workers.run(task_cnt, [&](uint32_t task_idx) noexcept
+	{
+		const uint32_t packet_end = (task_idx + 1) * TASK_PACKET_CNT < packet_cnt ? (task_idx + 1) * TASK_PACKET_CNT : packet_cnt;
+
+		for (uint32_t p = task_idx * TASK_PACKET_CNT; p != packet_end; ++p)
+		{
+			const uint32_t first_ray = p * PACKET_SIZE;
+
+			const uint32_t ray_cnt = query_cnt - first_ray < PACKET_SIZE ? query_cnt - first_ray : PACKET_SIZE;
+
+			trace_packet(volume, tables, frame_base, queries + first_ray, ray_cnt, out_hits + first_ray);
+		}
+	});
+
+	return {};
+}
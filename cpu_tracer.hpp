@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+#include "cpu_volume.hpp"
+
+#include "parallel_for.hpp"
+
+// Ray to be traced by cpu_tracer, laid out like voxel_volume::ray_query_t. origin is in world space, and direction
+// need not be normalized.
+struct cpu_ray_query
+{
+	float origin[3];
+
+	float max_time;
+
+	float direction[3];
+
+	uint32_t unused;
+};
+
+// Result of a traced ray, laid out and filled in like voxel_volume::ray_hit_t, so that the two can be compared directly
+struct cpu_ray_hit
+{
+	int32_t voxel[3];
+
+	float time;
+
+	uint32_t face;
+
+	uint32_t level;
+
+	uint32_t unused[2];
+};
+
+// CPU counterpart of the query pass, tracing rays through a cpu_volume with the same level stepping and cell
+// semantics as trace_common.glsl. Rays are traced in packets of PACKET_SIZE with AVX2, which are spread over the
+// tracer's worker threads. These stay alive between calls to trace, so that tracing small batches does not pay for
+// starting threads each time.
+// It does without the distance field and brick masks, which only skip empty space, so hits only differ where rounding
+// sends a ray through a different edge.
+struct cpu_tracer
+{
+	static constexpr uint32_t PACKET_SIZE = 8;
+
+	// Packets handed to a thread at once
+	static constexpr uint32_t TASK_PACKET_CNT = 16;
+
+	// Values of cpu_ray_hit::face other than the six sides, matching voxel_volume::RAY_HIT_INSIDE and following
+	static constexpr uint32_t RAY_HIT_INSIDE = 6;
+
+	static constexpr uint32_t RAY_HIT_MISS = 7;
+
+	worker_pool m_workers;
+
+	// Starts the worker threads. The thread calling trace counts towards thread_cnt.
+	void create(uint32_t thread_cnt) noexcept;
+
+	void destroy() noexcept;
+
+	// Fails for volumes with more than cpu_volume::MAX_BRICK_WORDS brick words, which the gathers cannot address
+	och::status trace(const cpu_volume& volume, const cpu_ray_query* queries, uint32_t query_cnt, cpu_ray_hit* out_hits) noexcept;
+};
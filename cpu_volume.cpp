@@ -0,0 +1,268 @@
+#include "cpu_volume.hpp"
+
+#include "parallel_for.hpp"
+
+#include <immintrin.h>
+
+#include <cstring>
+
+// The functions below mirror simplex3d and d_dot_with_hashed_vec in the init_* shaders operation for operation, so that
+// results match bit for bit, unless the GPU compiler decides to contract some of the multiply-adds.
+
+static __m256 d_dot_with_hashed_vec_x8(__m256 i, __m256 j, __m256 k, __m256 x, __m256 y, __m256 z) noexcept
+{
+	const __m256i hi = _mm256_mullo_epi32(_mm256_castps_si256(i), _mm256_set1_epi32(73856093));
+	const __m256i hj = _mm256_mullo_epi32(_mm256_castps_si256(j), _mm256_set1_epi32(19349663));
+	const __m256i hk = _mm256_mullo_epi32(_mm256_castps_si256(k), _mm256_set1_epi32(83492791));
+
+	const __m256i h = _mm256_xor_si256(_mm256_xor_si256(hi, hj), hk);
+
+	//Two masks, which are either 0.0F or -0.0F, depending on positional hash
+	const __m256i neg1 = _mm256_and_si256(h, _mm256_set1_epi32(static_cast<int32_t>(0x80000000u)));
+	const __m256i neg2 = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x10000000)), 3);
+
+	//Get hash in [0, 2]
+	const __m256i h_3 = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(h, 4), _mm256_set1_epi32(3)), 28);
+
+	//h_3 == 0 picks (y, z), h_3 == 1 picks (x, z) and h_3 == 2 picks (x, y)
+	const __m256 a = _mm256_blendv_ps(x, y, _mm256_castsi256_ps(_mm256_cmpeq_epi32(h_3, _mm256_setzero_si256())));
+	const __m256 b = _mm256_blendv_ps(z, y, _mm256_castsi256_ps(_mm256_cmpeq_epi32(h_3, _mm256_set1_epi32(2))));
+
+	//Return picked inputs, either negated or not, depending on masks
+	return _mm256_add_ps(_mm256_xor_ps(a, _mm256_castsi256_ps(neg1)), _mm256_xor_ps(b, _mm256_castsi256_ps(neg2)));
+}
+
+static __m256 corner_contribution_x8(__m256 i, __m256 j, __m256 k, __m256 x, __m256 y, __m256 z) noexcept
+{
+	__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5F), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+
+	t = _mm256_max_ps(t, _mm256_setzero_ps());
+
+	return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), t), d_dot_with_hashed_vec_x8(i, j, k, x, y, z));
+}
+
+static __m256 simplex3d_x8(__m256 x, __m256 y, __m256 z) noexcept
+{
+	const float skew_factor = 1.0F / 3.0F;
+	const float unskew_factor = 1.0F / 6.0F;
+
+	const __m256 one = _mm256_set1_ps(1.0F);
+
+	const __m256 skew = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), _mm256_set1_ps(skew_factor));
+
+	const __m256 i0 = _mm256_floor_ps(_mm256_add_ps(x, skew));
+	const __m256 j0 = _mm256_floor_ps(_mm256_add_ps(y, skew));
+	const __m256 k0 = _mm256_floor_ps(_mm256_add_ps(z, skew));
+
+	const __m256 unskew = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(i0, j0), k0), _mm256_set1_ps(unskew_factor));
+
+	const __m256 x0 = _mm256_add_ps(_mm256_sub_ps(x, i0), unskew);
+	const __m256 y0 = _mm256_add_ps(_mm256_sub_ps(y, j0), unskew);
+	const __m256 z0 = _mm256_add_ps(_mm256_sub_ps(z, k0), unskew);
+
+	const __m256 x_ge_y = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ);
+	const __m256 x_ge_z = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+	const __m256 y_gt_x = _mm256_cmp_ps(y0, x0, _CMP_GT_OQ);
+	const __m256 y_ge_z = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+	const __m256 z_gt_x = _mm256_cmp_ps(z0, x0, _CMP_GT_OQ);
+	const __m256 z_gt_y = _mm256_cmp_ps(z0, y0, _CMP_GT_OQ);
+
+	const __m256 i1 = _mm256_and_ps(_mm256_and_ps(x_ge_y, x_ge_z), one); //max == x
+	const __m256 j1 = _mm256_and_ps(_mm256_and_ps(y_gt_x, y_ge_z), one); //max == y
+	const __m256 k1 = _mm256_and_ps(_mm256_and_ps(z_gt_x, z_gt_y), one); //max == z
+	const __m256 i2 = _mm256_and_ps(_mm256_or_ps(x_ge_y, x_ge_z), one);  //min != x
+	const __m256 j2 = _mm256_and_ps(_mm256_or_ps(y_gt_x, y_ge_z), one);  //min != y
+	const __m256 k2 = _mm256_and_ps(_mm256_or_ps(z_gt_x, z_gt_y), one);  //min != z
+
+	const __m256 unskew1 = _mm256_set1_ps(unskew_factor);
+	const __m256 unskew2 = _mm256_set1_ps(unskew_factor * 2.0F);
+	const __m256 unskew3 = _mm256_set1_ps(unskew_factor * 3.0F);
+
+	const __m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, i1), unskew1);
+	const __m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, j1), unskew1);
+	const __m256 z1 = _mm256_add_ps(_mm256_sub_ps(z0, k1), unskew1);
+
+	const __m256 x2 = _mm256_add_ps(_mm256_sub_ps(x0, i2), unskew2);
+	const __m256 y2 = _mm256_add_ps(_mm256_sub_ps(y0, j2), unskew2);
+	const __m256 z2 = _mm256_add_ps(_mm256_sub_ps(z0, k2), unskew2);
+
+	const __m256 x3 = _mm256_add_ps(_mm256_sub_ps(x0, one), unskew3);
+	const __m256 y3 = _mm256_add_ps(_mm256_sub_ps(y0, one), unskew3);
+	const __m256 z3 = _mm256_add_ps(_mm256_sub_ps(z0, one), unskew3);
+
+	const __m256 t0 = corner_contribution_x8(i0, j0, k0, x0, y0, z0);
+	const __m256 t1 = corner_contribution_x8(_mm256_add_ps(i1, i0), _mm256_add_ps(j1, j0), _mm256_add_ps(k1, k0), x1, y1, z1);
+	const __m256 t2 = corner_contribution_x8(_mm256_add_ps(i2, i0), _mm256_add_ps(j2, j0), _mm256_add_ps(k2, k0), x2, y2, z2);
+	const __m256 t3 = corner_contribution_x8(_mm256_add_ps(one, i0), _mm256_add_ps(one, j0), _mm256_add_ps(one, k0), x3, y3, z3);
+
+	const __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(t0, t1), t2), t3);
+
+	return _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(38.0F), sum), _mm256_set1_ps(0.5F));
+}
+
+// Evaluates all voxels of a cell into out_words, returning the number of filled voxels
+static uint32_t evaluate_brick(const cpu_volume& volume, const cpu_volume_params& params, const int32_t cell[3], uint32_t level, uint32_t* out_words) noexcept
+{
+	const uint32_t brick_dim = volume.brick_dim;
+
+	const __m256 scale = _mm256_set1_ps(params.scale);
+
+	const __m256 level_scale = _mm256_set1_ps(static_cast<float>(1 << level));
+
+	const __m256 cutoff = _mm256_set1_ps(params.cutoff);
+
+	const __m256 lane_offsets = _mm256_setr_ps(0.0F, 1.0F, 2.0F, 3.0F, 4.0F, 5.0F, 6.0F, 7.0F);
+
+	const int32_t voxel_base[3]{ cell[0] * static_cast<int32_t>(brick_dim), cell[1] * static_cast<int32_t>(brick_dim), cell[2] * static_cast<int32_t>(brick_dim) };
+
+	memset(out_words, 0, volume.brick_words * sizeof(uint32_t));
+
+	uint32_t filled_cnt = 0;
+
+	for (uint32_t z = 0; z != brick_dim; ++z)
+	{
+		const __m256 pos_z = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(static_cast<float>(voxel_base[2] + static_cast<int32_t>(z))), scale), level_scale), _mm256_set1_ps(params.offset.z));
+
+		for (uint32_t y = 0; y != brick_dim; ++y)
+		{
+			const __m256 pos_y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(static_cast<float>(voxel_base[1] + static_cast<int32_t>(y))), scale), level_scale), _mm256_set1_ps(params.offset.y));
+
+			const uint32_t row_offset = y * brick_dim + z * brick_dim * brick_dim;
+
+			// Bricks are at least 8 voxels wide, so each group of 8 voxels lies within a single word
+			for (uint32_t x = 0; x != brick_dim; x += 8)
+			{
+				const __m256 voxel_x = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(voxel_base[0] + static_cast<int32_t>(x))), lane_offsets);
+
+				const __m256 pos_x = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(voxel_x, scale), level_scale), _mm256_set1_ps(params.offset.x));
+
+				const __m256 simplex_val = simplex3d_x8(pos_x, pos_y, pos_z);
+
+				const uint32_t group_bits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(simplex_val, cutoff, _CMP_GT_OQ)));
+
+				out_words[(row_offset + x) >> 5] |= group_bits << ((row_offset + x) & 31);
+
+				filled_cnt += static_cast<uint32_t>(_mm_popcnt_u32(group_bits));
+			}
+		}
+	}
+
+	return filled_cnt;
+}
+
+// Doubles the capacity of a chunk's brick words, up to max_cnt, keeping the first used_cnt of them
+static void grow_brick_words(heap_buffer<uint32_t>& brick_words, uint32_t used_cnt, uint32_t words_per_brick, uint32_t max_cnt) noexcept
+{
+	const uint64_t grown_cnt = brick_words.size() == 0 ? 64 * static_cast<uint64_t>(words_per_brick) : brick_words.size() * static_cast<uint64_t>(2);
+
+	heap_buffer<uint32_t> grown(static_cast<uint32_t>(grown_cnt < max_cnt ? grown_cnt : max_cnt));
+
+	if (used_cnt != 0)
+		memcpy(grown.data(), brick_words.data(), used_cnt * sizeof(uint32_t));
+
+	brick_words.attach(grown.detach());
+}
+
+och::status cpu_volume::build(const cpu_volume_params& params, uint32_t thread_cnt) noexcept
+{
+	// One chunk per level and z-slice of the level's window. Chunks collect their bricks separately, and are then
+	// concatenated in order, which makes brick indices independent of thread scheduling.
+	struct chunk_data
+	{
+		heap_buffer<uint32_t> brick_words;
+
+		heap_buffer<uint32_t> brick_texels;
+
+		uint32_t brick_cnt = 0;
+
+		uint32_t first_brick = 0;
+	};
+
+	const uint32_t chunk_cnt = level_cnt * base_dim;
+
+	chunk_data chunks[MAX_LEVEL_CNT << MAX_BASE_DIM_LOG2];
+
+	// A chunk holds at most one brick per cell of its slice, which bounds the words it can grow to
+	const uint64_t max_chunk_words = static_cast<uint64_t>(base_dim) * base_dim * brick_words;
+
+	if (max_chunk_words > MAX_BRICK_WORDS)
+		return to_status(och::error::argument_too_large);
+
+	for (uint32_t a = 0; a != 3; ++a)
+		anchor[a] = params.anchor[a];
+
+	base.allocate(base_width * base_dim * base_dim);
+
+	parallel_for(chunk_cnt, thread_cnt, [&](uint32_t chunk_idx) noexcept
+	{
+		const uint32_t level = chunk_idx / base_dim;
+
+		const int32_t window_min[3]{ level_window_min(params.anchor[0], level), level_window_min(params.anchor[1], level), level_window_min(params.anchor[2], level) };
+
+		chunk_data& chunk = chunks[chunk_idx];
+
+		// A chunk has at most one brick per cell, but usually far fewer, so only the words grow on demand
+		chunk.brick_texels.allocate(base_dim * base_dim);
+
+		heap_buffer<uint32_t> words(brick_words);
+
+		for (uint32_t y = 0; y != base_dim; ++y)
+			for (uint32_t x = 0; x != base_dim; ++x)
+			{
+				const int32_t cell[3]{ window_min[0] + static_cast<int32_t>(x), window_min[1] + static_cast<int32_t>(y), window_min[2] + static_cast<int32_t>(chunk_idx % base_dim) };
+
+				const uint32_t filled_cnt = evaluate_brick(*this, params, cell, level, words.data());
+
+				const uint32_t texel = texel_index(cell, level);
+
+				if (filled_cnt == 0)
+				{
+					base[texel] = EMPTY_CELL;
+				}
+				else if (filled_cnt == brick_vol)
+				{
+					base[texel] = FULL_CELL;
+				}
+				else
+				{
+					if ((chunk.brick_cnt + 1) * brick_words > chunk.brick_words.size())
+						grow_brick_words(chunk.brick_words, chunk.brick_cnt * brick_words, brick_words, static_cast<uint32_t>(max_chunk_words));
+
+					chunk.brick_texels[chunk.brick_cnt] = texel;
+
+					memcpy(chunk.brick_words.data() + chunk.brick_cnt * brick_words, words.data(), brick_words * sizeof(uint32_t));
+
+					++chunk.brick_cnt;
+				}
+			}
+	});
+
+	brick_cnt = 0;
+
+	for (uint32_t i = 0; i != chunk_cnt; ++i)
+	{
+		chunks[i].first_brick = brick_cnt;
+
+		brick_cnt += chunks[i].brick_cnt;
+	}
+
+	const uint64_t total_brick_words = static_cast<uint64_t>(brick_cnt) * brick_words;
+
+	if (total_brick_words > MAX_BRICK_WORDS)
+		return to_status(och::error::argument_too_large);
+
+	bricks.allocate(static_cast<uint32_t>(total_brick_words));
+
+	parallel_for(chunk_cnt, thread_cnt, [&](uint32_t chunk_idx) noexcept
+	{
+		const chunk_data& chunk = chunks[chunk_idx];
+
+		for (uint32_t i = 0; i != chunk.brick_cnt; ++i)
+			base[chunk.brick_texels[i]] = chunk.first_brick + i;
+
+		if (chunk.brick_cnt != 0)
+			memcpy(bricks.data() + chunk.first_brick * brick_words, chunk.brick_words.data(), chunk.brick_cnt * brick_words * sizeof(uint32_t));
+	});
+
+	return {};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+
+#include <och_err.h>
+#include <och_matmath.h>
+
+#include "heap_buffer.h"
+
+#include "cell_encoding.hpp"
+
+struct cpu_volume_params
+{
+	och::vec3 offset;
+
+	float scale;
+
+	float cutoff;
+
+	int32_t anchor[3];
+};
+
+// CPU reference implementation of the init_checkempty / init_assignindex / init_fillbricks passes.
+// It classifies cells exactly like the GPU path, but hands out brick indices in a deterministic order, meaning results
+// have to be compared per cell rather than per brick.
+struct cpu_volume
+{
+	// Largest geometry a cpu_volume can be built for, matching the limits voxel_volume places on its own
+	static constexpr uint32_t MAX_LEVEL_CNT = 8;
+
+	static constexpr uint32_t MAX_BASE_DIM_LOG2 = 7;
+
+	// Most brick words a cpu_volume can hold, as cpu_tracer gathers them with signed 32-bit indices
+	static constexpr uint64_t MAX_BRICK_WORDS = 0x7FFFFFFF;
+
+	uint32_t level_cnt;
+
+	uint32_t base_dim_log2;
+
+	uint32_t brick_dim_log2;
+
+	uint32_t base_dim;
+
+	uint32_t brick_dim;
+
+	uint32_t brick_vol;
+
+	uint32_t brick_words;
+
+	uint32_t base_width;
+
+	// Laid out like a tightly packed copy of base_image, meaning base_width x base_dim x base_dim with x varying fastest
+	heap_buffer<uint32_t> base;
+
+	// brick_words words per brick, holding one bit per voxel in the same order as brick_format::bitpacked
+	heap_buffer<uint32_t> bricks;
+
+	uint32_t brick_cnt{};
+
+	// Anchor of the volume's level windows, as passed to build
+	int32_t anchor[3]{};
+
+
+
+	// Takes the same geometry voxel_volume passes to its shaders. Bricks must be at least 8 voxels wide.
+	explicit cpu_volume(uint32_t level_cnt, uint32_t base_dim_log2, uint32_t brick_dim_log2) noexcept :
+		level_cnt{ level_cnt },
+		base_dim_log2{ base_dim_log2 },
+		brick_dim_log2{ brick_dim_log2 },
+		base_dim{ 1u << base_dim_log2 },
+		brick_dim{ 1u << brick_dim_log2 },
+		brick_vol{ 1u << (brick_dim_log2 * 3) },
+		brick_words{ (1u << (brick_dim_log2 * 3)) / 32 },
+		base_width{ (1u << base_dim_log2) * level_cnt }
+	{
+		assert(level_cnt <= MAX_LEVEL_CNT && base_dim_log2 <= MAX_BASE_DIM_LOG2 && brick_dim_log2 >= 3);
+	}
+
+	// Fails if the bricks take more than MAX_BRICK_WORDS words
+	och::status build(const cpu_volume_params& params, uint32_t thread_cnt) noexcept;
+
+	bool is_voxel_filled(uint32_t brick_index, uint32_t voxel_offset) const noexcept
+	{
+		return ((bricks[brick_index * brick_words + (voxel_offset >> 5)] >> (voxel_offset & 31)) & 1) != 0;
+	}
+
+	uint32_t texel_index(const int32_t cell[3], uint32_t level) const noexcept
+	{
+		const uint32_t x = (static_cast<uint32_t>(cell[0]) & (base_dim - 1)) + level * base_dim;
+
+		const uint32_t y = static_cast<uint32_t>(cell[1]) & (base_dim - 1);
+
+		const uint32_t z = static_cast<uint32_t>(cell[2]) & (base_dim - 1);
+
+		return x + y * base_width + z * base_width * base_dim;
+	}
+
+	int32_t level_window_min(int32_t anchor_coord, uint32_t level) const noexcept
+	{
+		return ((anchor_coord >> (level + 1)) << 1) - static_cast<int32_t>(base_dim / 2);
+	}
+};
@@ -0,0 +1,64 @@
+#include "file_writer.hpp"
+
+#define NOMINMAX
+#include <Windows.h>
+
+file_writer::~file_writer() noexcept
+{
+	close();
+}
+
+och::status file_writer::create(const char* filename) noexcept
+{
+	close();
+
+	wchar_t wide_filename[1024];
+
+	if (!MultiByteToWideChar(CP_UTF8, 0, filename, -1, wide_filename, 1024))
+		return to_status(HRESULT_FROM_WIN32(GetLastError()));
+
+	HANDLE file = CreateFileW(wide_filename, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return to_status(HRESULT_FROM_WIN32(GetLastError()));
+
+	m_handle = file;
+
+	m_offset = 0;
+
+	return {};
+}
+
+och::status file_writer::write(const void* data, uint64_t bytes) noexcept
+{
+	const uint8_t* curr = static_cast<const uint8_t*>(data);
+
+	while (bytes != 0)
+	{
+		// WriteFile takes 32-bit sizes, so split up large writes
+		const DWORD chunk_bytes = bytes > (1 << 30) ? (1 << 30) : static_cast<DWORD>(bytes);
+
+		DWORD written_bytes;
+
+		if (!WriteFile(static_cast<HANDLE>(m_handle), curr, chunk_bytes, &written_bytes, nullptr))
+			return to_status(HRESULT_FROM_WIN32(GetLastError()));
+
+		curr += written_bytes;
+
+		bytes -= written_bytes;
+
+		m_offset += written_bytes;
+	}
+
+	return {};
+}
+
+void file_writer::close() noexcept
+{
+	if (m_handle == nullptr)
+		return;
+
+	CloseHandle(static_cast<HANDLE>(m_handle));
+
+	m_handle = nullptr;
+}
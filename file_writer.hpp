@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include <och_err.h>
+
+// Writes a file front to back, replacing any existing file of the same name. The file is closed on destruction, so
+// callers can bail out with check() at any point.
+struct file_writer
+{
+	void* m_handle{};
+
+	uint64_t m_offset{}; // Number of bytes written so far
+
+	file_writer() noexcept = default;
+
+	file_writer(const file_writer&) = delete;
+
+	file_writer& operator=(const file_writer&) = delete;
+
+	~file_writer() noexcept;
+
+	och::status create(const char* filename) noexcept;
+
+	och::status write(const void* data, uint64_t bytes) noexcept;
+
+	void close() noexcept;
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <cstdint>
+#include <new>
+
+#include "heap_buffer.h"
+
+// Runs f(task_idx) for every task_idx in [0, task_cnt), handing tasks out dynamically to thread_cnt threads.
+// The calling thread counts towards thread_cnt and takes part in the work.
+template<typename F>
+void parallel_for(uint32_t task_cnt, uint32_t thread_cnt, F&& f) noexcept
+{
+	if (thread_cnt == 0)
+		thread_cnt = 1;
+
+	if (thread_cnt > task_cnt)
+		thread_cnt = task_cnt;
+
+	std::atomic<uint32_t> next_task_idx{ 0 };
+
+	auto worker = [&]() noexcept
+	{
+		for (uint32_t task_idx = next_task_idx.fetch_add(1, std::memory_order_relaxed); task_idx < task_cnt; task_idx = next_task_idx.fetch_add(1, std::memory_order_relaxed))
+			f(task_idx);
+	};
+
+	if (thread_cnt <= 1)
+	{
+		worker();
+
+		return;
+	}
+
+	heap_buffer<std::thread> threads(thread_cnt - 1);
+
+	for (uint32_t i = 0; i != thread_cnt - 1; ++i)
+		new(&threads[i]) std::thread(worker);
+
+	worker();
+
+	for (uint32_t i = 0; i != thread_cnt - 1; ++i)
+	{
+		threads[i].join();
+
+		threads[i].~thread();
+	}
+}
+
+// Like parallel_for, but keeps its threads alive between calls to run, for work handed out often enough that starting
+// and joining threads every time would show up. The thread calling run counts towards thread_cnt and takes part in the work.
+struct worker_pool
+{
+	worker_pool() noexcept = default;
+
+	worker_pool(const worker_pool&) = delete;
+
+	worker_pool& operator=(const worker_pool&) = delete;
+
+	~worker_pool() noexcept
+	{
+		destroy();
+	}
+
+	void create(uint32_t thread_cnt) noexcept
+	{
+		m_worker_cnt = thread_cnt > 1 ? thread_cnt - 1 : 0;
+
+		if (m_worker_cnt == 0)
+			return;
+
+		m_workers.allocate(m_worker_cnt);
+
+		for (uint32_t i = 0; i != m_worker_cnt; ++i)
+			new(&m_workers[i]) std::thread([this]() noexcept { work(); });
+	}
+
+	void destroy() noexcept
+	{
+		if (m_worker_cnt != 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_is_stopping = true;
+			}
+
+			m_start_cv.notify_all();
+
+			for (uint32_t i = 0; i != m_worker_cnt; ++i)
+			{
+				m_workers[i].join();
+
+				m_workers[i].~thread();
+			}
+
+			m_workers.deallocate();
+		}
+
+		m_worker_cnt = 0;
+
+		m_is_stopping = false;
+	}
+
+	uint32_t thread_cnt() const noexcept
+	{
+		return m_worker_cnt + 1;
+	}
+
+	// Runs f(task_idx) for every task_idx in [0, task_cnt), returning once all of them are done
+	template<typename F>
+	void run(uint32_t task_cnt, F&& f) noexcept
+	{
+		using fn_t = std::remove_reference_t<F>;
+
+		m_task_fn = [](void* fn, uint32_t task_idx) noexcept { (*static_cast<fn_t*>(fn))(task_idx); };
+
+		m_task_ctx = const_cast<void*>(static_cast<const void*>(&f));
+
+		m_task_cnt = task_cnt;
+
+		m_next_task_idx.store(0, std::memory_order_relaxed);
+
+		if (m_worker_cnt != 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_active_cnt = m_worker_cnt;
+
+				++m_generation;
+			}
+
+			m_start_cv.notify_all();
+		}
+
+		run_tasks();
+
+		if (m_worker_cnt != 0)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_done_cv.wait(lock, [this]() noexcept { return m_active_cnt == 0; });
+		}
+	}
+
+	void run_tasks() noexcept
+	{
+		for (uint32_t task_idx = m_next_task_idx.fetch_add(1, std::memory_order_relaxed); task_idx < m_task_cnt; task_idx = m_next_task_idx.fetch_add(1, std::memory_order_relaxed))
+			m_task_fn(m_task_ctx, task_idx);
+	}
+
+	void work() noexcept
+	{
+		uint64_t seen_generation = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				m_start_cv.wait(lock, [&]() noexcept { return m_is_stopping || m_generation != seen_generation; });
+
+				if (m_is_stopping)
+					return;
+
+				seen_generation = m_generation;
+			}
+
+			run_tasks();
+
+			bool is_last;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				is_last = --m_active_cnt == 0;
+			}
+
+			if (is_last)
+				m_done_cv.notify_one();
+		}
+	}
+
+	heap_buffer<std::thread> m_workers;
+
+	uint32_t m_worker_cnt = 0;
+
+	// Guards m_generation, m_active_cnt and m_is_stopping. The task fields are written before m_generation is bumped,
+	// so workers see them once they have observed the new generation.
+	std::mutex m_mutex;
+
+	std::condition_variable m_start_cv;
+
+	std::condition_variable m_done_cv;
+
+	uint64_t m_generation = 0;
+
+	uint32_t m_active_cnt = 0;
+
+	bool m_is_stopping = false;
+
+	void (*m_task_fn)(void*, uint32_t) noexcept = nullptr;
+
+	void* m_task_ctx = nullptr;
+
+	uint32_t m_task_cnt = 0;
+
+	std::atomic<uint32_t> m_next_task_idx{ 0 };
+};
@@ -0,0 +1,15 @@
+// Encoding of base image texels, matching cell_encoding.hpp. Texels either hold a brick index in their low
+// CELL_INDEX_BITS bits with all other bits clear, or have one of the flags above them set.
+
+const uint CELL_INDEX_BITS = 28;
+
+const uint CELL_INDEX_MASK = (1u << CELL_INDEX_BITS) - 1;
+
+const uint EMPTY_CELL = 0x80000000u;
+
+const uint FULL_CELL = 0x40000000u;
+
+bool is_brick_cell(uint value)
+{
+	return (value & ~CELL_INDEX_MASK) == 0;
+}
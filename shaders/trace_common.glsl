@@ -0,0 +1,1047 @@
+// Shared by the tracers, which include this after declaring their workgroup size and the extensions used here.
+// A ray is traced by begin_ray followed by calls to step_ray until it returns true, so that a tracer can decide when to
+// move on to another ray.
+
+layout (constant_id = 3) const uint BASE_DIM_LOG2 = 6;
+layout (constant_id = 4) const uint BRICK_DIM_LOG2 = 3;
+layout (constant_id = 5) const uint LEVEL_CNT = 1;
+layout (constant_id = 6) const bool BITPACKED_BRICKS = false;
+layout (constant_id = 7) const bool LEAF_BRICKS = false;
+layout (constant_id = 9) const bool MORTON_BRICKS = false;
+layout (constant_id = 10) const bool COUNT_BRICK_LINES = false;
+layout (constant_id = 11) const bool ATLAS_BRICKS = false;
+layout (constant_id = 12) const bool DEPTH_PREPASS = false;
+layout (constant_id = 13) const bool PREPASS_START = false;
+layout (constant_id = 14) const bool REPROJECT_START = false;
+// 0 traces every pixel, 1 alternating halves of a checkerboard, and 2 one pixel per 1x1, 2x2 or 4x4 block, with the
+// block size chosen per workgroup from the previous frame's hit times. Untraced pixels are filled in by resolve.
+layout (constant_id = 15) const uint SPARSE_TRACE = 0;
+layout (constant_id = 16) const bool COUNT_LANE_STEPS = false;
+// Set for query, which traces rays read from ray_queries and writes their hits to ray_hits instead of hit_ids and hit_times
+layout (constant_id = 17) const bool RAY_QUERY = false;
+// Set to have trace walk its workgroups in Morton order within blocks of SWIZZLE_BLOCK_DIM^2 groups, instead of row by
+// row, so that the groups in flight at once cover a compact patch of the screen and share more bricks in cache
+layout (constant_id = 18) const bool SWIZZLE_GROUPS = false;
+
+// Side of the pixel tiles sharing one prepass ray, matching voxel_volume::PREPASS_TILE_DIM
+const int PREPASS_TILE_DIM = 8;
+
+// Side of the blocks of workgroups walked in Morton order when SWIZZLE_GROUPS is set, matching voxel_volume::SWIZZLE_BLOCK_DIM
+const uint SWIZZLE_BLOCK_DIM = 8;
+
+layout (set = 0, binding = 0, rgba8) uniform writeonly image2D hit_ids;
+
+layout (set = 0, binding = 1, r32f) uniform writeonly image2D hit_times;
+
+layout (set = 0, binding = 2, r32ui) uniform readonly uimage3D base_data;
+
+#include "cell_encoding.glsl"
+
+layout (set = 0, binding = 3) readonly buffer Bricks {
+	uint16_t elems[];
+} bricks;
+
+// Aliases Bricks when BITPACKED_BRICKS is set, holding one bit per voxel.
+layout (set = 0, binding = 3) readonly buffer Bitpacked_bricks {
+	uint elems[];
+} bitpacked_bricks;
+
+// Aliases Bricks when LEAF_BRICKS is set, holding one word per 2x2x2 block. Blocks are either uniformly empty (0),
+// uniformly full (0xFFFFFFFF), or refer to the leaf holding their eight voxels by its index + 1.
+layout (set = 0, binding = 3) readonly buffer Leaf_bricks {
+	uint elems[];
+} leaf_bricks;
+
+// One byte per leaf, with a bit for each of its eight voxels in x, y, z order
+layout (set = 0, binding = 4) readonly buffer Leaves {
+	uint elems[];
+} leaves;
+
+// Two words per brick, with one bit per (BRICK_DIM / 4)^3 sub-block that is set if any of its voxels is filled
+layout (set = 0, binding = 5) readonly buffer Brick_masks {
+	uvec2 elems[];
+} brick_masks;
+
+// Chebyshev distance from each base cell to the nearest non-empty cell of its level, laid out like base_data
+layout (set = 0, binding = 6, r8ui) uniform readonly uimage3D distances;
+
+// The first three are only written with COUNT_BRICK_LINES, for comparing the memory traffic of brick layouts. The
+// remaining ones are only written with COUNT_LANE_STEPS, as 64-bit counts split into low and high words, for comparing
+// the SIMD utilisation of tracers.
+layout (set = 0, binding = 7) buffer Trace_stats {
+	uint ray_cnt;
+	uint brick_read_cnt;
+	uint brick_line_cnt;
+	uint lane_step_cnt_low;
+	uint lane_step_cnt_high;
+	uint active_lane_step_cnt_low;
+	uint active_lane_step_cnt_high;
+} trace_stats;
+
+// Holds one texel per voxel, which is 1 if it is filled, with brick i at
+// (i & (ATLAS_DIM - 1), (i >> atlas_dim_log2) & (ATLAS_DIM - 1), i >> (2 * atlas_dim_log2)) * BRICK_DIM.
+// Replaces binding 3 and 4 as the source of voxels when ATLAS_BRICKS is set.
+layout (set = 0, binding = 8) uniform usampler3D brick_atlas;
+
+// One texel per PREPASS_TILE_DIM^2 pixel tile, holding the distance up to which all of the tile's rays are known to
+// only cross empty cells, and the level on which the tile's center ray was at that distance. Written when
+// DEPTH_PREPASS is set and read when PREPASS_START is set.
+layout (set = 0, binding = 9, rg32f) uniform image2D tile_starts;
+
+// Distance of the nearest previous frame hit reprojected onto each pixel as float bits, or infinity if there is none.
+// Written by reproject and read when REPROJECT_START is set.
+layout (set = 0, binding = 11, r32ui) uniform readonly uimage2D reprojected_times;
+
+// Hit times of every swapchain image, with the previous frame's at previous_image_index. Read when SPARSE_TRACE is 2.
+layout (set = 0, binding = 10, r32f) uniform readonly image2D hit_times_history[4];
+
+// Passed as previous_image_index while there are no usable previous hit times
+const uint NO_PREVIOUS_IMAGE = 0xFFFFFFFFu;
+
+layout(push_constant) uniform Push_data {
+	vec3 origin;
+	vec2 direction_delta;
+	uvec2 render_extent; // Part of hit_ids being traced, which is all of it unless tracing at a dynamic resolution
+	mat3 direction_rotation;
+	ivec3 anchor_min;
+	uint frame_index;
+	ivec3 anchor_max;
+	uint atlas_dim_log2;
+	uint previous_image_index;
+	uint ray_query_offset;
+	uint ray_query_cnt;
+} push_data;
+
+// Queried rays of all frames in flight, with the current frame's ray_query_cnt starting at ray_query_offset. origin is in
+// world space, and direction need not be normalized. Read when RAY_QUERY is set.
+struct Ray_query
+{
+	vec3 origin;
+	float max_time;
+	vec3 direction;
+};
+
+layout (set = 0, binding = 13) readonly buffer Ray_queries {
+	Ray_query elems[];
+} ray_queries;
+
+// One per element of Ray_queries, matching voxel_volume::ray_hit_t. voxel is the world-space minimum corner of the hit
+// voxel in voxels of level 0, and face is the side through which it was entered, or one of the RAY_HIT_ values below.
+struct Ray_hit
+{
+	ivec3 voxel;
+	float time;
+	uint face;
+	uint level;
+};
+
+layout (set = 0, binding = 14) writeonly buffer Ray_hits {
+	Ray_hit elems[];
+} ray_hits;
+
+const uint RAY_HIT_INSIDE = 6;
+
+const uint RAY_HIT_MISS = 7;
+
+const uint RAY_HIT_CAPPED = 8;
+
+
+
+vec3 calculate_direction(in vec2 invocation, in vec2 render_extent)
+{
+	vec2 invocation_centered = vec2(invocation) - render_extent * 0.5 + 0.5;
+
+	vec3 base_direction = vec3(push_data.direction_delta * invocation_centered, -1.0);
+
+	vec3 normalized_direction = normalize(base_direction);
+
+	return normalized_direction * push_data.direction_rotation;
+}
+
+
+
+void store_result(ivec2 invocation, vec3 ray_time, float min_time, int level)
+{
+	vec3 last_step;
+
+	if(ray_time.x == -1.0)
+		last_step = vec3(0.6, 0.25, 0.1);
+	else if(min_time == ray_time.x)
+		last_step = vec3(0.75, 0.0, 0.0);
+	else if(min_time == ray_time.y)
+		last_step = vec3(0.0, 0.75, 0.0);
+	else
+		last_step = vec3(0.0, 0.0, 0.75);
+		
+	float real_min_time = min_time * float(1 << (level >> BASE_DIM_LOG2));
+
+	imageStore(hit_ids, invocation, vec4(last_step * (1.0 - real_min_time / (1.732 * float(LEVEL_CNT << (BASE_DIM_LOG2 - 1)))), 1.0));
+
+	imageStore(hit_times, invocation, vec4(real_min_time));
+}
+
+
+
+void store_tile_start(ivec2 tile, float start_time, int level_index)
+{
+	imageStore(tile_starts, tile, vec4(start_time, float(level_index), 0.0, 0.0));
+}
+
+
+
+// Offset of a voxel or leaf block within its brick, as laid out by init_fillbricks
+int brick_voxel_offset(ivec3 index, int dim_log2)
+{
+	if (!MORTON_BRICKS)
+		return index.x + (index.y << dim_log2) + (index.z << (dim_log2 * 2));
+
+	uvec3 v = uvec3(index);
+
+	v = (v | (v << 8)) & 0x0300F00Fu;
+	v = (v | (v << 4)) & 0x030C30C3u;
+	v = (v | (v << 2)) & 0x09249249u;
+
+	return int(v.x | (v.y << 1) | (v.z << 2));
+}
+
+// Number of brick voxels read by the current ray, and how many of them were in a different cache line than the previous one
+uint brick_read_cnt = 0;
+
+uint brick_line_cnt = 0;
+
+int last_brick_line = -1;
+
+void count_brick_read(int byte_offset)
+{
+	if (!COUNT_BRICK_LINES)
+		return;
+
+	++brick_read_cnt;
+
+	if ((byte_offset >> 6) != last_brick_line)
+		++brick_line_cnt;
+
+	last_brick_line = byte_offset >> 6;
+}
+
+
+
+bool is_sub_block_occupied(uvec2 brick_mask, ivec3 brick_index)
+{
+	ivec3 sub_block = brick_index >> (BRICK_DIM_LOG2 - 2);
+
+	uint bit = uint(sub_block.x | (sub_block.y << 2) | (sub_block.z << 4));
+
+	return ((bit < 32 ? brick_mask.x >> bit : brick_mask.y >> (bit - 32)) & 1u) != 0u;
+}
+
+
+
+// Pixel, or prepass tile, traced by the invocation. With SWIZZLE_GROUPS set, the groups of a block are dispatched next
+// to each other along x, and each row of blocks along y.
+ivec2 trace_invocation()
+{
+	if (!SWIZZLE_GROUPS)
+		return ivec2(gl_GlobalInvocationID.xy);
+
+	const uint group_in_block = gl_WorkGroupID.x % (SWIZZLE_BLOCK_DIM * SWIZZLE_BLOCK_DIM);
+
+	const uvec2 block = uvec2(gl_WorkGroupID.x / (SWIZZLE_BLOCK_DIM * SWIZZLE_BLOCK_DIM), gl_WorkGroupID.y);
+
+	// Deinterleave the three bits per axis of the Morton index
+	const uvec2 group_in_block_xy = uvec2(
+		(group_in_block & 1u) | ((group_in_block >> 1) & 2u) | ((group_in_block >> 2) & 4u),
+		((group_in_block >> 1) & 1u) | ((group_in_block >> 2) & 2u) | ((group_in_block >> 3) & 4u));
+
+	const uvec2 group = block * SWIZZLE_BLOCK_DIM + group_in_block_xy;
+
+	return ivec2(group * gl_WorkGroupSize.xy + gl_LocalInvocationID.xy);
+}
+
+// Side of the pixel blocks sharing one traced ray when SPARSE_TRACE is 2
+uint trace_rate = 1;
+
+// Range of the previous hit times in the workgroup, as float bits
+shared uint group_min_time;
+
+shared uint group_max_time;
+
+void select_trace_rate()
+{
+	// Uniform across the dispatch, so returning before the barriers is fine
+	if (push_data.previous_image_index == NO_PREVIOUS_IMAGE)
+	{
+		trace_rate = 1;
+
+		return;
+	}
+
+	if (gl_LocalInvocationIndex == 0)
+	{
+		group_min_time = 0xFFFFFFFFu;
+
+		group_max_time = 0u;
+	}
+
+	barrier();
+
+	const ivec2 render_extent = ivec2(push_data.render_extent);
+
+	const float previous_time = imageLoad(hit_times_history[push_data.previous_image_index], min(trace_invocation(), render_extent - 1)).x;
+
+	// Non-negative, including infinity for misses, so the bits order like the floats
+	atomicMin(group_min_time, floatBitsToUint(previous_time));
+
+	atomicMax(group_max_time, floatBitsToUint(previous_time));
+
+	barrier();
+
+	const float min_time = uintBitsToFloat(group_min_time);
+
+	const float max_time = uintBitsToFloat(group_max_time);
+
+	// Groups that only see sky are traced coarsely, groups with both sky and surfaces finely
+	if (isinf(min_time))
+		trace_rate = 4;
+	else if (isinf(max_time) || max_time - min_time > min_time * (1.0 / 16.0))
+		trace_rate = 1;
+	else if (max_time - min_time > min_time * (1.0 / 128.0))
+		trace_rate = 2;
+	else
+		trace_rate = 4;
+
+	// Keep blocks from straddling workgroups, which might select different rates
+	const uint group_alignment = min(gl_WorkGroupSize.x & (~gl_WorkGroupSize.x + 1u), gl_WorkGroupSize.y & (~gl_WorkGroupSize.y + 1u));
+
+	trace_rate = min(trace_rate, group_alignment);
+}
+
+// Pixels that are not traced store their hit time as minus the side of the block holding the pixel that was traced for
+// them, which is 1 for the checkerboard. resolve uses this to fill them in.
+bool is_traced(ivec2 invocation)
+{
+	if (SPARSE_TRACE == 1)
+		return ((uint(invocation.x + invocation.y) + push_data.frame_index) & 1u) == 0u;
+
+	if (SPARSE_TRACE == 2)
+		return (uint(invocation.x | invocation.y) & (trace_rate - 1u)) == 0u;
+
+	return true;
+}
+
+
+// State of a ray being traced, which step_ray advances by one base cell or brick voxel at a time
+struct Ray
+{
+	// Pixel of the ray, or its index relative to ray_query_offset if RAY_QUERY is set
+	ivec2 invocation;
+
+	vec3 origin;
+
+	vec3 direction;
+
+	// Distance beyond which the ray counts as a miss, which is only checked if RAY_QUERY is set
+	float max_time;
+
+	vec3 coefficient;
+
+	vec3 offset;
+
+	vec3 index;
+
+	vec3 time;
+
+	float min_time;
+
+	int loopcnt;
+
+	int level;
+
+	int level_index;
+
+	float level_scale;
+
+	ivec3 level_base;
+
+	vec3 window_min;
+
+	vec3 window_max;
+
+	float prepass_start_time;
+
+	int prepass_start_level;
+
+	// Traversal of the brick of the cell at index, which is only valid while is_in_brick is set
+	bool is_in_brick;
+
+	uint base_value;
+
+	ivec3 brick_index;
+
+	vec3 subindex;
+
+	int brick_buffer_offset;
+
+	uvec2 brick_mask;
+
+	ivec3 atlas_brick_min;
+};
+
+// origin is relative to frame_base, which is a whole cell on every level
+ivec3 get_frame_base()
+{
+	return (push_data.anchor_min >> LEVEL_CNT) << LEVEL_CNT;
+}
+
+// Sets up a ray starting at origin, which is relative to frame_base, on the finest level. direction must be normalized.
+void init_ray(ivec2 invocation, vec3 origin, vec3 direction, out Ray ray)
+{
+	const int BASE_DIM = 1 << BASE_DIM_LOG2;
+
+	ray.invocation = invocation;
+
+	ray.origin = origin;
+
+	ray.direction = direction;
+
+	ray.max_time = intBitsToFloat(0x7F800000);
+
+	ray.index = floor(ray.origin);
+
+	ray.coefficient = 1.0 / ray.direction;
+
+	ray.offset = (vec3(greaterThanEqual(ray.coefficient, vec3(0.0))) - ray.origin) * ray.coefficient;
+
+
+
+	// level_base is the world-space cell index of the origin's level-relative cell, and the window bounds are the
+	// level's resident cells, relative to it. While a volume update is in flight, anchor_min and anchor_max differ and
+	// the window shrinks to the cells that are resident for both of them.
+
+	const ivec3 frame_base = get_frame_base();
+
+	ray.level_base = frame_base;
+
+	ray.window_min = vec3(((push_data.anchor_max >> 1) << 1) - BASE_DIM / 2 - ray.level_base);
+
+	ray.window_max = vec3(((push_data.anchor_min >> 1) << 1) + BASE_DIM / 2 - ray.level_base);
+
+
+
+	ray.time = vec3(-1.0);
+
+	ray.min_time = 0.0;
+
+	ray.loopcnt = 0;
+
+	ray.level = 0;
+
+	ray.level_index = 0;
+
+	ray.level_scale = 1.0;
+
+	ray.prepass_start_time = 0.0;
+
+	ray.prepass_start_level = 0;
+
+	ray.is_in_brick = false;
+
+	brick_read_cnt = 0;
+
+	brick_line_cnt = 0;
+
+	last_brick_line = -1;
+}
+
+// Sets up a ray for the pixel at invocation, or for the tile at invocation if this is the depth prepass. Returns false
+// if the pixel is not traced this frame, in which case it has already been marked for resolve.
+bool begin_ray(ivec2 invocation, out Ray ray)
+{
+	const int BASE_DIM = 1 << BASE_DIM_LOG2;
+
+	if (!DEPTH_PREPASS && !is_traced(invocation))
+	{
+		imageStore(hit_times, invocation, vec4(-float(trace_rate)));
+
+		return false;
+	}
+
+	const vec3 direction = DEPTH_PREPASS
+		? calculate_direction(vec2(invocation * PREPASS_TILE_DIM) + 0.5 * float(PREPASS_TILE_DIM - 1), vec2(push_data.render_extent))
+		: calculate_direction(invocation, vec2(push_data.render_extent));
+
+	init_ray(invocation, push_data.origin, direction, ray);
+
+	const ivec3 frame_base = get_frame_base();
+
+	// Distance at which to start the ray, and the level its start point has to lie on, or -1 if any will do
+	float start_time = 0.0;
+
+	int start_level = -1;
+
+	if (PREPASS_START)
+	{
+		const vec2 tile_start = imageLoad(tile_starts, invocation / PREPASS_TILE_DIM).xy;
+
+		start_time = tile_start.x;
+
+		start_level = int(tile_start.y);
+	}
+
+	if (REPROJECT_START)
+	{
+		const float reprojected_time = uintBitsToFloat(imageLoad(reprojected_times, invocation).x);
+
+		// Start a bit before the surface hit last frame, to make up for the reprojection's coarseness. Where nothing was
+		// reprojected, e.g. due to disocclusion, the distance is infinite and the ray starts as it otherwise would.
+		const float reprojected_start = reprojected_time * (1.0 - 1.0 / 32.0) - 1.0;
+
+		if (!isinf(reprojected_time) && reprojected_start > start_time)
+		{
+			start_time = reprojected_start;
+
+			start_level = -1;
+		}
+	}
+
+	if (PREPASS_START || REPROJECT_START)
+	{
+		// Skip to start_time. For the prepass, this requires the start point to lie on the same level as the tile's
+		// center ray's did. Otherwise its cell may not be covered by the prepass, and the ray is traced from the origin.
+		for (int l = 0; start_time > 0.0 && l != int(LEVEL_CNT); ++l)
+		{
+			const float scale = 1.0 / float(1 << l);
+
+			const ivec3 start_level_base = frame_base >> l;
+
+			const vec3 start_window_min = vec3(((push_data.anchor_max >> (l + 1)) << 1) - BASE_DIM / 2 - start_level_base);
+
+			const vec3 start_window_max = vec3(((push_data.anchor_min >> (l + 1)) << 1) + BASE_DIM / 2 - start_level_base);
+
+			const vec3 start_index = floor(ray.direction * (start_time * scale) + ray.origin * scale);
+
+			if (all(greaterThanEqual(start_index, start_window_min)) && all(lessThan(start_index, start_window_max)))
+			{
+				if (start_level < 0 || l == start_level)
+				{
+					ray.level = l * BASE_DIM;
+
+					ray.level_index = l;
+
+					ray.level_scale = scale;
+
+					ray.level_base = start_level_base;
+
+					ray.window_min = start_window_min;
+
+					ray.window_max = start_window_max;
+
+					ray.index = start_index;
+
+					ray.offset = (vec3(greaterThanEqual(ray.coefficient, vec3(0.0))) - ray.origin * scale) * ray.coefficient;
+
+					ray.min_time = start_time * scale;
+				}
+
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+
+// Writes the result of a queried ray, with voxel taken from the cell at index and the voxel at brick_index within it
+void store_query_result(in Ray ray, float time, uint face)
+{
+	Ray_hit hit;
+
+	hit.voxel = (((ivec3(ray.index) + ray.level_base) << BRICK_DIM_LOG2) + ray.brick_index) << ray.level_index;
+
+	hit.time = time;
+
+	hit.face = face;
+
+	hit.level = uint(ray.level_index);
+
+	ray_hits.elems[push_data.ray_query_offset + uint(ray.invocation.x)] = hit;
+}
+
+// Stores the result of a ray that hit the iteration cap
+void store_capped(in Ray ray)
+{
+	if (RAY_QUERY)
+	{
+		store_query_result(ray, ray.min_time * float(1 << ray.level_index), RAY_HIT_CAPPED);
+	}
+	else if (DEPTH_PREPASS)
+	{
+		store_tile_start(ray.invocation, ray.prepass_start_time, ray.prepass_start_level);
+	}
+	else
+	{
+		imageStore(hit_ids, ray.invocation, vec4(1.0));
+
+		imageStore(hit_times, ray.invocation, vec4(intBitsToFloat(0x7F800000)));
+	}
+}
+
+// Stores the result of a ray that left the coarsest level, or went past its max_time
+void store_miss(in Ray ray)
+{
+	if (RAY_QUERY)
+	{
+		Ray_hit hit;
+
+		hit.voxel = ivec3(0);
+
+		hit.time = intBitsToFloat(0x7F800000);
+
+		hit.face = RAY_HIT_MISS;
+
+		hit.level = 0;
+
+		ray_hits.elems[push_data.ray_query_offset + uint(ray.invocation.x)] = hit;
+	}
+	else if (DEPTH_PREPASS)
+	{
+		store_tile_start(ray.invocation, ray.prepass_start_time, ray.prepass_start_level);
+	}
+	else
+	{
+		imageStore(hit_ids, ray.invocation, vec4(0.0, 0.1, 0.2, 1.0));
+
+		imageStore(hit_times, ray.invocation, vec4(intBitsToFloat(0x7F800000)));
+	}
+}
+
+// Stores the result of a ray that hit the voxel at brick_index in the cell at index
+void store_hit(in Ray ray)
+{
+	if (RAY_QUERY)
+	{
+		const float time = max(ray.min_time, 0.0) * float(1 << ray.level_index);
+
+		// Voxels within a brick are not checked against max_time while stepping, so the hit may lie beyond it
+		if (time > ray.max_time)
+		{
+			store_miss(ray);
+
+			return;
+		}
+
+		const uint axis = ray.min_time == ray.time.x ? 0 : ray.min_time == ray.time.y ? 1 : 2;
+
+		// Times are only negative before the first step, i.e. when the origin lies in the hit voxel
+		const uint face = ray.time.x < 0.0 ? RAY_HIT_INSIDE : axis * 2 + (ray.coefficient[axis] < 0.0 ? 1 : 0);
+
+		store_query_result(ray, time, face);
+	}
+	else
+	{
+		store_result(ray.invocation, ray.time, ray.min_time, ray.level);
+	}
+}
+
+// Moves the ray into the next cell of its level
+void step_cell(inout Ray ray)
+{
+	ray.time = ray.coefficient * ray.index + ray.offset;
+
+	ray.min_time = min(min(ray.time.x, ray.time.y), ray.time.z);
+
+	if (ray.min_time == ray.time.x)
+		ray.index.x += ray.coefficient.x < 0.0 ? -1.0 : 1.0;
+	else if (ray.min_time == ray.time.y)
+		ray.index.y += ray.coefficient.y < 0.0 ? -1.0 : 1.0;
+	else
+		ray.index.z += ray.coefficient.z < 0.0 ? -1.0 : 1.0;
+}
+
+// Moves the ray, which has left its level's window, onto the next coarser level
+void step_level(inout Ray ray)
+{
+	const int BASE_DIM = 1 << BASE_DIM_LOG2;
+
+	ray.level += BASE_DIM;
+
+	++ray.level_index;
+
+	ray.level_base = get_frame_base() >> ray.level_index;
+
+	ray.window_min = vec3(((push_data.anchor_max >> (ray.level_index + 1)) << 1) - BASE_DIM / 2 - ray.level_base);
+
+	ray.window_max = vec3(((push_data.anchor_min >> (ray.level_index + 1)) << 1) + BASE_DIM / 2 - ray.level_base);
+
+
+
+	ray.index = floor(ray.index * 0.5);
+
+	ray.offset = (ray.offset + vec3(greaterThanEqual(ray.coefficient, vec3(0.0))) * ray.coefficient) * 0.5;
+
+
+
+	ray.min_time *= 0.5;
+
+	ray.time *= 0.5;
+
+	ray.level_scale *= 0.5;
+}
+
+// Voxel of the cell at index holding the point where the ray entered it
+ivec3 brick_entry_index(in Ray ray)
+{
+	const vec3 lower_corner = ray.index;
+
+	const vec3 upper_corner = lower_corner + 0.999999;
+
+	const vec3 entry_position = clamp(ray.direction * ray.min_time + ray.origin * ray.level_scale, lower_corner, upper_corner);
+
+	return ivec3(floor(entry_position * float(1 << BRICK_DIM_LOG2))) & ((1 << BRICK_DIM_LOG2) - 1);
+}
+
+// Looks at the voxel at brick_index, or skips the empty sub-block holding it. Returns true if the ray is done.
+bool step_brick(inout Ray ray)
+{
+	const float subindex_step = 1.0 / float(1 << BRICK_DIM_LOG2);
+
+	if (!is_sub_block_occupied(ray.brick_mask, ray.brick_index))
+	{
+		// Jump straight to the voxel through which the ray leaves the empty sub-block
+
+		const int SUB_BLOCK_MASK = (1 << (BRICK_DIM_LOG2 - 2)) - 1;
+
+		ivec3 sub_block_min = ray.brick_index & ~SUB_BLOCK_MASK;
+
+		ivec3 far_index = mix(sub_block_min, sub_block_min + SUB_BLOCK_MASK, greaterThanEqual(ray.coefficient, vec3(0.0)));
+
+		ray.time = ray.coefficient * (ray.subindex + vec3(far_index - ray.brick_index) * subindex_step) + ray.offset;
+
+		ray.min_time = min(min(ray.time.x, ray.time.y), ray.time.z);
+
+		vec3 exit_position = ray.direction * ray.min_time + ray.origin * ray.level_scale;
+
+		ray.brick_index = clamp(ivec3(floor((exit_position - ray.index) * float(1 << BRICK_DIM_LOG2))), sub_block_min, sub_block_min + SUB_BLOCK_MASK);
+
+		if (ray.min_time == ray.time.x)
+			ray.brick_index.x = far_index.x + (ray.coefficient.x < 0.0 ? -1 : 1);
+		else if (ray.min_time == ray.time.y)
+			ray.brick_index.y = far_index.y + (ray.coefficient.y < 0.0 ? -1 : 1);
+		else
+			ray.brick_index.z = far_index.z + (ray.coefficient.z < 0.0 ? -1 : 1);
+
+		ray.subindex = ray.index + vec3(ray.brick_index) * subindex_step - vec3(greaterThanEqual(ray.coefficient, vec3(0.0))) * (float((1 << BRICK_DIM_LOG2) - 1) / float(1 << BRICK_DIM_LOG2));
+
+		ray.brick_buffer_offset = ray.brick_index.x + ray.brick_index.y * (1 << BRICK_DIM_LOG2) + ray.brick_index.z * (1 << (BRICK_DIM_LOG2 * 2));
+
+		return false;
+	}
+
+	const int brick_buffer_begin = int(ray.base_value) * (1 << (BRICK_DIM_LOG2 * 3));
+
+	uint brick_value;
+
+	// Stepping keeps brick_buffer_offset up to date for the linear layout only
+	const int voxel_offset = MORTON_BRICKS ? brick_voxel_offset(ray.brick_index, int(BRICK_DIM_LOG2)) : ray.brick_buffer_offset;
+
+	if (ATLAS_BRICKS)
+	{
+		// Goes through the texture cache, whose tiling is opaque, so no line is counted
+		brick_value = texelFetch(brick_atlas, ray.atlas_brick_min + ray.brick_index, 0).x;
+	}
+	else if (BITPACKED_BRICKS)
+	{
+		brick_value = (bitpacked_bricks.elems[(brick_buffer_begin + voxel_offset) >> 5] >> (voxel_offset & 31)) & 1u;
+
+		count_brick_read(((brick_buffer_begin + voxel_offset) >> 5) * 4);
+	}
+	else if (LEAF_BRICKS)
+	{
+		const int BLOCK_DIM_LOG2 = int(BRICK_DIM_LOG2) - 1;
+
+		const int block_word = int(ray.base_value) * (1 << (BLOCK_DIM_LOG2 * 3)) + brick_voxel_offset(ray.brick_index >> 1, BLOCK_DIM_LOG2);
+
+		uint block_value = leaf_bricks.elems[block_word];
+
+		count_brick_read(block_word * 4);
+
+		if (block_value == 0u || block_value == 0xFFFFFFFFu)
+			brick_value = block_value & 1u;
+		else
+			brick_value = (leaves.elems[(block_value - 1) >> 2] >> (((block_value - 1) & 3) * 8 + (ray.brick_index.x & 1) + ((ray.brick_index.y & 1) << 1) + ((ray.brick_index.z & 1) << 2))) & 1u;
+	}
+	else
+	{
+		brick_value = uint(bricks.elems[brick_buffer_begin + voxel_offset]);
+
+		count_brick_read((brick_buffer_begin + voxel_offset) * 2);
+	}
+
+	if (ray.loopcnt++ == 1024)
+	{
+		store_capped(ray);
+
+		return true;
+	}
+
+	if (brick_value != 0u)
+	{
+		store_hit(ray);
+
+		return true;
+	}
+
+	ray.time = ray.coefficient * ray.subindex + ray.offset;
+
+	ray.min_time = min(min(ray.time.x, ray.time.y), ray.time.z);
+
+	if (ray.min_time == ray.time.x)
+	{
+		ray.subindex.x += ray.coefficient.x < 0.0 ? -subindex_step : subindex_step;
+
+		ray.brick_buffer_offset += ray.coefficient.x < 0.0 ? -1 : 1;
+
+		ray.brick_index.x += ray.coefficient.x < 0.0 ? -1 : 1;
+	}
+	else if (ray.min_time == ray.time.y)
+	{
+		ray.subindex.y += ray.coefficient.y < 0.0 ? -subindex_step : subindex_step;
+
+		ray.brick_buffer_offset += ray.coefficient.y < 0.0 ? -1 << BRICK_DIM_LOG2 : 1 << BRICK_DIM_LOG2;
+
+		ray.brick_index.y += ray.coefficient.y < 0.0 ? -1 : 1;
+	}
+	else
+	{
+		ray.subindex.z += ray.coefficient.z < 0.0 ? -subindex_step : subindex_step;
+
+		ray.brick_buffer_offset += ray.coefficient.z < 0.0 ? -1 << (BRICK_DIM_LOG2 * 2) : 1 << (BRICK_DIM_LOG2 * 2);
+
+		ray.brick_index.z += ray.coefficient.z < 0.0 ? -1 : 1;
+	}
+
+	return false;
+}
+
+// Looks at the base cell at index. Returns true if the ray is done.
+bool step_base_cell(inout Ray ray)
+{
+	const int BASE_DIM = 1 << BASE_DIM_LOG2;
+
+	// Cells wrap around toroidally within their level's slice of the base image
+	ivec3 base_index = (ivec3(ray.index) + ray.level_base) & (BASE_DIM - 1);
+
+	base_index.x += ray.level;
+
+	const uint base_value = imageLoad(base_data, base_index).x;
+
+	if (ray.loopcnt++ == 1024)
+	{
+		store_capped(ray);
+
+		return true;
+	}
+
+	// Every ray of a tile is within tile_spread * t of the center ray's position at distance t
+	const float tile_spread = DEPTH_PREPASS ? 0.5 * float(PREPASS_TILE_DIM) * 1.415 * max(push_data.direction_delta.x, push_data.direction_delta.y) : 0.0;
+
+	if (DEPTH_PREPASS)
+	{
+		// Only base cells are looked at. The tile's rays are in empty space as long as every cell within
+		// tile_spread * t of the center ray, plus one for rounding to cells, is empty, which the distance
+		// field answers. The first cell failing this ends the prepass, with the tile's rays starting at the
+		// entry into the last one passing it.
+
+		const uint distance = (base_value & EMPTY_CELL) != 0 ? imageLoad(distances, base_index).x : 0;
+
+		if (float(distance) <= ray.min_time * tile_spread + 1.0)
+		{
+			store_tile_start(ray.invocation, ray.prepass_start_time, ray.prepass_start_level);
+
+			return true;
+		}
+
+		ray.prepass_start_time = ray.min_time * float(1 << ray.level_index);
+
+		ray.prepass_start_level = ray.level_index;
+	}
+
+	if ((base_value & EMPTY_CELL) != 0)
+	{
+		uint distance = imageLoad(distances, base_index).x;
+
+		// All cells closer than distance are empty
+		int skip_radius = int(distance) - 1;
+
+		if (DEPTH_PREPASS)
+		{
+			// The tile's other rays have to stay inside the empty cells until the center ray leaves the skipped cube,
+			// so the cube shrinks by their spread at its exit time, plus one for rounding to cells. That time is at
+			// most min_time + sqrt(3) * (skip_radius + 1), which gives the largest skip_radius that is safe.
+			skip_radius = int(floor((float(distance) - 2.0 - tile_spread * (ray.min_time + 1.733)) / (1.0 + 1.733 * tile_spread)));
+		}
+
+		if (skip_radius > 0)
+		{
+			// Jump to where the ray leaves the cube of empty cells. The cube is kept inside the window, as anything
+			// beyond it has to be looked up on the next level.
+
+			vec3 empty_min = max(ray.index - float(skip_radius), ray.window_min);
+
+			vec3 empty_max = min(ray.index + float(skip_radius), ray.window_max - 1.0);
+
+			vec3 far_index = mix(empty_min, empty_max, greaterThanEqual(ray.coefficient, vec3(0.0)));
+
+			ray.time = ray.coefficient * far_index + ray.offset;
+
+			ray.min_time = min(min(ray.time.x, ray.time.y), ray.time.z);
+
+			ray.index = clamp(floor(ray.direction * ray.min_time + ray.origin * ray.level_scale), empty_min, empty_max);
+
+			if (ray.min_time == ray.time.x)
+				ray.index.x = far_index.x + (ray.coefficient.x < 0.0 ? -1.0 : 1.0);
+			else if (ray.min_time == ray.time.y)
+				ray.index.y = far_index.y + (ray.coefficient.y < 0.0 ? -1.0 : 1.0);
+			else
+				ray.index.z = far_index.z + (ray.coefficient.z < 0.0 ? -1.0 : 1.0);
+
+			return false;
+		}
+	}
+	else
+	{
+		if ((base_value & FULL_CELL) != 0)
+		{
+			if (RAY_QUERY)
+				ray.brick_index = brick_entry_index(ray);
+
+			store_hit(ray);
+
+			return true;
+		}
+
+		// Enter the brick at the voxel holding the point where the ray entered the cell
+		ray.brick_index = brick_entry_index(ray);
+
+		vec3 ray_index_adjustment = vec3(ray.brick_index) * (1.0 / float(1 << BRICK_DIM_LOG2)) - vec3(greaterThanEqual(ray.coefficient, vec3(0.0))) * (float((1 << BRICK_DIM_LOG2) - 1) / float(1 << BRICK_DIM_LOG2));
+
+		ray.subindex = ray.index + ray_index_adjustment;
+
+		ray.base_value = base_value;
+
+		const uint atlas_dim_mask = (1u << push_data.atlas_dim_log2) - 1;
+
+		ray.atlas_brick_min = ivec3(uvec3(base_value & atlas_dim_mask, (base_value >> push_data.atlas_dim_log2) & atlas_dim_mask, base_value >> (2 * push_data.atlas_dim_log2)) << BRICK_DIM_LOG2);
+
+		ray.brick_buffer_offset = ray.brick_index.x + ray.brick_index.y * (1 << BRICK_DIM_LOG2) + ray.brick_index.z * (1 << (BRICK_DIM_LOG2 * 2));
+
+		ray.brick_mask = brick_masks.elems[base_value];
+
+		ray.is_in_brick = true;
+
+		return false;
+	}
+
+	step_cell(ray);
+
+	return false;
+}
+
+// Advances the ray by one base cell or brick voxel. Returns true once the ray is done and its result is stored.
+bool step_ray(inout Ray ray)
+{
+	if (ray.is_in_brick)
+	{
+		if (max(max(uint(ray.brick_index.x), uint(ray.brick_index.y)), uint(ray.brick_index.z)) < (1 << BRICK_DIM_LOG2))
+			return step_brick(ray);
+
+		ray.is_in_brick = false;
+
+		step_cell(ray);
+
+		return false;
+	}
+
+	if (ray.level_index == int(LEVEL_CNT) || (RAY_QUERY && ray.min_time > ray.max_time * ray.level_scale))
+	{
+		store_miss(ray);
+
+		return true;
+	}
+
+	if (any(lessThan(ray.index, ray.window_min)) || any(greaterThanEqual(ray.index, ray.window_max)))
+	{
+		step_level(ray);
+
+		return false;
+	}
+
+	return step_base_cell(ray);
+}
+
+
+
+// Totals over the sampled rays traced by this invocation, of which only one in 16 is taken, so that the 32-bit
+// counters last for a few hundred frames
+uint sampled_ray_cnt = 0;
+
+uint sampled_brick_read_cnt = 0;
+
+uint sampled_brick_line_cnt = 0;
+
+// Number of calls to step_ray made by this invocation
+uint lane_step_cnt = 0;
+
+void record_ray_stats(ivec2 invocation)
+{
+	if (COUNT_BRICK_LINES && ((invocation.x | invocation.y) & 3) == 0)
+	{
+		++sampled_ray_cnt;
+
+		sampled_brick_read_cnt += brick_read_cnt;
+
+		sampled_brick_line_cnt += brick_line_cnt;
+	}
+}
+
+// Adds this subgroup's statistics to trace_stats. Has to be reached by the whole subgroup. subgroup_step_cnt is the
+// number of steps the subgroup took, so that its lanes were idle for the difference to their own lane_step_cnt.
+void submit_trace_stats(uint subgroup_step_cnt)
+{
+	if (COUNT_BRICK_LINES)
+	{
+		const uint ray_cnt = subgroupAdd(sampled_ray_cnt);
+
+		const uint read_cnt = subgroupAdd(sampled_brick_read_cnt);
+
+		const uint line_cnt = subgroupAdd(sampled_brick_line_cnt);
+
+		if (subgroupElect())
+		{
+			atomicAdd(trace_stats.ray_cnt, ray_cnt);
+
+			atomicAdd(trace_stats.brick_read_cnt, read_cnt);
+
+			atomicAdd(trace_stats.brick_line_cnt, line_cnt);
+		}
+	}
+
+	if (COUNT_LANE_STEPS)
+	{
+		const uint active_step_cnt = subgroupAdd(lane_step_cnt);
+
+		const uint step_cnt = subgroup_step_cnt * gl_SubgroupSize;
+
+		if (subgroupElect())
+		{
+			// Carry into the high word when the low one wraps around
+			if (atomicAdd(trace_stats.lane_step_cnt_low, step_cnt) + step_cnt < step_cnt)
+				atomicAdd(trace_stats.lane_step_cnt_high, 1);
+
+			if (atomicAdd(trace_stats.active_lane_step_cnt_low, active_step_cnt) + active_step_cnt < active_step_cnt)
+				atomicAdd(trace_stats.active_lane_step_cnt_high, 1);
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#include "volume_file.hpp"
+
+#include "file_writer.hpp"
+
+static och::status write_padding(file_writer& file, uint64_t target_offset) noexcept
+{
+	static constexpr uint8_t zeroes[VOLUME_FILE_ALIGNMENT]{};
+
+	return file.write(zeroes, target_offset - file.m_offset);
+}
+
+static uint64_t align_offset(uint64_t offset) noexcept
+{
+	return (offset + VOLUME_FILE_ALIGNMENT - 1) & ~(VOLUME_FILE_ALIGNMENT - 1);
+}
+
+// Checks that a section lies within the file, without overflowing on corrupt offsets or sizes
+static bool is_section_in_file(uint64_t offset, uint64_t bytes, uint64_t file_bytes) noexcept
+{
+	return offset <= file_bytes && bytes <= file_bytes - offset;
+}
+
+och::status write_volume_file(const char* filename, volume_file_header& header, const void* base_data, const void* brick_data, const void* leaf_data) noexcept
+{
+	header.magic = volume_file_header::MAGIC;
+	header.version = volume_file_header::VERSION;
+	header.base_offset = align_offset(sizeof(volume_file_header));
+	header.brick_offset = align_offset(header.base_offset + header.base_bytes);
+	header.leaf_offset = align_offset(header.brick_offset + header.brick_bytes);
+
+	file_writer file;
+
+	check(file.create(filename));
+
+	check(file.write(&header, sizeof(header)));
+
+	check(write_padding(file, header.base_offset));
+
+	check(file.write(base_data, header.base_bytes));
+
+	check(write_padding(file, header.brick_offset));
+
+	check(file.write(brick_data, header.brick_bytes));
+
+	check(write_padding(file, header.leaf_offset));
+
+	check(file.write(leaf_data, header.leaf_bytes));
+
+	return {};
+}
+
+och::status map_volume_file(och::mapped_file<uint8_t>& out_file, const volume_file_header*& out_header, const char* filename) noexcept
+{
+	check(out_file.create(filename, och::fio::access::read, och::fio::open::normal, och::fio::open::fail));
+
+	if (out_file.bytes() < sizeof(volume_file_header))
+		return to_status(och::error::argument_invalid);
+
+	const volume_file_header* header = reinterpret_cast<const volume_file_header*>(out_file.data());
+
+	if (header->magic != volume_file_header::MAGIC || header->version != volume_file_header::VERSION)
+		return to_status(och::error::argument_invalid);
+
+	const uint64_t file_bytes = out_file.bytes();
+
+	if (!is_section_in_file(header->base_offset, header->base_bytes, file_bytes) || !is_section_in_file(header->brick_offset, header->brick_bytes, file_bytes) || !is_section_in_file(header->leaf_offset, header->leaf_bytes, file_bytes))
+		return to_status(och::error::argument_invalid);
+
+	out_header = header;
+
+	return {};
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+#include <och_err.h>
+#include <och_fio.h>
+#include <och_matmath.h>
+
+// On-disk layout of a generated volume, which is laid out so the base image and bricks can be uploaded straight from a
+// mapping of the file:
+//
+// [volume_file_header]
+// [base image, tightly packed as (base_dim * level_cnt) x base_dim x base_dim 32-bit texels, x varying fastest, each
+//  encoded as described in cell_encoding.hpp]
+// [brick_cnt compacted bricks in brick_format, with voxels ordered by brick_layout, starting at brick_offset]
+// [leaf_cnt compacted leaves referenced by brick_format::leaf bricks, one byte each, starting at leaf_offset]
+//
+// All data sections start at multiples of VOLUME_FILE_ALIGNMENT.
+struct volume_file_header
+{
+	static constexpr uint32_t MAGIC = 0x4C565856; // "VXVL"
+
+	static constexpr uint32_t VERSION = 5;
+
+	uint32_t magic;
+
+	uint32_t version;
+
+	uint32_t level_cnt;
+
+	uint32_t base_dim_log2;
+
+	uint32_t brick_dim_log2;
+
+	uint32_t brick_format;
+
+	uint32_t brick_layout;
+
+	och::vec3 gen_offset;
+
+	float gen_scale;
+
+	float gen_cutoff;
+
+	int32_t anchor[3];
+
+	uint32_t brick_cnt;
+
+	uint32_t leaf_cnt;
+
+	uint64_t base_offset;
+
+	uint64_t base_bytes;
+
+	uint64_t brick_offset;
+
+	uint64_t brick_bytes;
+
+	uint64_t leaf_offset;
+
+	uint64_t leaf_bytes;
+};
+
+static constexpr uint64_t VOLUME_FILE_ALIGNMENT = 4096;
+
+// Fills in magic, version and the section offsets of header, and writes it followed by the base image, bricks and leaves to filename
+och::status write_volume_file(const char* filename, volume_file_header& header, const void* base_data, const void* brick_data, const void* leaf_data) noexcept;
+
+// Maps filename and checks that it holds a complete volume of the current version
+och::status map_volume_file(och::mapped_file<uint8_t>& out_file, const volume_file_header*& out_header, const char* filename) noexcept;
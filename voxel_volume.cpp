@@ -2,10 +2,26 @@
 
 #include "vulkan_base.hpp"
 
+#include "cpu_volume.hpp"
+
+#include "cpu_tracer.hpp"
+
+#include "volume_file.hpp"
+
+#include "cell_encoding.hpp"
+
+#include "parallel_for.hpp"
+
 #include <och_matmath.h>
 #include <och_fmt.h>
 #include <och_timer.h>
 
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <thread>
+
 bool voxel_volume_physical_device_suitable_callback(VkPhysicalDevice device) noexcept
 {
 	VkPhysicalDeviceSubgroupProperties subgroup_props{};
@@ -24,6 +40,9 @@ bool voxel_volume_physical_device_suitable_callback(VkPhysicalDevice device) noe
 	if ((subgroup_props.supportedOperations & VK_SUBGROUP_FEATURE_BALLOT_BIT) == 0)
 		return false;
 
+	if ((subgroup_props.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT) == 0)
+		return false;
+
 
 
 	VkPhysicalDevice16BitStorageFeatures physical_device_16_bit_storage_feats{};
@@ -39,59 +58,252 @@ bool voxel_volume_physical_device_suitable_callback(VkPhysicalDevice device) noe
 	if (physical_device_16_bit_storage_feats.storageBuffer16BitAccess == VK_FALSE)
 		return false;
 
+	// The distance images are r8ui
+	if (feats2.features.shaderStorageImageExtendedFormats == VK_FALSE)
+		return false;
+
+	// hit_times_history is indexed by the previous_image_index push constant
+	if (feats2.features.shaderStorageImageArrayDynamicIndexing == VK_FALSE)
+		return false;
+
 	return true;
 }
 
+enum class brick_format : uint32_t
+{
+	u16,       // One brick_elem_t per voxel
+	bitpacked, // One bit per voxel, packed into 32-bit words in the same linear order
+	leaf,      // One 32-bit word per 2x2x2 block, which is either uniform or refers to a leaf holding the block's voxels
+};
+
+// Order of voxels, or of 2x2x2 blocks for brick_format::leaf, within a brick
+enum class brick_layout : uint32_t
+{
+	linear, // x varying fastest, then y, then z
+	morton, // Z-order, interleaving the bits of x, y and z, so that neighbours along any axis tend to share cache lines
+};
+
+// Which pixels trace casts a ray for. The values match trace.comp's SPARSE_TRACE.
+enum class trace_rate : uint32_t
+{
+	full,         // Every pixel
+	checkerboard, // Every other pixel, alternating between frames
+	variable,     // One pixel per 1x1, 2x2 or 4x4 block, chosen per workgroup from the spread of the previous frame's hit times
+};
+
 struct voxel_volume
 {
 	struct push_constant_data_t
 	{
 		och::vec4 origin;
-		och::vec4 direction_delta;
+		float direction_delta[2];
+		uint32_t render_extent[2];
 		och::vec4 direction_rotation[3];
+		int32_t anchor_min[3];
+		uint32_t frame_index;
+		int32_t anchor_max[3];
+		uint32_t atlas_dim_log2;
+		uint32_t previous_image_index;
+		uint32_t ray_query_offset;
+		uint32_t ray_query_cnt;
+	};
+
+	// Pushed through the trace pipeline layout for the reproject pass, so it must not outgrow push_constant_data_t
+	struct reproject_push_constant_data_t
+	{
+		och::vec4 relative_rotation[3];
+		och::vec4 relative_offset;
+		float direction_delta[2];
+		uint32_t render_extent[2];
+		uint32_t previous_image_index;
 	};
 
+	static_assert(sizeof(reproject_push_constant_data_t) <= sizeof(push_constant_data_t));
+
 	static constexpr uint32_t MAX_FRAMES_INFLIGHT = 2;
 
+	// Profiler frame slot used by the generation command buffer, after those of the frames in flight
+	static constexpr uint32_t GEN_PROFILER_FRAME = MAX_FRAMES_INFLIGHT;
+
 
 
 	using base_elem_t = uint32_t;
 
 	using brick_elem_t = uint16_t;
 
-	using leaf_elem_t = uint16_t;
+	using bitpacked_brick_elem_t = uint32_t;
 
-	static constexpr uint64_t LEVEL_CNT = 5;
+	using leaf_brick_elem_t = uint32_t;
 
-	static constexpr uint64_t BASE_DIM_LOG2 = 6;
+	// Occupancy mask of a leaf's eight voxels, in x, y, z order
+	using leaf_elem_t = uint8_t;
 
-	static constexpr uint64_t BRICK_DIM_LOG2 = 4;
+	// One bit per (brick_dim / 4)^3 sub-block of a brick, set if any of the sub-block's voxels is filled
+	using brick_mask_t = uint64_t;
 
-	static constexpr uint64_t BASE_DIM = 1 << BASE_DIM_LOG2;
+	// Used for any volume geometry not given on the command line or taken from a loaded volume file
+	static constexpr uint32_t DEFAULT_LEVEL_CNT = 5;
 
-	static constexpr uint64_t BRICK_DIM = 1 << BRICK_DIM_LOG2;
+	static constexpr uint32_t DEFAULT_BASE_DIM_LOG2 = 6;
 
-	static constexpr uint64_t BASE_VOL = BASE_DIM * BASE_DIM * BASE_DIM;
+	static constexpr uint32_t DEFAULT_BRICK_DIM_LOG2 = 4;
 
-	static constexpr uint64_t BRICK_VOL = BRICK_DIM * BRICK_DIM * BRICK_DIM;
+	static constexpr uint32_t MAX_LEVEL_CNT = 8;
 
 	static constexpr float BASE_OCCUPANCY = 0.0625F;
 
 	static constexpr float BRICK_OCCUPANCY = 0.5F;
 
-	static constexpr uint64_t OCCUPIED_BRICKS = 3 << 17; // static_cast<uint32_t>(BASE_VOL * LEVEL_CNT * BASE_OCCUPANCY);
+	static constexpr uint32_t BRICK_CAPACITY_GRANULARITY = 1 << 12;
+
+	static constexpr uint32_t BRICK_CAPACITY_HEADROOM_DIVISOR = 8;
+
+	static constexpr uint64_t STAGING_RING_BYTES = 1 << 26;
+
+	static constexpr uint64_t LEAF_DIM = 2;
+
+	static constexpr uint64_t LEAF_VOL = LEAF_DIM * LEAF_DIM * LEAF_DIM;
+
+	// Initial leaf pool capacity for brick_format::leaf. Like the brick pool, it grows when a build runs out of leaves.
+	static constexpr uint64_t OCCUPIED_LEAVES = 1 << 20; // static_cast<uint32_t>(initial_brick_capacity() * brick_vol * BRICK_OCCUPANCY);
+
 
-	static constexpr uint64_t BRICK_BYTES = OCCUPIED_BRICKS * BRICK_VOL * sizeof(brick_elem_t);
 
-	static constexpr uint64_t OCCUPIED_LEAVES = 1 << 20; // static_cast<uint32_t>(OCCUPIED_BRICKS * BRICK_VOL * BRICK_OCCUPANCY);
+	static constexpr uint32_t GENERATION_PASS_CNT = 11;
 
-	static constexpr uint64_t LEAF_BYTES = OCCUPIED_LEAVES * 8 * sizeof(leaf_elem_t);
+	// Index of the first of the three init_distancefield passes, one per axis
+	static constexpr uint32_t DISTANCEFIELD_PASS_BEG = 5;
 
+	// Indices of the init_scancells and init_scanblocks passes, which rank cells for init_assignindex
+	static constexpr uint32_t SCANCELLS_PASS = 8;
+
+	static constexpr uint32_t SCANBLOCKS_PASS = 9;
+
+	// Index of the init_fillatlas pass, which is only recorded when the brick atlas is enabled
+	static constexpr uint32_t FILLATLAS_PASS = 10;
+
+	// Number of consecutive cells in Morton order ranked by one init_scancells workgroup
+	static constexpr uint64_t SCAN_BLOCK_CELLS = 1024;
+
+	static constexpr uint32_t MAX_GENERATION_REGIONS = 3 * MAX_LEVEL_CNT;
+
+	// Side of the pixel tiles sharing one depth prepass ray, matching PREPASS_TILE_DIM in trace.comp
+	static constexpr uint32_t PREPASS_TILE_DIM = 8;
+
+	// Side of the blocks of workgroups that trace walks in Morton order when swizzle_groups is set, matching
+	// SWIZZLE_BLOCK_DIM in trace_common.glsl
+	static constexpr uint32_t SWIZZLE_BLOCK_DIM = 8;
+
+	// Number of workgroups dispatched by the persistent tracer, which is enough to keep any current GPU busy
+	static constexpr uint32_t PERSISTENT_GROUP_CNT = 1024;
+
+	// Number of ray query batches with their own slice of ray_query_buffer and ray_hit_buffer. One more than the
+	// frames in flight, so that the batch being filled never shares its slice with one the GPU is working on.
+	static constexpr uint32_t RAY_QUERY_SLICE_CNT = MAX_FRAMES_INFLIGHT + 1;
+
+	// Values of ray_hit_t::face other than the six sides, matching those in trace_common.glsl
+	static constexpr uint32_t RAY_HIT_INSIDE = 6; // The origin lies in a filled voxel, which is the one reported
+
+	static constexpr uint32_t RAY_HIT_MISS = 7; // Nothing was hit within max_time, and time is infinity
+
+	static constexpr uint32_t RAY_HIT_CAPPED = 8; // The iteration cap was reached at time, without a hit
+
+	// Render extents are multiples of 1 / RENDER_SCALE_STEPS of the swapchain extent along each axis, down to
+	// MIN_RENDER_SCALE_STEPS of them, when tracing at a dynamic resolution
+	static constexpr uint32_t RENDER_SCALE_STEPS = 32;
+
+	static constexpr uint32_t MIN_RENDER_SCALE_STEPS = 8;
+
+	// Number of rays traced by both cpu_tracer and the query pass when validating, capped at ray_query_capacity
+	static constexpr uint32_t VALIDATION_RAY_CNT = 4096;
+
+	// --validate fails once more than one in this many cells or brick voxels differ between the GPU and CPU builds. Some
+	// differences are expected, as the driver may fuse multiply-adds in simplex3d and so flip voxels right at the cutoff.
+	static constexpr uint32_t VALIDATION_VOXEL_TOLERANCE_DIVISOR = 1 << 16;
+
+	// --validate fails once more than one in this many validation rays disagree outright, i.e. neither match nor differ at an edge
+	static constexpr uint32_t VALIDATION_RAY_TOLERANCE_DIVISOR = 256;
+
+
+
+	struct generation_push_constant_data_t
+	{
+		och::vec3 offset;
+		float scale;
+		int32_t region_min[3];
+		uint32_t level;
+		uint32_t region_extent[3];
+		float cutoff;
+		uint32_t brick_capacity;
+		uint32_t leaf_capacity;
+		uint32_t atlas_dim_log2;
+		uint32_t resolve_duplicates;
+	};
+
+	// Per-brick bookkeeping for deduplication, mirroring Brick_info in init_dedupbricks
+	struct brick_info_t
+	{
+		uint32_t hash;
+		uint32_t extra_ref_cnt;
+		uint32_t table_slot;
+		uint32_t unused;
+	};
+
+	struct brick_pool_data_t
+	{
+		uint32_t allocated_cnt;
+		uint32_t free_cnt;
+		uint32_t deduplicated_cnt;
+		uint32_t leaf_allocated_cnt;
+		uint32_t leaf_free_cnt;
+	};
+
+	// Counters accumulated by trace. The first three are only written when count_brick_lines is set, over a sample of
+	// one ray in 16, the others only when count_lane_steps is set, as 64-bit counts split into two words.
+	struct trace_stats_data_t
+	{
+		uint32_t ray_cnt;
+		uint32_t brick_read_cnt;
+		uint32_t brick_line_cnt;
+		uint32_t lane_step_cnt_low;
+		uint32_t lane_step_cnt_high;
+		uint32_t active_lane_step_cnt_low;
+		uint32_t active_lane_step_cnt_high;
+	};
+
+	// Ray passed to enqueue_ray_queries, mirroring Ray_query in trace_common.glsl. origin is in the world space of
+	// input_position, and direction need not be normalized.
+	struct ray_query_t
+	{
+		float origin[3];
+		float max_time;
+		float direction[3];
+		uint32_t unused;
+	};
 
+	// Result of a ray query, mirroring Ray_hit in trace_common.glsl. voxel is the world-space minimum corner of the hit
+	// voxel in level 0 voxels, with the voxel spanning 1 << level of them along each axis. time is the distance along
+	// the normalized direction at which it was entered, through the side given by face as 2 * axis + 1 for the
+	// positive and 2 * axis for the negative side, unless face is one of the RAY_HIT_ values.
+	struct ray_hit_t
+	{
+		int32_t voxel[3];
+		float time;
+		uint32_t face;
+		uint32_t level;
+		uint32_t unused[2];
+	};
 
-	static constexpr uint32_t TRACE_GROUP_SIZE_X = 8;
+	// Validation hands the same rays to cpu_tracer and the query pass and compares their hits as they are
+	static_assert(sizeof(ray_query_t) == sizeof(cpu_ray_query) && sizeof(ray_hit_t) == sizeof(cpu_ray_hit));
 
-	static constexpr uint32_t TRACE_GROUP_SIZE_Y = 8;
+	// Box of base cells in world space, given in cells of its level
+	struct generation_region
+	{
+		int32_t min[3];
+		uint32_t extent[3];
+		uint32_t level;
+	};
 
 
 
@@ -105,6 +317,232 @@ struct voxel_volume
 
 
 
+	brick_format brick_fmt = brick_format::bitpacked;
+
+	brick_layout voxel_layout = brick_layout::linear;
+
+	// Have the tracer read bricks from brick_atlas_image through the texture path instead of from brick_buffer.
+	// Generation keeps working on brick_buffer, with init_fillatlas copying every generated brick into the atlas.
+	bool atlas_bricks = false;
+
+	// Volume geometry. Set before create() and validated and expanded by init_geometry().
+	uint64_t level_cnt = DEFAULT_LEVEL_CNT;
+
+	uint64_t base_dim_log2 = DEFAULT_BASE_DIM_LOG2;
+
+	uint64_t brick_dim_log2 = DEFAULT_BRICK_DIM_LOG2;
+
+	uint64_t base_dim{};
+
+	uint64_t brick_dim{};
+
+	uint64_t base_vol{};
+
+	uint64_t brick_vol{};
+
+	// Brick masks always split a brick into 4x4x4 sub-blocks
+	uint64_t sub_block_dim_log2{};
+
+	// Workgroup sizes of the trace, init_checkempty and init_assignindex shaders. The remaining passes derive theirs from the geometry.
+	uint32_t trace_group_size[2]{ 8, 8 };
+
+	uint32_t checkempty_group_size[3]{ 4, 4, 4 };
+
+	uint32_t assignindex_group_size[3]{ 4, 4, 4 };
+
+	och::status init_geometry() noexcept
+	{
+		if (level_cnt < 1 || level_cnt > MAX_LEVEL_CNT)
+			return to_status(och::error::argument_invalid);
+
+		if (base_dim_log2 < 4 || base_dim_log2 > 7)
+			return to_status(och::error::argument_invalid);
+
+		// Leaf bricks need at least a 4x4x4 block of leaves for init_fillbricks' workgroups
+		if (brick_dim_log2 < 3 || brick_dim_log2 > 6)
+			return to_status(och::error::argument_invalid);
+
+		base_dim = static_cast<uint64_t>(1) << base_dim_log2;
+
+		brick_dim = static_cast<uint64_t>(1) << brick_dim_log2;
+
+		base_vol = base_dim * base_dim * base_dim;
+
+		brick_vol = brick_dim * brick_dim * brick_dim;
+
+		sub_block_dim_log2 = brick_dim_log2 - 2;
+
+		if (trace_group_size[0] == 0 || trace_group_size[1] == 0 || trace_group_size[0] * trace_group_size[1] > 1024)
+			return to_status(och::error::argument_invalid);
+
+		// init_checkempty accumulates whole bricks per workgroup
+		for (uint32_t i = 0; i != 3; ++i)
+			if (checkempty_group_size[i] == 0 || brick_dim % checkempty_group_size[i] != 0 || assignindex_group_size[i] == 0)
+				return to_status(och::error::argument_invalid);
+
+		if (checkempty_group_size[0] * checkempty_group_size[1] * checkempty_group_size[2] > 1024)
+			return to_status(och::error::argument_invalid);
+
+		if (assignindex_group_size[0] * assignindex_group_size[1] * assignindex_group_size[2] > 1024)
+			return to_status(och::error::argument_invalid);
+
+		return {};
+	}
+
+	uint32_t initial_brick_capacity() const noexcept
+	{
+		return static_cast<uint32_t>(base_vol * level_cnt * BASE_OCCUPANCY);
+	}
+
+	uint64_t brick_bytes(uint32_t capacity) const noexcept
+	{
+		if (brick_fmt == brick_format::bitpacked)
+			return capacity * brick_vol / 8;
+		else if (brick_fmt == brick_format::leaf)
+			return capacity * (brick_vol / LEAF_VOL) * sizeof(leaf_brick_elem_t);
+		else
+			return capacity * brick_vol * sizeof(brick_elem_t);
+	}
+
+	// Padded to whole words, as the shaders access leaves four at a time
+	static uint64_t leaf_bytes(uint32_t capacity) noexcept
+	{
+		return (static_cast<uint64_t>(capacity) * sizeof(leaf_elem_t) + 3) & ~static_cast<uint64_t>(3);
+	}
+
+	const char* brick_format_name() const noexcept
+	{
+		if (brick_fmt == brick_format::bitpacked)
+			return "bitpacked";
+		else if (brick_fmt == brick_format::leaf)
+			return "leaf";
+		else
+			return "u16";
+	}
+
+
+
+	och::vec3 gen_offset{ 0.0F, 0.0F, 0.0F };
+
+	float gen_scale = 0.01F / static_cast<float>(1 << DEFAULT_BRICK_DIM_LOG2);
+
+	float gen_cutoff = 0.6F;
+
+	// Rebuild the volume on the CPU after the initial GPU build and compare the two
+	bool validate_build = false;
+
+	uint32_t cpu_thread_cnt = std::thread::hardware_concurrency();
+
+	// Rays traced through the CPU volume by validate_volume, along with their hits. run() queues them on its first frame
+	// and compares the query pass's hits against these once they are done.
+	heap_buffer<cpu_ray_query> validation_queries;
+
+	heap_buffer<cpu_ray_hit> validation_hits;
+
+	// Created with cpu_thread_cnt threads by the first validate_volume
+	cpu_tracer validation_tracer;
+
+	// If set, the volume is loaded from this file instead of being generated
+	const char* volume_load_path = nullptr;
+
+	// If set, the volume is written to this file once it has been built or loaded
+	const char* volume_save_path = nullptr;
+
+	och::mapped_file<uint8_t> volume_file;
+
+	const volume_file_header* volume_file_hdr = nullptr;
+
+	// If non-zero, run() returns after this many frames instead of when the window is closed
+	uint64_t frame_limit = 0;
+
+	// If set, the GPU time of every pass is recorded, and its statistics are written to this file as CSV or JSON once run() returns
+	const char* profile_path = nullptr;
+
+	// If set, the GPU time of every pass is recorded even without a profile_path, so that last_build_gpu_ms and
+	// last_trace_gpu_ms get filled in
+	bool measure_gpu_times = false;
+
+	// Wall-clock measurements of the last build_volume and run
+	uint64_t last_build_ms = 0;
+
+	uint64_t last_run_frame_cnt = 0;
+
+	uint64_t last_run_ms = 0;
+
+	// Profiled GPU time of all generation passes of the last build_volume, and of the trace pass per frame of the last
+	// run, averaged over at most its last PROFILER_HISTORY_CNT frames. Zero if no profiler was created.
+	float last_build_gpu_ms = 0.0F;
+
+	float last_trace_gpu_ms = 0.0F;
+
+	// Have trace count the brick reads and distinct 64-byte lines touched per ray into trace_stats_data
+	bool count_brick_lines = false;
+
+	// Trace one ray per PREPASS_TILE_DIM^2 pixel tile through the base cells first, and start the tile's rays where it
+	// found them to be leaving the empty space they all share
+	bool depth_prepass = false;
+
+	// Scatter the previous frame's hit times into the current frame, and start every ray shortly before the nearest
+	// one that lands on its pixel
+	bool reproject_hits = false;
+
+	// Pixels without their own ray are filled in by the resolve pass
+	trace_rate ray_rate = trace_rate::full;
+
+	// Number of frames recorded so far, which alternates the checkerboard
+	uint32_t recorded_frame_cnt = 0;
+
+	// Trace with trace_persistent instead of trace, which takes rays from ray_queue_buffer in a fixed number of
+	// workgroups. Only the main pass is affected, the depth prepass stays with trace. As its workgroups do not own
+	// pixel tiles to select a rate for, it cannot be combined with trace_rate::variable.
+	bool persistent_trace = false;
+
+	// Have the tracer count the steps taken by its subgroups and by their active lanes into trace_stats_data
+	bool count_lane_steps = false;
+
+	// Have trace walk its workgroups block by block in Morton order instead of row by row. Does not affect the
+	// persistent tracer, which hands out its rays in tiles anyway.
+	bool swizzle_groups = false;
+
+	// Maximum number of rays per ray query batch
+	uint32_t ray_query_capacity = 1 << 14;
+
+	// If non-zero, trace into render_images at a resolution that is adjusted every frame to keep the GPU time of the
+	// passes working at it near this many milliseconds, and upscale them into the swapchain images
+	float dynamic_resolution_target_ms = 0.0F;
+
+	// Swapchain extent traced along each axis, in 1 / RENDER_SCALE_STEPS
+	uint32_t render_scale_steps = RENDER_SCALE_STEPS;
+
+	// Extent traced by the last recorded frame, whose history is dropped when the next frame's differs
+	VkExtent2D render_extent{};
+
+	// Batch that is filled by enqueue_ray_queries and traced by the next recorded frame. Batches are numbered by the
+	// frames recording them, with batch n in slice n % RAY_QUERY_SLICE_CNT, and are done once their frame is, see
+	// frame_ray_query_batches. Batch 0 is never used, so that the zero-initialized frame_ray_query_batches refer to none.
+	uint64_t pending_ray_query_batch = 1;
+
+	uint32_t pending_ray_query_cnt = 0;
+
+	// Batch recorded by each frame slot's last frame, which is done once that slot's fence is signaled
+	uint64_t frame_ray_query_batches[MAX_FRAMES_INFLIGHT]{};
+
+	// Camera of the last recorded frame, and the swapchain image holding its hit times. Rotation is indexed as in och::mat3.
+	float previous_rotation[3][3]{};
+
+	och::vec3 previous_position{ 0.0F, 0.0F, 0.0F };
+
+	uint32_t previous_swapchain_idx = 0;
+
+	// Passed to trace as previous_image_index while is_previous_frame_valid is cleared, matching trace_common.glsl
+	static constexpr uint32_t NO_PREVIOUS_IMAGE = 0xFFFFFFFF;
+
+	// Cleared while the previous hit times are undefined or stale, i.e. before the first frame, after recreating the
+	// swapchain and after a volume update has landed
+	bool is_previous_frame_valid = false;
+
+
+
 	vulkan_context ctx{};
 
 
@@ -115,14 +553,81 @@ struct voxel_volume
 
 	VkDeviceMemory base_image_memory{};
 
+	// Chebyshev distance from every base cell to the nearest non-empty one, laid out like base_image
+	VkImage distance_image{};
+
+	VkImageView distance_image_view{};
+
+	VkDeviceMemory distance_image_memory{};
+
+	// Holds the partial distances between the init_distancefield passes, so distance_image only ever holds complete ones
+	VkImage distance_scratch_image{};
+
+	VkImageView distance_scratch_image_view{};
+
+	VkDeviceMemory distance_scratch_image_memory{};
+
 	VkBuffer brick_buffer{};
 
 	VkDeviceMemory brick_memory{};
 
+	uint32_t brick_capacity{};
+
+	// One R8 texel per voxel, holding (1 << atlas_dim_log2) bricks along x and y and as many layers of them along z as
+	// the brick pool needs. Only a single brick is allocated if atlas_bricks is not set.
+	VkImage brick_atlas_image{};
+
+	VkImageView brick_atlas_image_view{};
+
+	VkDeviceMemory brick_atlas_image_memory{};
+
+	VkSampler brick_atlas_sampler{};
+
+	uint32_t atlas_dim_log2{};
+
+	VkBuffer brick_free_stack_buffer{};
+
+	VkDeviceMemory brick_free_stack_memory{};
+
+	VkBuffer brick_free_mask_buffer{};
+
+	VkDeviceMemory brick_free_mask_memory{};
+
+	VkBuffer dedup_table_buffer{};
+
+	VkDeviceMemory dedup_table_memory{};
+
+	VkBuffer brick_info_buffer{};
+
+	VkDeviceMemory brick_info_memory{};
+
+	// Base cell the clipmap windows are currently centered on
+	int32_t volume_anchor[3]{};
+
+	// Base cell the clipmap windows will be centered on once the in-flight volume update completes
+	int32_t pending_volume_anchor[3]{};
+
+	// Base image and bricks are written on the compute queue, uploaded on the transfer queue and read on the general queue
+	VkSharingMode volume_sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+
+	uint32_t volume_queue_family_cnt = 0;
+
+	uint32_t volume_queue_families[3]{};
+
 	VkBuffer leaf_buffer{};
 
 	VkDeviceMemory leaf_memory{};
 
+	uint32_t leaf_capacity{};
+
+	VkBuffer leaf_free_stack_buffer{};
+
+	VkDeviceMemory leaf_free_stack_memory{};
+
+	VkBuffer brick_mask_buffer{};
+
+	VkDeviceMemory brick_mask_memory{};
+
 
 
 	// VkImage hit_index_images[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT]{};
@@ -137,6 +642,31 @@ struct voxel_volume
 
 	VkDeviceMemory hit_times_memory{};
 
+	// Start distance and level of each pixel tile, written by the depth prepass
+	VkImage tile_start_images[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT]{};
+
+	VkImageView tile_start_image_views[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT]{};
+
+	VkDeviceMemory tile_start_memory{};
+
+	// Nearest previous hit time reprojected onto each pixel, written by the reproject pass
+	VkImage reprojected_time_images[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT]{};
+
+	VkImageView reprojected_time_image_views[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT]{};
+
+	VkDeviceMemory reprojected_time_memory{};
+
+	// Traced into instead of the swapchain images, which upscale then fills from them. Only created if
+	// dynamic_resolution_target_ms is non-zero.
+	VkImage render_images[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT]{};
+
+	VkImageView render_image_views[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT]{};
+
+	VkDeviceMemory render_image_memory{};
+
+	// Samples of the profiler's render scope that update_render_scale has already adjusted the render scale by
+	uint64_t render_scale_sample_cnt{};
+
 
 
 	VkDescriptorPool descriptor_pool{};
@@ -151,12 +681,37 @@ struct voxel_volume
 
 	VkShaderModule trace_shader_module{};
 
+	VkShaderModule reproject_shader_module{};
+
+	VkShaderModule resolve_shader_module{};
+
+	VkShaderModule persistent_trace_shader_module{};
+
+	VkShaderModule query_shader_module{};
+
+	VkShaderModule upscale_shader_module{};
+
 	VkDescriptorSetLayout descriptor_set_layout{};
 
 	VkPipelineLayout pipeline_layout{};
 
 	VkPipeline pipeline{};
 
+	// trace with DEPTH_PREPASS set. Only created if depth_prepass is set.
+	VkPipeline prepass_pipeline{};
+
+	// Uses pipeline_layout. Only created if reproject_hits is set.
+	VkPipeline reproject_pipeline{};
+
+	// Uses pipeline_layout. Only created if ray_rate is not trace_rate::full.
+	VkPipeline resolve_pipeline{};
+
+	// Traces the queued rays of the recorded frame's batch. Uses pipeline_layout.
+	VkPipeline query_pipeline{};
+
+	// Uses pipeline_layout. Only created if dynamic_resolution_target_ms is non-zero.
+	VkPipeline upscale_pipeline{};
+
 
 
 	VkSemaphore image_available_semaphores[MAX_FRAMES_INFLIGHT]{};
@@ -171,81 +726,121 @@ struct voxel_volume
 
 
 
-	och::status temp_populate_bricks() noexcept
-	{
-		struct ce_and_fb_push_constant_data_t
-		{
-			och::vec3 offset;
-			float scale;
-			float cutoff;
-		};
+	VkBuffer brick_pool_buffer{};
 
-		static constexpr uint32_t CHECKEMPTY_GROUP_SIZE_X = 4;
-		static constexpr uint32_t CHECKEMPTY_GROUP_SIZE_Y = 4;
-		static constexpr uint32_t CHECKEMPTY_GROUP_SIZE_Z = 4;
+	VkDeviceMemory brick_pool_memory{};
 
-		static constexpr uint32_t ASSIGNINDEX_GROUP_SIZE_X = 4;
-		static constexpr uint32_t ASSIGNINDEX_GROUP_SIZE_Y = 4;
-		static constexpr uint32_t ASSIGNINDEX_GROUP_SIZE_Z = 4;
+	brick_pool_data_t* brick_pool_data{};
 
-		static constexpr uint32_t FILLBRICKS_GROUP_SIZE_X = 4;
-		static constexpr uint32_t FILLBRICKS_GROUP_SIZE_Y = 4;
-		static constexpr uint32_t FILLBRICKS_GROUP_SIZE_Z = 4;
+	VkBuffer trace_stats_buffer{};
 
-		VkCommandPool pop_command_pool;
+	VkDeviceMemory trace_stats_memory{};
 
-		VkCommandBuffer pop_command_buffer;
+	trace_stats_data_t* trace_stats_data{};
 
-		VkDescriptorPool pop_descriptor_pool;
+	// Next ray to be handed out by the persistent tracer
+	VkBuffer ray_queue_buffer{};
 
+	VkDeviceMemory ray_queue_memory{};
 
+	// RAY_QUERY_SLICE_CNT slices of ray_query_capacity queries, and as many hits
+	VkBuffer ray_query_buffer{};
 
-		VkDescriptorSetLayout pop_descriptor_set_layouts[3];
+	VkDeviceMemory ray_query_memory{};
 
-		VkPipelineLayout pop_pipeline_layouts[3];
+	ray_query_t* ray_query_data{};
 
-		VkShaderModule pop_shader_modules[3];
+	VkBuffer ray_hit_buffer{};
 
-		VkPipeline pop_pipelines[3];
+	VkDeviceMemory ray_hit_memory{};
 
-		VkDescriptorSet pop_descriptor_sets[3];
+	ray_hit_t* ray_hit_data{};
 
+	VkBuffer gen_count_buffer{};
 
+	VkDeviceMemory gen_count_memory{};
 
-		VkBuffer pop_atomic_index_buffer;
+	// Header written by init_scanblocks, followed by one brick offset per block of SCAN_BLOCK_CELLS cells
+	VkBuffer gen_scan_buffer{};
 
-		VkDeviceMemory pop_atomic_index_memory;
+	VkDeviceMemory gen_scan_memory{};
 
-		VkBuffer pop_staging_buffer;
+	VkDescriptorSetLayout gen_descriptor_set_layouts[GENERATION_PASS_CNT]{};
 
-		VkDeviceMemory pop_staging_memory;
+	VkPipelineLayout gen_pipeline_layouts[GENERATION_PASS_CNT]{};
 
+	VkShaderModule gen_shader_modules[GENERATION_PASS_CNT]{};
 
+	VkPipeline gen_pipelines[GENERATION_PASS_CNT]{};
 
-		och::print("Started initialising bricks.\n");
+	VkDescriptorPool gen_descriptor_pool{};
 
-		och::timer brick_init_timer;
+	VkDescriptorSet gen_descriptor_sets[GENERATION_PASS_CNT]{};
 
-		
+	VkCommandPool gen_command_pool{};
 
-		// Create atomic counter buffer for indexing into brick buffer.
-		check(ctx.create_buffer(pop_atomic_index_buffer, pop_atomic_index_memory, 
-			4, 
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+	// Signalled by the frame submitted right before an asynchronous volume update, so the update waits for all frames tracing the old window
+	VkSemaphore gen_start_semaphore{};
+
+	// Signalled by an asynchronous volume update and waited on by the first frame tracing the new window
+	VkSemaphore gen_complete_semaphore{};
+
+	VkFence gen_fence{};
+
+	bool is_gen_submit_pending = false;
+
+	bool is_gen_inflight = false;
+
+	bool is_gen_complete_wait_pending = false;
+
+	VkCommandBuffer gen_command_buffer{};
+
+	uint32_t fillbricks_group_size[3]{};
+
+	// Number of fillbricks invocations along each axis of a brick
+	uint32_t fillbricks_cell_dim{};
+
+
+
+	och::status create_generation_resources() noexcept
+	{
+		// For linear bitpacked bricks, each workgroup covers whole rows of a brick, so that it fills two whole words of the brick.
+		// With the morton layout, a 4x4x4 cube of voxels is what occupies 64 consecutive bits instead.
+		const bool row_groups = brick_fmt == brick_format::bitpacked && voxel_layout == brick_layout::linear;
+
+		fillbricks_group_size[0] = row_groups ? static_cast<uint32_t>(brick_dim) : 4;
+		fillbricks_group_size[1] = row_groups ? static_cast<uint32_t>(64 / brick_dim) : 4;
+		fillbricks_group_size[2] = row_groups ? 1 : 4;
+
+		// For leaf bricks, each invocation fills a whole 2x2x2 block
+		fillbricks_cell_dim = brick_fmt == brick_format::leaf ? static_cast<uint32_t>(brick_dim / LEAF_DIM) : static_cast<uint32_t>(brick_dim);
+
+		// Create buffer for temporarily holding number of brick elements for all bricks. init_assignindex resets every entry it consumes.
+		check(ctx.create_buffer(gen_count_buffer, gen_count_memory, 
+			base_dim* base_dim* base_dim* level_cnt * 4, 
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 
-		// Create buffer for temporarily holding number of brick elements for all bricks
-		check(ctx.create_buffer(pop_staging_buffer, pop_staging_memory, 
-			BASE_DIM* BASE_DIM* BASE_DIM* LEVEL_CNT * 4, 
+		// Create buffer for the brick offsets of each scan block. It is rewritten completely by every build.
+		check(ctx.create_buffer(gen_scan_buffer, gen_scan_memory, 
+			(4 + base_vol * level_cnt / SCAN_BLOCK_CELLS) * sizeof(uint32_t), 
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 
+		// Create brick pool counters, which are read back after every build to check for overflow
+		check(ctx.create_buffer(brick_pool_buffer, brick_pool_memory, 
+			sizeof(brick_pool_data_t), 
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+		check(vkMapMemory(ctx.m_device, brick_pool_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&brick_pool_data)));
+
 		// Create Pipelines
 		{
-			uint32_t binding_cnts[]{ 1, 3, 2 };
-			uint32_t binding_begs[]{ 0, 1, 4 };
+			uint32_t binding_cnts[]{ 1, 5, 6, 7, 6, 3, 3, 3, 2, 4, 4 };
+			uint32_t binding_begs[]{ 0, 1, 6, 12, 19, 25, 28, 31, 34, 36, 40 };
 
-			VkDescriptorSetLayoutBinding bindings[6];
+			VkDescriptorSetLayoutBinding bindings[44];
 			// checkempty
 			bindings[0].binding = 0;
 			bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -268,64 +863,336 @@ struct voxel_volume
 			bindings[3].descriptorCount = 1;
 			bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 			bindings[3].pImmutableSamplers = nullptr;
-			// fillbricks
-			bindings[4].binding = 0;
-			bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[4].binding = 3;
+			bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 			bindings[4].descriptorCount = 1;
 			bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 			bindings[4].pImmutableSamplers = nullptr;
-			bindings[5].binding = 1;
+			bindings[5].binding = 4;
 			bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 			bindings[5].descriptorCount = 1;
 			bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 			bindings[5].pImmutableSamplers = nullptr;
+			// fillbricks
+			bindings[6].binding = 0;
+			bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[6].descriptorCount = 1;
+			bindings[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[6].pImmutableSamplers = nullptr;
+			bindings[7].binding = 1;
+			bindings[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[7].descriptorCount = 1;
+			bindings[7].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[7].pImmutableSamplers = nullptr;
+			bindings[8].binding = 2;
+			bindings[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[8].descriptorCount = 1;
+			bindings[8].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[8].pImmutableSamplers = nullptr;
+			bindings[9].binding = 3;
+			bindings[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[9].descriptorCount = 1;
+			bindings[9].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[9].pImmutableSamplers = nullptr;
+			bindings[10].binding = 4;
+			bindings[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[10].descriptorCount = 1;
+			bindings[10].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[10].pImmutableSamplers = nullptr;
+			bindings[11].binding = 5;
+			bindings[11].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[11].descriptorCount = 1;
+			bindings[11].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[11].pImmutableSamplers = nullptr;
+			// releasebricks
+			bindings[12].binding = 0;
+			bindings[12].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[12].descriptorCount = 1;
+			bindings[12].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[12].pImmutableSamplers = nullptr;
+			bindings[13].binding = 1;
+			bindings[13].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[13].descriptorCount = 1;
+			bindings[13].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[13].pImmutableSamplers = nullptr;
+			bindings[14].binding = 2;
+			bindings[14].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[14].descriptorCount = 1;
+			bindings[14].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[14].pImmutableSamplers = nullptr;
+			bindings[15].binding = 3;
+			bindings[15].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[15].descriptorCount = 1;
+			bindings[15].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[15].pImmutableSamplers = nullptr;
+			bindings[16].binding = 4;
+			bindings[16].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[16].descriptorCount = 1;
+			bindings[16].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[16].pImmutableSamplers = nullptr;
+			bindings[17].binding = 5;
+			bindings[17].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[17].descriptorCount = 1;
+			bindings[17].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[17].pImmutableSamplers = nullptr;
+			bindings[18].binding = 6;
+			bindings[18].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[18].descriptorCount = 1;
+			bindings[18].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[18].pImmutableSamplers = nullptr;
+			// dedupbricks
+			bindings[19].binding = 0;
+			bindings[19].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[19].descriptorCount = 1;
+			bindings[19].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[19].pImmutableSamplers = nullptr;
+			bindings[20].binding = 1;
+			bindings[20].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[20].descriptorCount = 1;
+			bindings[20].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[20].pImmutableSamplers = nullptr;
+			bindings[21].binding = 2;
+			bindings[21].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[21].descriptorCount = 1;
+			bindings[21].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[21].pImmutableSamplers = nullptr;
+			bindings[22].binding = 3;
+			bindings[22].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[22].descriptorCount = 1;
+			bindings[22].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[22].pImmutableSamplers = nullptr;
+			bindings[23].binding = 4;
+			bindings[23].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[23].descriptorCount = 1;
+			bindings[23].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[23].pImmutableSamplers = nullptr;
+			bindings[24].binding = 5;
+			bindings[24].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[24].descriptorCount = 1;
+			bindings[24].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[24].pImmutableSamplers = nullptr;
+			// distancefield x, from the base image into the scratch image
+			bindings[25].binding = 0;
+			bindings[25].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[25].descriptorCount = 1;
+			bindings[25].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[25].pImmutableSamplers = nullptr;
+			bindings[26].binding = 1;
+			bindings[26].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[26].descriptorCount = 1;
+			bindings[26].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[26].pImmutableSamplers = nullptr;
+			bindings[27].binding = 2;
+			bindings[27].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[27].descriptorCount = 1;
+			bindings[27].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[27].pImmutableSamplers = nullptr;
+			// distancefield y, in place on the scratch image
+			bindings[28].binding = 0;
+			bindings[28].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[28].descriptorCount = 1;
+			bindings[28].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[28].pImmutableSamplers = nullptr;
+			bindings[29].binding = 1;
+			bindings[29].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[29].descriptorCount = 1;
+			bindings[29].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[29].pImmutableSamplers = nullptr;
+			bindings[30].binding = 2;
+			bindings[30].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[30].descriptorCount = 1;
+			bindings[30].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[30].pImmutableSamplers = nullptr;
+			// distancefield z, from the scratch image into the distance image
+			bindings[31].binding = 0;
+			bindings[31].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[31].descriptorCount = 1;
+			bindings[31].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[31].pImmutableSamplers = nullptr;
+			bindings[32].binding = 1;
+			bindings[32].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[32].descriptorCount = 1;
+			bindings[32].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[32].pImmutableSamplers = nullptr;
+			bindings[33].binding = 2;
+			bindings[33].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[33].descriptorCount = 1;
+			bindings[33].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[33].pImmutableSamplers = nullptr;
+			// scancells
+			bindings[34].binding = 0;
+			bindings[34].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[34].descriptorCount = 1;
+			bindings[34].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[34].pImmutableSamplers = nullptr;
+			bindings[35].binding = 1;
+			bindings[35].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[35].descriptorCount = 1;
+			bindings[35].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[35].pImmutableSamplers = nullptr;
+			// scanblocks
+			bindings[36].binding = 0;
+			bindings[36].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[36].descriptorCount = 1;
+			bindings[36].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[36].pImmutableSamplers = nullptr;
+			bindings[37].binding = 1;
+			bindings[37].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[37].descriptorCount = 1;
+			bindings[37].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[37].pImmutableSamplers = nullptr;
+			bindings[38].binding = 2;
+			bindings[38].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[38].descriptorCount = 1;
+			bindings[38].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[38].pImmutableSamplers = nullptr;
+			bindings[39].binding = 3;
+			bindings[39].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[39].descriptorCount = 1;
+			bindings[39].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[39].pImmutableSamplers = nullptr;
+			// fillatlas
+			bindings[40].binding = 0;
+			bindings[40].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[40].descriptorCount = 1;
+			bindings[40].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[40].pImmutableSamplers = nullptr;
+			bindings[41].binding = 1;
+			bindings[41].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[41].descriptorCount = 1;
+			bindings[41].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[41].pImmutableSamplers = nullptr;
+			bindings[42].binding = 2;
+			bindings[42].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[42].descriptorCount = 1;
+			bindings[42].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[42].pImmutableSamplers = nullptr;
+			bindings[43].binding = 3;
+			bindings[43].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			bindings[43].descriptorCount = 1;
+			bindings[43].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[43].pImmutableSamplers = nullptr;
 
-			VkPushConstantRange checkempty_and_fillbricks_push_constant_range;
-			checkempty_and_fillbricks_push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			checkempty_and_fillbricks_push_constant_range.offset = 0;
-			checkempty_and_fillbricks_push_constant_range.size = sizeof(ce_and_fb_push_constant_data_t);
-
-			VkPushConstantRange* push_constant_ranges[3]{ &checkempty_and_fillbricks_push_constant_range, nullptr, &checkempty_and_fillbricks_push_constant_range };
+			VkPushConstantRange push_constant_range;
+			push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			push_constant_range.offset = 0;
+			push_constant_range.size = sizeof(generation_push_constant_data_t);
 
-			const char* shader_module_names[3]{
+			const char* shader_module_names[GENERATION_PASS_CNT]{
 				"../spirv/init_checkempty.comp.spv",
 				"../spirv/init_assignindex.comp.spv",
 				"../spirv/init_fillbricks.comp.spv",
+				"../spirv/init_releasebricks.comp.spv",
+				"../spirv/init_dedupbricks.comp.spv",
+				"../spirv/init_distancefield.comp.spv",
+				"../spirv/init_distancefield.comp.spv",
+				"../spirv/init_distancefield.comp.spv",
+				"../spirv/init_scancells.comp.spv",
+				"../spirv/init_scanblocks.comp.spv",
+				"../spirv/init_fillatlas.comp.spv",
 			};
 
 			struct 
 			{
-				uint32_t group_size_x = CHECKEMPTY_GROUP_SIZE_X;
-				uint32_t group_size_y = CHECKEMPTY_GROUP_SIZE_Y;
-				uint32_t group_size_z = CHECKEMPTY_GROUP_SIZE_Z;
-				uint32_t base_dim_log2 = BASE_DIM_LOG2;
-				uint32_t brick_dim_log2 = BRICK_DIM_LOG2;
+				uint32_t group_size_x;
+				uint32_t group_size_y;
+				uint32_t group_size_z;
+				uint32_t base_dim_log2;
+				uint32_t brick_dim_log2;
 			} checkempty_specialization_data;
 
+			checkempty_specialization_data.group_size_x = checkempty_group_size[0];
+			checkempty_specialization_data.group_size_y = checkempty_group_size[1];
+			checkempty_specialization_data.group_size_z = checkempty_group_size[2];
+			checkempty_specialization_data.base_dim_log2 = static_cast<uint32_t>(base_dim_log2);
+			checkempty_specialization_data.brick_dim_log2 = static_cast<uint32_t>(brick_dim_log2);
+
+			// Also used by releasebricks, which walks the same per-cell grid
 			struct
 			{
-				uint32_t group_size_x = ASSIGNINDEX_GROUP_SIZE_X;
-				uint32_t group_size_y = ASSIGNINDEX_GROUP_SIZE_Y;
-				uint32_t group_size_z = ASSIGNINDEX_GROUP_SIZE_Z;
-				uint32_t base_dim_log2 = BASE_DIM_LOG2;
-				uint32_t brick_dim_log2 = BRICK_DIM_LOG2;
+				uint32_t group_size_x;
+				uint32_t group_size_y;
+				uint32_t group_size_z;
+				uint32_t base_dim_log2;
+				uint32_t brick_dim_log2;
+				VkBool32 leaf_bricks;
 			} assignindex_specialization_data;
 
+			assignindex_specialization_data.group_size_x = assignindex_group_size[0];
+			assignindex_specialization_data.group_size_y = assignindex_group_size[1];
+			assignindex_specialization_data.group_size_z = assignindex_group_size[2];
+			assignindex_specialization_data.base_dim_log2 = static_cast<uint32_t>(base_dim_log2);
+			assignindex_specialization_data.brick_dim_log2 = static_cast<uint32_t>(brick_dim_log2);
+			assignindex_specialization_data.leaf_bricks = brick_fmt == brick_format::leaf;
+
 			struct
 			{
-				uint32_t group_size_x = FILLBRICKS_GROUP_SIZE_X;
-				uint32_t group_size_y = FILLBRICKS_GROUP_SIZE_Y;
-				uint32_t group_size_z = FILLBRICKS_GROUP_SIZE_Z;
-				uint32_t base_dim_log2 = BASE_DIM_LOG2;
-				uint32_t brick_dim_log2 = BRICK_DIM_LOG2;
+				uint32_t group_size_x;
+				uint32_t group_size_y;
+				uint32_t group_size_z;
+				uint32_t base_dim_log2;
+				uint32_t brick_dim_log2;
+				VkBool32 bitpacked_bricks;
+				VkBool32 leaf_bricks;
+				VkBool32 morton_bricks;
 			} fillbricks_specialization_data;
 
-			uint32_t specialization_map_cnts[3]{ 5, 5, 5 };
-			uint32_t specialization_map_begs[3]{ 0, 5, 10 };
+			fillbricks_specialization_data.group_size_x = fillbricks_group_size[0];
+			fillbricks_specialization_data.group_size_y = fillbricks_group_size[1];
+			fillbricks_specialization_data.group_size_z = fillbricks_group_size[2];
+			fillbricks_specialization_data.base_dim_log2 = static_cast<uint32_t>(base_dim_log2);
+			fillbricks_specialization_data.brick_dim_log2 = static_cast<uint32_t>(brick_dim_log2);
+			fillbricks_specialization_data.bitpacked_bricks = brick_fmt == brick_format::bitpacked;
+			fillbricks_specialization_data.leaf_bricks = brick_fmt == brick_format::leaf;
+			fillbricks_specialization_data.morton_bricks = voxel_layout == brick_layout::morton;
+
+			// Workgroup size is fixed at one cell per workgroup
+			struct
+			{
+				uint32_t base_dim_log2;
+				uint32_t brick_dim_log2;
+				VkBool32 bitpacked_bricks;
+				VkBool32 leaf_bricks;
+			} dedupbricks_specialization_data;
+
+			dedupbricks_specialization_data.base_dim_log2 = static_cast<uint32_t>(base_dim_log2);
+			dedupbricks_specialization_data.brick_dim_log2 = static_cast<uint32_t>(brick_dim_log2);
+			dedupbricks_specialization_data.bitpacked_bricks = brick_fmt == brick_format::bitpacked;
+			dedupbricks_specialization_data.leaf_bricks = brick_fmt == brick_format::leaf;
+
+			// Workgroups cover one row of a level along the axis
+			struct distancefield_specialization_data_t
+			{
+				uint32_t group_size_x;
+				uint32_t base_dim_log2;
+				uint32_t axis;
+			} distancefield_specialization_data[3];
+
+			for (uint32_t i = 0; i != 3; ++i)
+			{
+				distancefield_specialization_data[i].group_size_x = static_cast<uint32_t>(base_dim);
+				distancefield_specialization_data[i].base_dim_log2 = static_cast<uint32_t>(base_dim_log2);
+				distancefield_specialization_data[i].axis = i;
+			}
+
+			// Workgroups cover SCAN_BLOCK_CELLS cells, so only the dimensions are specialized
+			struct
+			{
+				uint32_t base_dim_log2;
+				uint32_t brick_dim_log2;
+			} scancells_specialization_data;
+
+			scancells_specialization_data.base_dim_log2 = static_cast<uint32_t>(base_dim_log2);
+			scancells_specialization_data.brick_dim_log2 = static_cast<uint32_t>(brick_dim_log2);
+
+			// scanblocks needs no constants at all.
+			// fillatlas shares fillbricks' constants, but has a fixed workgroup size, so the group size entries are ignored.
+			uint32_t specialization_map_cnts[GENERATION_PASS_CNT]{ 5, 6, 8, 6, 4, 3, 3, 3, 2, 0, 8 };
+			uint32_t specialization_map_begs[GENERATION_PASS_CNT]{ 0, 5, 11, 5, 19, 23, 23, 23, 26, 0, 11 };
 			
-			uint32_t specialization_data_sizes[3]{ sizeof(checkempty_specialization_data), sizeof(assignindex_specialization_data), sizeof(fillbricks_specialization_data) };
+			uint32_t specialization_data_sizes[GENERATION_PASS_CNT]{ sizeof(checkempty_specialization_data), sizeof(assignindex_specialization_data), sizeof(fillbricks_specialization_data), sizeof(assignindex_specialization_data), sizeof(dedupbricks_specialization_data), sizeof(distancefield_specialization_data[0]), sizeof(distancefield_specialization_data[1]), sizeof(distancefield_specialization_data[2]), sizeof(scancells_specialization_data), 0, sizeof(fillbricks_specialization_data) };
 
-			void* specialization_datums[3]{ &checkempty_specialization_data, &assignindex_specialization_data, &fillbricks_specialization_data };
+			void* specialization_datums[GENERATION_PASS_CNT]{ &checkempty_specialization_data, &assignindex_specialization_data, &fillbricks_specialization_data, &assignindex_specialization_data, &dedupbricks_specialization_data, &distancefield_specialization_data[0], &distancefield_specialization_data[1], &distancefield_specialization_data[2], &scancells_specialization_data, nullptr, &fillbricks_specialization_data };
 
 			VkSpecializationMapEntry specialization_map_entries[]{
 				{ 1, offsetof(decltype(checkempty_specialization_data), group_size_x  ), sizeof(checkempty_specialization_data.group_size_x  ) },
@@ -338,16 +1205,29 @@ struct voxel_volume
 				{ 3, offsetof(decltype(assignindex_specialization_data), group_size_z  ), sizeof(assignindex_specialization_data.group_size_z  ) },
 				{ 4, offsetof(decltype(assignindex_specialization_data), base_dim_log2 ), sizeof(assignindex_specialization_data.base_dim_log2 ) },
 				{ 5, offsetof(decltype(assignindex_specialization_data), brick_dim_log2), sizeof(assignindex_specialization_data.brick_dim_log2) },
+				{ 7, offsetof(decltype(assignindex_specialization_data), leaf_bricks   ), sizeof(assignindex_specialization_data.leaf_bricks   ) },
 				{ 1, offsetof(decltype(fillbricks_specialization_data), group_size_x  ), sizeof(fillbricks_specialization_data.group_size_x  ) },
 				{ 2, offsetof(decltype(fillbricks_specialization_data), group_size_y  ), sizeof(fillbricks_specialization_data.group_size_y  ) },
 				{ 3, offsetof(decltype(fillbricks_specialization_data), group_size_z  ), sizeof(fillbricks_specialization_data.group_size_z  ) },
 				{ 4, offsetof(decltype(fillbricks_specialization_data), base_dim_log2 ), sizeof(fillbricks_specialization_data.base_dim_log2 ) },
 				{ 5, offsetof(decltype(fillbricks_specialization_data), brick_dim_log2), sizeof(fillbricks_specialization_data.brick_dim_log2) },
+				{ 6, offsetof(decltype(fillbricks_specialization_data), bitpacked_bricks), sizeof(fillbricks_specialization_data.bitpacked_bricks) },
+				{ 7, offsetof(decltype(fillbricks_specialization_data), leaf_bricks), sizeof(fillbricks_specialization_data.leaf_bricks) },
+				{ 9, offsetof(decltype(fillbricks_specialization_data), morton_bricks), sizeof(fillbricks_specialization_data.morton_bricks) },
+				{ 4, offsetof(decltype(dedupbricks_specialization_data), base_dim_log2 ), sizeof(dedupbricks_specialization_data.base_dim_log2 ) },
+				{ 5, offsetof(decltype(dedupbricks_specialization_data), brick_dim_log2), sizeof(dedupbricks_specialization_data.brick_dim_log2) },
+				{ 6, offsetof(decltype(dedupbricks_specialization_data), bitpacked_bricks), sizeof(dedupbricks_specialization_data.bitpacked_bricks) },
+				{ 7, offsetof(decltype(dedupbricks_specialization_data), leaf_bricks), sizeof(dedupbricks_specialization_data.leaf_bricks) },
+				{ 1, offsetof(distancefield_specialization_data_t, group_size_x ), sizeof(distancefield_specialization_data[0].group_size_x ) },
+				{ 4, offsetof(distancefield_specialization_data_t, base_dim_log2), sizeof(distancefield_specialization_data[0].base_dim_log2) },
+				{ 8, offsetof(distancefield_specialization_data_t, axis         ), sizeof(distancefield_specialization_data[0].axis         ) },
+				{ 4, offsetof(decltype(scancells_specialization_data), base_dim_log2 ), sizeof(scancells_specialization_data.base_dim_log2 ) },
+				{ 5, offsetof(decltype(scancells_specialization_data), brick_dim_log2), sizeof(scancells_specialization_data.brick_dim_log2) },
 			};
 
-			VkSpecializationInfo specialization_infos[3];
+			VkSpecializationInfo specialization_infos[GENERATION_PASS_CNT];
 
-			for (uint32_t i = 0; i != 3; ++i)
+			for (uint32_t i = 0; i != GENERATION_PASS_CNT; ++i)
 			{
 				specialization_infos[i].mapEntryCount = specialization_map_cnts[i];
 				specialization_infos[i].pMapEntries = specialization_map_entries + specialization_map_begs[i];
@@ -355,9 +1235,9 @@ struct voxel_volume
 				specialization_infos[i].pData = specialization_datums[i];
 			}
 
-			VkComputePipelineCreateInfo pipeline_cis[3];
+			VkComputePipelineCreateInfo pipeline_cis[GENERATION_PASS_CNT];
 
-			for (uint32_t i = 0; i != 3; ++i)
+			for (uint32_t i = 0; i != GENERATION_PASS_CNT; ++i)
 			{
 				VkDescriptorSetLayoutCreateInfo descriptor_set_layout_ci{};
 				descriptor_set_layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -366,20 +1246,20 @@ struct voxel_volume
 				descriptor_set_layout_ci.bindingCount = binding_cnts[i];
 				descriptor_set_layout_ci.pBindings = &bindings[binding_begs[i]];
 
-				check(vkCreateDescriptorSetLayout(ctx.m_device, &descriptor_set_layout_ci, nullptr, &pop_descriptor_set_layouts[i]));
+				check(vkCreateDescriptorSetLayout(ctx.m_device, &descriptor_set_layout_ci, nullptr, &gen_descriptor_set_layouts[i]));
 
 				VkPipelineLayoutCreateInfo pipeline_layout_ci{};
 				pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 				pipeline_layout_ci.pNext = nullptr;
 				pipeline_layout_ci.flags = 0;
 				pipeline_layout_ci.setLayoutCount = 1;
-				pipeline_layout_ci.pSetLayouts = &pop_descriptor_set_layouts[i];
-				pipeline_layout_ci.pushConstantRangeCount = push_constant_ranges[i] == nullptr ? 0 : 1;
-				pipeline_layout_ci.pPushConstantRanges = push_constant_ranges[i];
+				pipeline_layout_ci.pSetLayouts = &gen_descriptor_set_layouts[i];
+				pipeline_layout_ci.pushConstantRangeCount = 1;
+				pipeline_layout_ci.pPushConstantRanges = &push_constant_range;
 
-				check(vkCreatePipelineLayout(ctx.m_device, &pipeline_layout_ci, nullptr, &pop_pipeline_layouts[i]));
+				check(vkCreatePipelineLayout(ctx.m_device, &pipeline_layout_ci, nullptr, &gen_pipeline_layouts[i]));
 
-				check(ctx.load_shader_module_file(pop_shader_modules[i], shader_module_names[i]));
+				check(ctx.load_shader_module_file(gen_shader_modules[i], shader_module_names[i]));
 				
 				pipeline_cis[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 				pipeline_cis[i].pNext = nullptr;
@@ -388,1093 +1268,4921 @@ struct voxel_volume
 				pipeline_cis[i].stage.pNext = nullptr;
 				pipeline_cis[i].stage.flags = 0;
 				pipeline_cis[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-				pipeline_cis[i].stage.module = pop_shader_modules[i];
+				pipeline_cis[i].stage.module = gen_shader_modules[i];
 				pipeline_cis[i].stage.pName = "main";
 				pipeline_cis[i].stage.pSpecializationInfo = &specialization_infos[i];
-				pipeline_cis[i].layout = pop_pipeline_layouts[i];
+				pipeline_cis[i].layout = gen_pipeline_layouts[i];
 				pipeline_cis[i].basePipelineHandle = nullptr;
 				pipeline_cis[i].basePipelineIndex = -1;
 			}
 
-			check(vkCreateComputePipelines(ctx.m_device, nullptr, _countof(pipeline_cis), pipeline_cis, nullptr, pop_pipelines));
+			check(vkCreateComputePipelines(ctx.m_device, nullptr, _countof(pipeline_cis), pipeline_cis, nullptr, gen_pipelines));
 		}
 
 		// Create Descriptor Sets
 		{
 			VkDescriptorPoolSize pool_sizes[2];
 			pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			pool_sizes[0].descriptorCount = 2;
+			pool_sizes[0].descriptorCount = 15;
 			pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			pool_sizes[1].descriptorCount = 4;
+			pool_sizes[1].descriptorCount = 29;
 
 			VkDescriptorPoolCreateInfo descriptor_pool_ci{};
 			descriptor_pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 			descriptor_pool_ci.pNext = nullptr;
 			descriptor_pool_ci.flags = 0;
-			descriptor_pool_ci.maxSets = 3;
+			descriptor_pool_ci.maxSets = GENERATION_PASS_CNT;
 			descriptor_pool_ci.poolSizeCount = _countof(pool_sizes);
 			descriptor_pool_ci.pPoolSizes = pool_sizes;
 
-			check(vkCreateDescriptorPool(ctx.m_device, &descriptor_pool_ci, nullptr, &pop_descriptor_pool));
+			check(vkCreateDescriptorPool(ctx.m_device, &descriptor_pool_ci, nullptr, &gen_descriptor_pool));
 
 			VkDescriptorSetAllocateInfo descriptor_set_ai{};
 			descriptor_set_ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 			descriptor_set_ai.pNext = nullptr;
-			descriptor_set_ai.descriptorPool = pop_descriptor_pool;
-			descriptor_set_ai.descriptorSetCount = 3;
-			descriptor_set_ai.pSetLayouts = pop_descriptor_set_layouts;
+			descriptor_set_ai.descriptorPool = gen_descriptor_pool;
+			descriptor_set_ai.descriptorSetCount = GENERATION_PASS_CNT;
+			descriptor_set_ai.pSetLayouts = gen_descriptor_set_layouts;
 
-			check(vkAllocateDescriptorSets(ctx.m_device, &descriptor_set_ai, pop_descriptor_sets));
+			check(vkAllocateDescriptorSets(ctx.m_device, &descriptor_set_ai, gen_descriptor_sets));
 
-			VkDescriptorImageInfo base_image_info{};
-			base_image_info.sampler = nullptr;
-			base_image_info.imageView = base_image_view;
-			base_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-			VkDescriptorBufferInfo atomic_index_buffer_info{};
-			atomic_index_buffer_info.buffer = pop_atomic_index_buffer;
-			atomic_index_buffer_info.offset = 0;
-			atomic_index_buffer_info.range = VK_WHOLE_SIZE;
-
-			VkDescriptorBufferInfo brick_buffer_info{};
-			brick_buffer_info.buffer = brick_buffer;
-			brick_buffer_info.offset = 0;
-			brick_buffer_info.range = VK_WHOLE_SIZE;
-
-			VkDescriptorBufferInfo staging_buffer_info{};
-			staging_buffer_info.buffer = pop_staging_buffer;
-			staging_buffer_info.offset = 0;
-			staging_buffer_info.range = VK_WHOLE_SIZE;
-
-			VkWriteDescriptorSet write_descriptor_sets[6]{};
-			// checkempty
-			write_descriptor_sets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[0].pNext = nullptr;
-			write_descriptor_sets[0].dstSet = pop_descriptor_sets[0];
-			write_descriptor_sets[0].dstBinding = 0;
-			write_descriptor_sets[0].dstArrayElement = 0;
-			write_descriptor_sets[0].descriptorCount = 1;
-			write_descriptor_sets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			write_descriptor_sets[0].pImageInfo = nullptr;
-			write_descriptor_sets[0].pBufferInfo = &staging_buffer_info;
-			write_descriptor_sets[0].pTexelBufferView = nullptr;
-			// assignindex
-			write_descriptor_sets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[1].pNext = nullptr;
-			write_descriptor_sets[1].dstSet = pop_descriptor_sets[1];
-			write_descriptor_sets[1].dstBinding = 0;
-			write_descriptor_sets[1].dstArrayElement = 0;
-			write_descriptor_sets[1].descriptorCount = 1;
-			write_descriptor_sets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			write_descriptor_sets[1].pImageInfo = nullptr;
-			write_descriptor_sets[1].pBufferInfo = &staging_buffer_info;
-			write_descriptor_sets[1].pTexelBufferView = nullptr;
-			write_descriptor_sets[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[2].pNext = nullptr;
-			write_descriptor_sets[2].dstSet = pop_descriptor_sets[1];
-			write_descriptor_sets[2].dstBinding = 1;
-			write_descriptor_sets[2].dstArrayElement = 0;
-			write_descriptor_sets[2].descriptorCount = 1;
-			write_descriptor_sets[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			write_descriptor_sets[2].pImageInfo = nullptr;
-			write_descriptor_sets[2].pBufferInfo = &atomic_index_buffer_info;
-			write_descriptor_sets[2].pTexelBufferView = nullptr;
-			write_descriptor_sets[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[3].pNext = nullptr;
-			write_descriptor_sets[3].dstSet = pop_descriptor_sets[1];
-			write_descriptor_sets[3].dstBinding = 2;
-			write_descriptor_sets[3].dstArrayElement = 0;
-			write_descriptor_sets[3].descriptorCount = 1;
-			write_descriptor_sets[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			write_descriptor_sets[3].pImageInfo = &base_image_info;
-			write_descriptor_sets[3].pBufferInfo = nullptr;
-			write_descriptor_sets[3].pTexelBufferView = nullptr;
-			// fillbricks
-			write_descriptor_sets[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[4].pNext = nullptr;
-			write_descriptor_sets[4].dstSet = pop_descriptor_sets[2];
-			write_descriptor_sets[4].dstBinding = 0;
-			write_descriptor_sets[4].dstArrayElement = 0;
-			write_descriptor_sets[4].descriptorCount = 1;
-			write_descriptor_sets[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			write_descriptor_sets[4].pImageInfo = &base_image_info;
-			write_descriptor_sets[4].pBufferInfo = nullptr;
-			write_descriptor_sets[4].pTexelBufferView = nullptr;
-			write_descriptor_sets[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[5].pNext = nullptr;
-			write_descriptor_sets[5].dstSet = pop_descriptor_sets[2];
-			write_descriptor_sets[5].dstBinding = 1;
-			write_descriptor_sets[5].dstArrayElement = 0;
-			write_descriptor_sets[5].descriptorCount = 1;
-			write_descriptor_sets[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			write_descriptor_sets[5].pImageInfo = nullptr;
-			write_descriptor_sets[5].pBufferInfo = &brick_buffer_info;
-			write_descriptor_sets[5].pTexelBufferView = nullptr;
-
-			vkUpdateDescriptorSets(ctx.m_device, _countof(write_descriptor_sets), write_descriptor_sets, 0, nullptr);
-		}
+			write_generation_descriptor_sets();
+		}
 
 		// Create Command Buffer
 		{
 			VkCommandPoolCreateInfo command_pool_ci{};
 			command_pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 			command_pool_ci.pNext = nullptr;
-			command_pool_ci.flags = 0;
-			command_pool_ci.queueFamilyIndex = ctx.m_general_queues.family_index;
+			command_pool_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			command_pool_ci.queueFamilyIndex = ctx.m_compute_queues.family_index;
 
-			check(vkCreateCommandPool(ctx.m_device, &command_pool_ci, nullptr, &pop_command_pool));
+			check(vkCreateCommandPool(ctx.m_device, &command_pool_ci, nullptr, &gen_command_pool));
 
 			VkCommandBufferAllocateInfo command_buffer_ai{};
 			command_buffer_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 			command_buffer_ai.pNext = nullptr;
-			command_buffer_ai.commandPool = pop_command_pool;
+			command_buffer_ai.commandPool = gen_command_pool;
 			command_buffer_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 			command_buffer_ai.commandBufferCount = 1;
 
-			check(vkAllocateCommandBuffers(ctx.m_device, &command_buffer_ai, &pop_command_buffer));
+			check(vkAllocateCommandBuffers(ctx.m_device, &command_buffer_ai, &gen_command_buffer));
 		}
 
-		och::time submit_time;
-
-		// Submit Command Buffer
+		// Create Synchronization Primitives
 		{
-			VkCommandBufferBeginInfo command_buffer_bi{};
-			command_buffer_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			command_buffer_bi.pNext = nullptr;
-			command_buffer_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-			command_buffer_bi.pInheritanceInfo = nullptr;
+			VkSemaphoreCreateInfo semaphore_ci{};
+			semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphore_ci.pNext = nullptr;
+			semaphore_ci.flags = 0;
 
-			check(vkBeginCommandBuffer(pop_command_buffer, &command_buffer_bi));
+			check(vkCreateSemaphore(ctx.m_device, &semaphore_ci, nullptr, &gen_start_semaphore));
+
+			check(vkCreateSemaphore(ctx.m_device, &semaphore_ci, nullptr, &gen_complete_semaphore));
+
+			VkFenceCreateInfo fence_ci{};
+			fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fence_ci.pNext = nullptr;
+			fence_ci.flags = 0;
 
-			VkImageMemoryBarrier to_transfer_dst_barrier;
-			to_transfer_dst_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			to_transfer_dst_barrier.pNext = nullptr;
-			to_transfer_dst_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-			to_transfer_dst_barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-			to_transfer_dst_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			to_transfer_dst_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			to_transfer_dst_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			to_transfer_dst_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			to_transfer_dst_barrier.image = base_image;
-			to_transfer_dst_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			to_transfer_dst_barrier.subresourceRange.baseMipLevel = 0;
-			to_transfer_dst_barrier.subresourceRange.levelCount = 1;
-			to_transfer_dst_barrier.subresourceRange.baseArrayLayer = 0;
-			to_transfer_dst_barrier.subresourceRange.layerCount = 1;
+			check(vkCreateFence(ctx.m_device, &fence_ci, nullptr, &gen_fence));
+		}
 
-			vkCmdPipelineBarrier(pop_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer_dst_barrier);
+		// Transition base and distance images to the general layout once. From here on, every texel is rewritten by whichever region covers it.
+		{
+			VkCommandBuffer trans_command_buffer;
 
+			check(ctx.begin_onetime_command(trans_command_buffer, gen_command_pool));
+
+			VkImageMemoryBarrier to_storage_barriers[3];
+			to_storage_barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			to_storage_barriers[0].pNext = nullptr;
+			to_storage_barriers[0].srcAccessMask = 0;
+			to_storage_barriers[0].dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
+			to_storage_barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			to_storage_barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			to_storage_barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			to_storage_barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			to_storage_barriers[0].image = base_image;
+			to_storage_barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			to_storage_barriers[0].subresourceRange.baseMipLevel = 0;
+			to_storage_barriers[0].subresourceRange.levelCount = 1;
+			to_storage_barriers[0].subresourceRange.baseArrayLayer = 0;
+			to_storage_barriers[0].subresourceRange.layerCount = 1;
+
+			to_storage_barriers[1] = to_storage_barriers[0];
+			to_storage_barriers[1].image = distance_image;
+
+			to_storage_barriers[2] = to_storage_barriers[0];
+			to_storage_barriers[2].image = distance_scratch_image;
+
+			vkCmdPipelineBarrier(trans_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 3, to_storage_barriers);
+
+			check(ctx.submit_onetime_command(trans_command_buffer, gen_command_pool, ctx.m_compute_queues[0]));
+		}
 
+		return {};
+	}
 
-			VkClearColorValue clear_colour;
-			clear_colour.uint32[0] = 0xFFFF;
-			clear_colour.uint32[1] = 0xFFFF;
-			clear_colour.uint32[2] = 0xFFFF;
-			clear_colour.uint32[3] = 0xFFFF;
+	void destroy_generation_resources() noexcept
+	{
+		vkDestroyFence(ctx.m_device, gen_fence, nullptr);
 
-			VkImageSubresourceRange clear_range;
-			clear_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			clear_range.baseMipLevel = 0;
-			clear_range.levelCount = 1;
-			clear_range.baseArrayLayer = 0;
-			clear_range.layerCount = 1;
+		vkDestroySemaphore(ctx.m_device, gen_complete_semaphore, nullptr);
 
-			vkCmdClearColorImage(pop_command_buffer, base_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_colour, 1, &clear_range);
+		vkDestroySemaphore(ctx.m_device, gen_start_semaphore, nullptr);
 
+		vkDestroyCommandPool(ctx.m_device, gen_command_pool, nullptr);
 
+		vkDestroyDescriptorPool(ctx.m_device, gen_descriptor_pool, nullptr);
 
-			VkImageMemoryBarrier to_storage_barrier;
-			to_storage_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			to_storage_barrier.pNext = nullptr;
-			to_storage_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-			to_storage_barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-			to_storage_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			to_storage_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			to_storage_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			to_storage_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			to_storage_barrier.image = base_image;
-			to_storage_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			to_storage_barrier.subresourceRange.baseMipLevel = 0;
-			to_storage_barrier.subresourceRange.levelCount = 1;
-			to_storage_barrier.subresourceRange.baseArrayLayer = 0;
-			to_storage_barrier.subresourceRange.layerCount = 1;
+		for (uint32_t i = 0; i != GENERATION_PASS_CNT; ++i)
+		{
+			vkDestroyPipeline(ctx.m_device, gen_pipelines[i], nullptr);
 
-			vkCmdPipelineBarrier(pop_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_storage_barrier);
+			vkDestroyShaderModule(ctx.m_device, gen_shader_modules[i], nullptr);
 
+			vkDestroyPipelineLayout(ctx.m_device, gen_pipeline_layouts[i], nullptr);
 
+			vkDestroyDescriptorSetLayout(ctx.m_device, gen_descriptor_set_layouts[i], nullptr);
+		}
 
-			ce_and_fb_push_constant_data_t push_constant_data;
-			push_constant_data.offset = { 0.0F, 0.0F, 0.0F };
-			push_constant_data.scale = 0.01F / static_cast<float>(BRICK_DIM);
-			push_constant_data.cutoff = 0.6F;
+		vkDestroyBuffer(ctx.m_device, brick_pool_buffer, nullptr);
 
-			vkCmdPushConstants(pop_command_buffer, pop_pipeline_layouts[0], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+		vkFreeMemory(ctx.m_device, brick_pool_memory, nullptr);
 
-			vkCmdBindDescriptorSets(pop_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pop_pipeline_layouts[0], 0, 1, &pop_descriptor_sets[0], 0, nullptr);
+		vkDestroyBuffer(ctx.m_device, gen_scan_buffer, nullptr);
 
-			vkCmdBindPipeline(pop_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pop_pipelines[0]);
+		vkFreeMemory(ctx.m_device, gen_scan_memory, nullptr);
 
-			vkCmdDispatch(pop_command_buffer, BASE_DIM * LEVEL_CNT * BRICK_DIM / CHECKEMPTY_GROUP_SIZE_X, BASE_DIM * BRICK_DIM / CHECKEMPTY_GROUP_SIZE_Y, BASE_DIM * BRICK_DIM / CHECKEMPTY_GROUP_SIZE_Z);
+		vkDestroyBuffer(ctx.m_device, gen_count_buffer, nullptr);
 
+		vkFreeMemory(ctx.m_device, gen_count_memory, nullptr);
+	}
 
+	void write_generation_descriptor_sets() noexcept
+	{
+		VkDescriptorImageInfo base_image_info{};
+		base_image_info.sampler = nullptr;
+		base_image_info.imageView = base_image_view;
+		base_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo distance_image_info{};
+		distance_image_info.sampler = nullptr;
+		distance_image_info.imageView = distance_image_view;
+		distance_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo distance_scratch_image_info{};
+		distance_scratch_image_info.sampler = nullptr;
+		distance_scratch_image_info.imageView = distance_scratch_image_view;
+		distance_scratch_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo brick_atlas_image_info{};
+		brick_atlas_image_info.sampler = nullptr;
+		brick_atlas_image_info.imageView = brick_atlas_image_view;
+		brick_atlas_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorBufferInfo brick_pool_buffer_info{};
+		brick_pool_buffer_info.buffer = brick_pool_buffer;
+		brick_pool_buffer_info.offset = 0;
+		brick_pool_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo free_stack_buffer_info{};
+		free_stack_buffer_info.buffer = brick_free_stack_buffer;
+		free_stack_buffer_info.offset = 0;
+		free_stack_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo free_mask_buffer_info{};
+		free_mask_buffer_info.buffer = brick_free_mask_buffer;
+		free_mask_buffer_info.offset = 0;
+		free_mask_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo brick_buffer_info{};
+		brick_buffer_info.buffer = brick_buffer;
+		brick_buffer_info.offset = 0;
+		brick_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo leaf_buffer_info{};
+		leaf_buffer_info.buffer = leaf_buffer;
+		leaf_buffer_info.offset = 0;
+		leaf_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo leaf_free_stack_buffer_info{};
+		leaf_free_stack_buffer_info.buffer = leaf_free_stack_buffer;
+		leaf_free_stack_buffer_info.offset = 0;
+		leaf_free_stack_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo brick_mask_buffer_info{};
+		brick_mask_buffer_info.buffer = brick_mask_buffer;
+		brick_mask_buffer_info.offset = 0;
+		brick_mask_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo dedup_table_buffer_info{};
+		dedup_table_buffer_info.buffer = dedup_table_buffer;
+		dedup_table_buffer_info.offset = 0;
+		dedup_table_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo brick_info_buffer_info{};
+		brick_info_buffer_info.buffer = brick_info_buffer;
+		brick_info_buffer_info.offset = 0;
+		brick_info_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo count_buffer_info{};
+		count_buffer_info.buffer = gen_count_buffer;
+		count_buffer_info.offset = 0;
+		count_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo scan_buffer_info{};
+		scan_buffer_info.buffer = gen_scan_buffer;
+		scan_buffer_info.offset = 0;
+		scan_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet write_descriptor_sets[44]{};
+		// checkempty
+		write_descriptor_sets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[0].pNext = nullptr;
+		write_descriptor_sets[0].dstSet = gen_descriptor_sets[0];
+		write_descriptor_sets[0].dstBinding = 0;
+		write_descriptor_sets[0].dstArrayElement = 0;
+		write_descriptor_sets[0].descriptorCount = 1;
+		write_descriptor_sets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[0].pImageInfo = nullptr;
+		write_descriptor_sets[0].pBufferInfo = &count_buffer_info;
+		write_descriptor_sets[0].pTexelBufferView = nullptr;
+		// assignindex
+		write_descriptor_sets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[1].pNext = nullptr;
+		write_descriptor_sets[1].dstSet = gen_descriptor_sets[1];
+		write_descriptor_sets[1].dstBinding = 0;
+		write_descriptor_sets[1].dstArrayElement = 0;
+		write_descriptor_sets[1].descriptorCount = 1;
+		write_descriptor_sets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[1].pImageInfo = nullptr;
+		write_descriptor_sets[1].pBufferInfo = &count_buffer_info;
+		write_descriptor_sets[1].pTexelBufferView = nullptr;
+		write_descriptor_sets[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[2].pNext = nullptr;
+		write_descriptor_sets[2].dstSet = gen_descriptor_sets[1];
+		write_descriptor_sets[2].dstBinding = 1;
+		write_descriptor_sets[2].dstArrayElement = 0;
+		write_descriptor_sets[2].descriptorCount = 1;
+		write_descriptor_sets[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[2].pImageInfo = nullptr;
+		write_descriptor_sets[2].pBufferInfo = &scan_buffer_info;
+		write_descriptor_sets[2].pTexelBufferView = nullptr;
+		write_descriptor_sets[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[3].pNext = nullptr;
+		write_descriptor_sets[3].dstSet = gen_descriptor_sets[1];
+		write_descriptor_sets[3].dstBinding = 2;
+		write_descriptor_sets[3].dstArrayElement = 0;
+		write_descriptor_sets[3].descriptorCount = 1;
+		write_descriptor_sets[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[3].pImageInfo = &base_image_info;
+		write_descriptor_sets[3].pBufferInfo = nullptr;
+		write_descriptor_sets[3].pTexelBufferView = nullptr;
+		write_descriptor_sets[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[4].pNext = nullptr;
+		write_descriptor_sets[4].dstSet = gen_descriptor_sets[1];
+		write_descriptor_sets[4].dstBinding = 3;
+		write_descriptor_sets[4].dstArrayElement = 0;
+		write_descriptor_sets[4].descriptorCount = 1;
+		write_descriptor_sets[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[4].pImageInfo = nullptr;
+		write_descriptor_sets[4].pBufferInfo = &free_stack_buffer_info;
+		write_descriptor_sets[4].pTexelBufferView = nullptr;
+		write_descriptor_sets[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[5].pNext = nullptr;
+		write_descriptor_sets[5].dstSet = gen_descriptor_sets[1];
+		write_descriptor_sets[5].dstBinding = 4;
+		write_descriptor_sets[5].dstArrayElement = 0;
+		write_descriptor_sets[5].descriptorCount = 1;
+		write_descriptor_sets[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[5].pImageInfo = nullptr;
+		write_descriptor_sets[5].pBufferInfo = &brick_mask_buffer_info;
+		write_descriptor_sets[5].pTexelBufferView = nullptr;
+		// fillbricks
+		write_descriptor_sets[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[6].pNext = nullptr;
+		write_descriptor_sets[6].dstSet = gen_descriptor_sets[2];
+		write_descriptor_sets[6].dstBinding = 0;
+		write_descriptor_sets[6].dstArrayElement = 0;
+		write_descriptor_sets[6].descriptorCount = 1;
+		write_descriptor_sets[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[6].pImageInfo = &base_image_info;
+		write_descriptor_sets[6].pBufferInfo = nullptr;
+		write_descriptor_sets[6].pTexelBufferView = nullptr;
+		write_descriptor_sets[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[7].pNext = nullptr;
+		write_descriptor_sets[7].dstSet = gen_descriptor_sets[2];
+		write_descriptor_sets[7].dstBinding = 1;
+		write_descriptor_sets[7].dstArrayElement = 0;
+		write_descriptor_sets[7].descriptorCount = 1;
+		write_descriptor_sets[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[7].pImageInfo = nullptr;
+		write_descriptor_sets[7].pBufferInfo = &brick_buffer_info;
+		write_descriptor_sets[7].pTexelBufferView = nullptr;
+		write_descriptor_sets[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[8].pNext = nullptr;
+		write_descriptor_sets[8].dstSet = gen_descriptor_sets[2];
+		write_descriptor_sets[8].dstBinding = 2;
+		write_descriptor_sets[8].dstArrayElement = 0;
+		write_descriptor_sets[8].descriptorCount = 1;
+		write_descriptor_sets[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[8].pImageInfo = nullptr;
+		write_descriptor_sets[8].pBufferInfo = &leaf_buffer_info;
+		write_descriptor_sets[8].pTexelBufferView = nullptr;
+		write_descriptor_sets[9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[9].pNext = nullptr;
+		write_descriptor_sets[9].dstSet = gen_descriptor_sets[2];
+		write_descriptor_sets[9].dstBinding = 3;
+		write_descriptor_sets[9].dstArrayElement = 0;
+		write_descriptor_sets[9].descriptorCount = 1;
+		write_descriptor_sets[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[9].pImageInfo = nullptr;
+		write_descriptor_sets[9].pBufferInfo = &brick_pool_buffer_info;
+		write_descriptor_sets[9].pTexelBufferView = nullptr;
+		write_descriptor_sets[10].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[10].pNext = nullptr;
+		write_descriptor_sets[10].dstSet = gen_descriptor_sets[2];
+		write_descriptor_sets[10].dstBinding = 4;
+		write_descriptor_sets[10].dstArrayElement = 0;
+		write_descriptor_sets[10].descriptorCount = 1;
+		write_descriptor_sets[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[10].pImageInfo = nullptr;
+		write_descriptor_sets[10].pBufferInfo = &leaf_free_stack_buffer_info;
+		write_descriptor_sets[10].pTexelBufferView = nullptr;
+		write_descriptor_sets[11].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[11].pNext = nullptr;
+		write_descriptor_sets[11].dstSet = gen_descriptor_sets[2];
+		write_descriptor_sets[11].dstBinding = 5;
+		write_descriptor_sets[11].dstArrayElement = 0;
+		write_descriptor_sets[11].descriptorCount = 1;
+		write_descriptor_sets[11].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[11].pImageInfo = nullptr;
+		write_descriptor_sets[11].pBufferInfo = &brick_mask_buffer_info;
+		write_descriptor_sets[11].pTexelBufferView = nullptr;
+		// releasebricks
+		write_descriptor_sets[12].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[12].pNext = nullptr;
+		write_descriptor_sets[12].dstSet = gen_descriptor_sets[3];
+		write_descriptor_sets[12].dstBinding = 0;
+		write_descriptor_sets[12].dstArrayElement = 0;
+		write_descriptor_sets[12].descriptorCount = 1;
+		write_descriptor_sets[12].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[12].pImageInfo = nullptr;
+		write_descriptor_sets[12].pBufferInfo = &brick_pool_buffer_info;
+		write_descriptor_sets[12].pTexelBufferView = nullptr;
+		write_descriptor_sets[13].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[13].pNext = nullptr;
+		write_descriptor_sets[13].dstSet = gen_descriptor_sets[3];
+		write_descriptor_sets[13].dstBinding = 1;
+		write_descriptor_sets[13].dstArrayElement = 0;
+		write_descriptor_sets[13].descriptorCount = 1;
+		write_descriptor_sets[13].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[13].pImageInfo = &base_image_info;
+		write_descriptor_sets[13].pBufferInfo = nullptr;
+		write_descriptor_sets[13].pTexelBufferView = nullptr;
+		write_descriptor_sets[14].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[14].pNext = nullptr;
+		write_descriptor_sets[14].dstSet = gen_descriptor_sets[3];
+		write_descriptor_sets[14].dstBinding = 2;
+		write_descriptor_sets[14].dstArrayElement = 0;
+		write_descriptor_sets[14].descriptorCount = 1;
+		write_descriptor_sets[14].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[14].pImageInfo = nullptr;
+		write_descriptor_sets[14].pBufferInfo = &free_mask_buffer_info;
+		write_descriptor_sets[14].pTexelBufferView = nullptr;
+		write_descriptor_sets[15].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[15].pNext = nullptr;
+		write_descriptor_sets[15].dstSet = gen_descriptor_sets[3];
+		write_descriptor_sets[15].dstBinding = 3;
+		write_descriptor_sets[15].dstArrayElement = 0;
+		write_descriptor_sets[15].descriptorCount = 1;
+		write_descriptor_sets[15].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[15].pImageInfo = nullptr;
+		write_descriptor_sets[15].pBufferInfo = &dedup_table_buffer_info;
+		write_descriptor_sets[15].pTexelBufferView = nullptr;
+		write_descriptor_sets[16].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[16].pNext = nullptr;
+		write_descriptor_sets[16].dstSet = gen_descriptor_sets[3];
+		write_descriptor_sets[16].dstBinding = 4;
+		write_descriptor_sets[16].dstArrayElement = 0;
+		write_descriptor_sets[16].descriptorCount = 1;
+		write_descriptor_sets[16].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[16].pImageInfo = nullptr;
+		write_descriptor_sets[16].pBufferInfo = &brick_info_buffer_info;
+		write_descriptor_sets[16].pTexelBufferView = nullptr;
+		write_descriptor_sets[17].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[17].pNext = nullptr;
+		write_descriptor_sets[17].dstSet = gen_descriptor_sets[3];
+		write_descriptor_sets[17].dstBinding = 5;
+		write_descriptor_sets[17].dstArrayElement = 0;
+		write_descriptor_sets[17].descriptorCount = 1;
+		write_descriptor_sets[17].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[17].pImageInfo = nullptr;
+		write_descriptor_sets[17].pBufferInfo = &brick_buffer_info;
+		write_descriptor_sets[17].pTexelBufferView = nullptr;
+		write_descriptor_sets[18].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[18].pNext = nullptr;
+		write_descriptor_sets[18].dstSet = gen_descriptor_sets[3];
+		write_descriptor_sets[18].dstBinding = 6;
+		write_descriptor_sets[18].dstArrayElement = 0;
+		write_descriptor_sets[18].descriptorCount = 1;
+		write_descriptor_sets[18].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[18].pImageInfo = nullptr;
+		write_descriptor_sets[18].pBufferInfo = &leaf_free_stack_buffer_info;
+		write_descriptor_sets[18].pTexelBufferView = nullptr;
+		// dedupbricks
+		write_descriptor_sets[19].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[19].pNext = nullptr;
+		write_descriptor_sets[19].dstSet = gen_descriptor_sets[4];
+		write_descriptor_sets[19].dstBinding = 0;
+		write_descriptor_sets[19].dstArrayElement = 0;
+		write_descriptor_sets[19].descriptorCount = 1;
+		write_descriptor_sets[19].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[19].pImageInfo = &base_image_info;
+		write_descriptor_sets[19].pBufferInfo = nullptr;
+		write_descriptor_sets[19].pTexelBufferView = nullptr;
+		write_descriptor_sets[20].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[20].pNext = nullptr;
+		write_descriptor_sets[20].dstSet = gen_descriptor_sets[4];
+		write_descriptor_sets[20].dstBinding = 1;
+		write_descriptor_sets[20].dstArrayElement = 0;
+		write_descriptor_sets[20].descriptorCount = 1;
+		write_descriptor_sets[20].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[20].pImageInfo = nullptr;
+		write_descriptor_sets[20].pBufferInfo = &brick_buffer_info;
+		write_descriptor_sets[20].pTexelBufferView = nullptr;
+		write_descriptor_sets[21].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[21].pNext = nullptr;
+		write_descriptor_sets[21].dstSet = gen_descriptor_sets[4];
+		write_descriptor_sets[21].dstBinding = 2;
+		write_descriptor_sets[21].dstArrayElement = 0;
+		write_descriptor_sets[21].descriptorCount = 1;
+		write_descriptor_sets[21].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[21].pImageInfo = nullptr;
+		write_descriptor_sets[21].pBufferInfo = &brick_pool_buffer_info;
+		write_descriptor_sets[21].pTexelBufferView = nullptr;
+		write_descriptor_sets[22].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[22].pNext = nullptr;
+		write_descriptor_sets[22].dstSet = gen_descriptor_sets[4];
+		write_descriptor_sets[22].dstBinding = 3;
+		write_descriptor_sets[22].dstArrayElement = 0;
+		write_descriptor_sets[22].descriptorCount = 1;
+		write_descriptor_sets[22].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[22].pImageInfo = nullptr;
+		write_descriptor_sets[22].pBufferInfo = &free_mask_buffer_info;
+		write_descriptor_sets[22].pTexelBufferView = nullptr;
+		write_descriptor_sets[23].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[23].pNext = nullptr;
+		write_descriptor_sets[23].dstSet = gen_descriptor_sets[4];
+		write_descriptor_sets[23].dstBinding = 4;
+		write_descriptor_sets[23].dstArrayElement = 0;
+		write_descriptor_sets[23].descriptorCount = 1;
+		write_descriptor_sets[23].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[23].pImageInfo = nullptr;
+		write_descriptor_sets[23].pBufferInfo = &dedup_table_buffer_info;
+		write_descriptor_sets[23].pTexelBufferView = nullptr;
+		write_descriptor_sets[24].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[24].pNext = nullptr;
+		write_descriptor_sets[24].dstSet = gen_descriptor_sets[4];
+		write_descriptor_sets[24].dstBinding = 5;
+		write_descriptor_sets[24].dstArrayElement = 0;
+		write_descriptor_sets[24].descriptorCount = 1;
+		write_descriptor_sets[24].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[24].pImageInfo = nullptr;
+		write_descriptor_sets[24].pBufferInfo = &brick_info_buffer_info;
+		write_descriptor_sets[24].pTexelBufferView = nullptr;
+		// distancefield x, from the base image into the scratch image
+		write_descriptor_sets[25].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[25].pNext = nullptr;
+		write_descriptor_sets[25].dstSet = gen_descriptor_sets[5];
+		write_descriptor_sets[25].dstBinding = 0;
+		write_descriptor_sets[25].dstArrayElement = 0;
+		write_descriptor_sets[25].descriptorCount = 1;
+		write_descriptor_sets[25].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[25].pImageInfo = &base_image_info;
+		write_descriptor_sets[25].pBufferInfo = nullptr;
+		write_descriptor_sets[25].pTexelBufferView = nullptr;
+		write_descriptor_sets[26].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[26].pNext = nullptr;
+		write_descriptor_sets[26].dstSet = gen_descriptor_sets[5];
+		write_descriptor_sets[26].dstBinding = 1;
+		write_descriptor_sets[26].dstArrayElement = 0;
+		write_descriptor_sets[26].descriptorCount = 1;
+		write_descriptor_sets[26].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[26].pImageInfo = &distance_scratch_image_info;
+		write_descriptor_sets[26].pBufferInfo = nullptr;
+		write_descriptor_sets[26].pTexelBufferView = nullptr;
+		write_descriptor_sets[27].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[27].pNext = nullptr;
+		write_descriptor_sets[27].dstSet = gen_descriptor_sets[5];
+		write_descriptor_sets[27].dstBinding = 2;
+		write_descriptor_sets[27].dstArrayElement = 0;
+		write_descriptor_sets[27].descriptorCount = 1;
+		write_descriptor_sets[27].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[27].pImageInfo = &distance_scratch_image_info;
+		write_descriptor_sets[27].pBufferInfo = nullptr;
+		write_descriptor_sets[27].pTexelBufferView = nullptr;
+		// distancefield y, in place on the scratch image
+		write_descriptor_sets[28].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[28].pNext = nullptr;
+		write_descriptor_sets[28].dstSet = gen_descriptor_sets[6];
+		write_descriptor_sets[28].dstBinding = 0;
+		write_descriptor_sets[28].dstArrayElement = 0;
+		write_descriptor_sets[28].descriptorCount = 1;
+		write_descriptor_sets[28].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[28].pImageInfo = &base_image_info;
+		write_descriptor_sets[28].pBufferInfo = nullptr;
+		write_descriptor_sets[28].pTexelBufferView = nullptr;
+		write_descriptor_sets[29].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[29].pNext = nullptr;
+		write_descriptor_sets[29].dstSet = gen_descriptor_sets[6];
+		write_descriptor_sets[29].dstBinding = 1;
+		write_descriptor_sets[29].dstArrayElement = 0;
+		write_descriptor_sets[29].descriptorCount = 1;
+		write_descriptor_sets[29].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[29].pImageInfo = &distance_scratch_image_info;
+		write_descriptor_sets[29].pBufferInfo = nullptr;
+		write_descriptor_sets[29].pTexelBufferView = nullptr;
+		write_descriptor_sets[30].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[30].pNext = nullptr;
+		write_descriptor_sets[30].dstSet = gen_descriptor_sets[6];
+		write_descriptor_sets[30].dstBinding = 2;
+		write_descriptor_sets[30].dstArrayElement = 0;
+		write_descriptor_sets[30].descriptorCount = 1;
+		write_descriptor_sets[30].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[30].pImageInfo = &distance_scratch_image_info;
+		write_descriptor_sets[30].pBufferInfo = nullptr;
+		write_descriptor_sets[30].pTexelBufferView = nullptr;
+		// distancefield z, from the scratch image into the distance image
+		write_descriptor_sets[31].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[31].pNext = nullptr;
+		write_descriptor_sets[31].dstSet = gen_descriptor_sets[7];
+		write_descriptor_sets[31].dstBinding = 0;
+		write_descriptor_sets[31].dstArrayElement = 0;
+		write_descriptor_sets[31].descriptorCount = 1;
+		write_descriptor_sets[31].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[31].pImageInfo = &base_image_info;
+		write_descriptor_sets[31].pBufferInfo = nullptr;
+		write_descriptor_sets[31].pTexelBufferView = nullptr;
+		write_descriptor_sets[32].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[32].pNext = nullptr;
+		write_descriptor_sets[32].dstSet = gen_descriptor_sets[7];
+		write_descriptor_sets[32].dstBinding = 1;
+		write_descriptor_sets[32].dstArrayElement = 0;
+		write_descriptor_sets[32].descriptorCount = 1;
+		write_descriptor_sets[32].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[32].pImageInfo = &distance_scratch_image_info;
+		write_descriptor_sets[32].pBufferInfo = nullptr;
+		write_descriptor_sets[32].pTexelBufferView = nullptr;
+		write_descriptor_sets[33].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[33].pNext = nullptr;
+		write_descriptor_sets[33].dstSet = gen_descriptor_sets[7];
+		write_descriptor_sets[33].dstBinding = 2;
+		write_descriptor_sets[33].dstArrayElement = 0;
+		write_descriptor_sets[33].descriptorCount = 1;
+		write_descriptor_sets[33].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[33].pImageInfo = &distance_image_info;
+		write_descriptor_sets[33].pBufferInfo = nullptr;
+		write_descriptor_sets[33].pTexelBufferView = nullptr;
+		// scancells
+		write_descriptor_sets[34].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[34].pNext = nullptr;
+		write_descriptor_sets[34].dstSet = gen_descriptor_sets[8];
+		write_descriptor_sets[34].dstBinding = 0;
+		write_descriptor_sets[34].dstArrayElement = 0;
+		write_descriptor_sets[34].descriptorCount = 1;
+		write_descriptor_sets[34].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[34].pImageInfo = nullptr;
+		write_descriptor_sets[34].pBufferInfo = &count_buffer_info;
+		write_descriptor_sets[34].pTexelBufferView = nullptr;
+		write_descriptor_sets[35].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[35].pNext = nullptr;
+		write_descriptor_sets[35].dstSet = gen_descriptor_sets[8];
+		write_descriptor_sets[35].dstBinding = 1;
+		write_descriptor_sets[35].dstArrayElement = 0;
+		write_descriptor_sets[35].descriptorCount = 1;
+		write_descriptor_sets[35].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[35].pImageInfo = nullptr;
+		write_descriptor_sets[35].pBufferInfo = &scan_buffer_info;
+		write_descriptor_sets[35].pTexelBufferView = nullptr;
+		// scanblocks
+		write_descriptor_sets[36].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[36].pNext = nullptr;
+		write_descriptor_sets[36].dstSet = gen_descriptor_sets[9];
+		write_descriptor_sets[36].dstBinding = 0;
+		write_descriptor_sets[36].dstArrayElement = 0;
+		write_descriptor_sets[36].descriptorCount = 1;
+		write_descriptor_sets[36].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[36].pImageInfo = nullptr;
+		write_descriptor_sets[36].pBufferInfo = &scan_buffer_info;
+		write_descriptor_sets[36].pTexelBufferView = nullptr;
+		write_descriptor_sets[37].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[37].pNext = nullptr;
+		write_descriptor_sets[37].dstSet = gen_descriptor_sets[9];
+		write_descriptor_sets[37].dstBinding = 1;
+		write_descriptor_sets[37].dstArrayElement = 0;
+		write_descriptor_sets[37].descriptorCount = 1;
+		write_descriptor_sets[37].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[37].pImageInfo = nullptr;
+		write_descriptor_sets[37].pBufferInfo = &brick_pool_buffer_info;
+		write_descriptor_sets[37].pTexelBufferView = nullptr;
+		write_descriptor_sets[38].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[38].pNext = nullptr;
+		write_descriptor_sets[38].dstSet = gen_descriptor_sets[9];
+		write_descriptor_sets[38].dstBinding = 2;
+		write_descriptor_sets[38].dstArrayElement = 0;
+		write_descriptor_sets[38].descriptorCount = 1;
+		write_descriptor_sets[38].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[38].pImageInfo = nullptr;
+		write_descriptor_sets[38].pBufferInfo = &free_stack_buffer_info;
+		write_descriptor_sets[38].pTexelBufferView = nullptr;
+		write_descriptor_sets[39].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[39].pNext = nullptr;
+		write_descriptor_sets[39].dstSet = gen_descriptor_sets[9];
+		write_descriptor_sets[39].dstBinding = 3;
+		write_descriptor_sets[39].dstArrayElement = 0;
+		write_descriptor_sets[39].descriptorCount = 1;
+		write_descriptor_sets[39].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[39].pImageInfo = nullptr;
+		write_descriptor_sets[39].pBufferInfo = &free_mask_buffer_info;
+		write_descriptor_sets[39].pTexelBufferView = nullptr;
+		// fillatlas
+		write_descriptor_sets[40].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[40].pNext = nullptr;
+		write_descriptor_sets[40].dstSet = gen_descriptor_sets[10];
+		write_descriptor_sets[40].dstBinding = 0;
+		write_descriptor_sets[40].dstArrayElement = 0;
+		write_descriptor_sets[40].descriptorCount = 1;
+		write_descriptor_sets[40].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[40].pImageInfo = &base_image_info;
+		write_descriptor_sets[40].pBufferInfo = nullptr;
+		write_descriptor_sets[40].pTexelBufferView = nullptr;
+		write_descriptor_sets[41].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[41].pNext = nullptr;
+		write_descriptor_sets[41].dstSet = gen_descriptor_sets[10];
+		write_descriptor_sets[41].dstBinding = 1;
+		write_descriptor_sets[41].dstArrayElement = 0;
+		write_descriptor_sets[41].descriptorCount = 1;
+		write_descriptor_sets[41].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[41].pImageInfo = nullptr;
+		write_descriptor_sets[41].pBufferInfo = &brick_buffer_info;
+		write_descriptor_sets[41].pTexelBufferView = nullptr;
+		write_descriptor_sets[42].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[42].pNext = nullptr;
+		write_descriptor_sets[42].dstSet = gen_descriptor_sets[10];
+		write_descriptor_sets[42].dstBinding = 2;
+		write_descriptor_sets[42].dstArrayElement = 0;
+		write_descriptor_sets[42].descriptorCount = 1;
+		write_descriptor_sets[42].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write_descriptor_sets[42].pImageInfo = nullptr;
+		write_descriptor_sets[42].pBufferInfo = &leaf_buffer_info;
+		write_descriptor_sets[42].pTexelBufferView = nullptr;
+		write_descriptor_sets[43].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write_descriptor_sets[43].pNext = nullptr;
+		write_descriptor_sets[43].dstSet = gen_descriptor_sets[10];
+		write_descriptor_sets[43].dstBinding = 3;
+		write_descriptor_sets[43].dstArrayElement = 0;
+		write_descriptor_sets[43].descriptorCount = 1;
+		write_descriptor_sets[43].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write_descriptor_sets[43].pImageInfo = &brick_atlas_image_info;
+		write_descriptor_sets[43].pBufferInfo = nullptr;
+		write_descriptor_sets[43].pTexelBufferView = nullptr;
+
+		vkUpdateDescriptorSets(ctx.m_device, _countof(write_descriptor_sets), write_descriptor_sets, 0, nullptr);
+	}
 
-			VkImageMemoryBarrier inter_dispatch_barrier;
-			inter_dispatch_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			inter_dispatch_barrier.pNext = nullptr;
-			inter_dispatch_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-			inter_dispatch_barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
-			inter_dispatch_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-			inter_dispatch_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			inter_dispatch_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			inter_dispatch_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			inter_dispatch_barrier.image = base_image;
-			inter_dispatch_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			inter_dispatch_barrier.subresourceRange.baseMipLevel = 0;
-			inter_dispatch_barrier.subresourceRange.levelCount = 1;
-			inter_dispatch_barrier.subresourceRange.baseArrayLayer = 0;
-			inter_dispatch_barrier.subresourceRange.layerCount = 1;
 
-			VkBufferMemoryBarrier staging_buffer_barrier;
-			staging_buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-			staging_buffer_barrier.pNext = nullptr;
-			staging_buffer_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-			staging_buffer_barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
-			staging_buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			staging_buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			staging_buffer_barrier.buffer = pop_atomic_index_buffer;
-			staging_buffer_barrier.offset = 0;
-			staging_buffer_barrier.size = VK_WHOLE_SIZE;
-			
 
+	// Checks that pools of the given capacities fit into the device's limits, so that create_brick_pool can only fail on
+	// running out of memory
+	och::status check_brick_pool_limits(uint32_t capacity, uint32_t leaf_pool_capacity) const noexcept
+	{
+		VkPhysicalDeviceProperties physical_device_props;
 
-			vkCmdPipelineBarrier(pop_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &staging_buffer_barrier, 1, &inter_dispatch_barrier);
-			
+		vkGetPhysicalDeviceProperties(ctx.m_physical_device, &physical_device_props);
 
+		const uint64_t max_buffer_bytes = physical_device_props.limits.maxStorageBufferRange;
 
-			vkCmdBindDescriptorSets(pop_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pop_pipeline_layouts[1], 0, 1, &pop_descriptor_sets[1], 0, nullptr);
-			
-			vkCmdBindPipeline(pop_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pop_pipelines[1]);
-			
-			vkCmdDispatch(pop_command_buffer, (BASE_DIM * LEVEL_CNT) / ASSIGNINDEX_GROUP_SIZE_X, BASE_DIM / ASSIGNINDEX_GROUP_SIZE_Y, BASE_DIM / ASSIGNINDEX_GROUP_SIZE_Z);
-			
+		const uint64_t buffer_bytes[]{
+			brick_bytes(capacity),
+			static_cast<uint64_t>(capacity) * sizeof(uint32_t),
+			free_mask_word_cnt(capacity) * sizeof(uint32_t),
+			dedup_table_slot_cnt(capacity) * sizeof(uint32_t),
+			static_cast<uint64_t>(capacity) * sizeof(brick_info_t),
+			static_cast<uint64_t>(capacity) * sizeof(brick_mask_t),
+			leaf_bytes(leaf_pool_capacity),
+			static_cast<uint64_t>(leaf_pool_capacity) * sizeof(uint32_t),
+		};
 
+		for (uint32_t i = 0; i != _countof(buffer_bytes); ++i)
+			if (buffer_bytes[i] > max_buffer_bytes)
+				return to_status(och::error::argument_too_large);
 
-			vkCmdPipelineBarrier(pop_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &inter_dispatch_barrier);
-			
-			
-			
-			vkCmdPushConstants(pop_command_buffer, pop_pipeline_layouts[2], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
-			
-			vkCmdBindDescriptorSets(pop_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pop_pipeline_layouts[2], 0, 1, &pop_descriptor_sets[2], 0, nullptr);
-			
-			vkCmdBindPipeline(pop_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pop_pipelines[2]);
-			
-			vkCmdDispatch(pop_command_buffer, BASE_DIM * LEVEL_CNT * BRICK_DIM / FILLBRICKS_GROUP_SIZE_X, BASE_DIM * BRICK_DIM / FILLBRICKS_GROUP_SIZE_Y, BASE_DIM * BRICK_DIM / FILLBRICKS_GROUP_SIZE_Z);
+		if ((brick_dim << get_atlas_dim_log2(atlas_bricks ? capacity : 1)) > physical_device_props.limits.maxImageDimension3D)
+			return to_status(och::error::argument_too_large);
 
+		return {};
+	}
 
+	och::status create_brick_pool(uint32_t capacity, uint32_t leaf_pool_capacity) noexcept
+	{
+		check(check_brick_pool_limits(capacity, leaf_pool_capacity));
 
-			check(vkEndCommandBuffer(pop_command_buffer));
+		const uint64_t bytes = brick_bytes(capacity);
 
+		check(ctx.create_buffer(brick_buffer, brick_memory, bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, volume_sharing_mode, volume_queue_family_cnt, volume_queue_families));
 
+		// Holds indices of bricks released by cells that scrolled out of the clipmap, which are handed out again before new ones
+		check(ctx.create_buffer(brick_free_stack_buffer, brick_free_stack_memory, static_cast<uint64_t>(capacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 
-			VkSubmitInfo submit_info{};
-			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-			submit_info.pNext = nullptr;
-			submit_info.waitSemaphoreCount = 0;
-			submit_info.pWaitSemaphores = nullptr;
-			submit_info.pWaitDstStageMask = nullptr;
-			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &pop_command_buffer;
-			submit_info.signalSemaphoreCount = 0;
-			submit_info.pSignalSemaphores = nullptr;
+		// Marks bricks released since the last build, which init_scanblocks moves onto the free stack in index order.
+		// Cleared together with the pool counters by every full rebuild.
+		check(ctx.create_buffer(brick_free_mask_buffer, brick_free_mask_memory, free_mask_word_cnt(capacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 
-			submit_time = och::time::now();
+		// Maps brick contents to the resident brick holding them, so that init_dedupbricks can share identical bricks between cells
+		check(ctx.create_buffer(dedup_table_buffer, dedup_table_memory, dedup_table_slot_cnt(capacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 
-			check(vkQueueSubmit(ctx.m_general_queues[0], 1, &submit_info, nullptr));
-		}
+		check(ctx.create_buffer(brick_info_buffer, brick_info_memory, static_cast<uint64_t>(capacity) * sizeof(brick_info_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, volume_sharing_mode, volume_queue_family_cnt, volume_queue_families));
 
-		check(vkQueueWaitIdle(ctx.m_general_queues[0]));
+		// Lets the tracer step over empty sub-blocks of a brick without looking at their voxels
+		check(ctx.create_buffer(brick_mask_buffer, brick_mask_memory, static_cast<uint64_t>(capacity) * sizeof(brick_mask_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, volume_sharing_mode, volume_queue_family_cnt, volume_queue_families));
 
-		och::print("Time taken on GPU: {}\n", och::time::now() - submit_time);
+		check(ctx.create_buffer(leaf_buffer, leaf_memory, leaf_bytes(leaf_pool_capacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, volume_sharing_mode, volume_queue_family_cnt, volume_queue_families));
 
-		uint32_t* staging_ptr;
+		// Holds indices of leaves released together with their bricks
+		check(ctx.create_buffer(leaf_free_stack_buffer, leaf_free_stack_memory, static_cast<uint64_t>(leaf_pool_capacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 
-		check(vkMapMemory(ctx.m_device, pop_atomic_index_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&staging_ptr)));
+		check(create_brick_atlas(atlas_bricks ? capacity : 1));
 
-		och::print("Brick IDs used: {} / {} ({} remaining)\n", *staging_ptr, static_cast<uint32_t>(OCCUPIED_BRICKS), static_cast<int32_t>(OCCUPIED_BRICKS - *staging_ptr));
+		brick_capacity = capacity;
 
-		vkUnmapMemory(ctx.m_device, pop_atomic_index_memory);
+		leaf_capacity = leaf_pool_capacity;
 
-		vkDestroyBuffer(ctx.m_device, pop_staging_buffer, nullptr);
+		return {};
+	}
 
-		vkFreeMemory(ctx.m_device, pop_staging_memory, nullptr);
+	// Log2 of the number of bricks along the x and y axes of an atlas holding atlas_capacity bricks, laid out as close to a cube as possible
+	static uint32_t get_atlas_dim_log2(uint32_t atlas_capacity) noexcept
+	{
+		uint32_t dim_log2 = 0;
 
-		vkDestroyBuffer(ctx.m_device, pop_atomic_index_buffer, nullptr);
+		while ((static_cast<uint64_t>(1) << (3 * dim_log2)) < atlas_capacity)
+			++dim_log2;
 
-		vkFreeMemory(ctx.m_device, pop_atomic_index_memory, nullptr);
+		return dim_log2;
+	}
 
-		vkDestroyCommandPool(ctx.m_device, pop_command_pool, nullptr);
+	// Creates brick_atlas_image with room for atlas_capacity bricks and moves it to the general layout. Its extent must
+	// already have been checked by check_brick_pool_limits.
+	och::status create_brick_atlas(uint32_t atlas_capacity) noexcept
+	{
+		const uint32_t dim_log2 = get_atlas_dim_log2(atlas_capacity);
 
-		vkDestroyDescriptorPool(ctx.m_device, pop_descriptor_pool, nullptr);
+		const uint64_t layer_cnt = (atlas_capacity + (static_cast<uint64_t>(1) << (2 * dim_log2)) - 1) >> (2 * dim_log2);
 
-		for (uint32_t i = 0; i != 3; ++i)
-		{
-			vkDestroyPipeline(ctx.m_device, pop_pipelines[i], nullptr);
+		check(ctx.create_image_with_view(brick_atlas_image_view, brick_atlas_image, brick_atlas_image_memory, 
+			{ static_cast<uint32_t>(brick_dim << dim_log2), static_cast<uint32_t>(brick_dim << dim_log2), static_cast<uint32_t>(layer_cnt * brick_dim) },
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_IMAGE_TYPE_3D, 
+			VK_IMAGE_VIEW_TYPE_3D, 
+			VK_FORMAT_R8_UINT, 
+			VK_FORMAT_R8_UINT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			volume_sharing_mode,
+			volume_queue_family_cnt,
+			volume_queue_families));
 
-			vkDestroyShaderModule(ctx.m_device, pop_shader_modules[i], nullptr);
+		atlas_dim_log2 = dim_log2;
 
-			vkDestroyPipelineLayout(ctx.m_device, pop_pipeline_layouts[i], nullptr);
+		// Texels of unused bricks are never read, so there is nothing to preserve or clear. The staging queue may not support
+		// compute, so only the layout is changed here, with later work ordered by waiting for the submission.
+		VkCommandBuffer trans_command_buffer;
 
-			vkDestroyDescriptorSetLayout(ctx.m_device, pop_descriptor_set_layouts[i], nullptr);
-		}
+		check(ctx.begin_onetime_command(trans_command_buffer, ctx.m_staging_command_pool));
 
-		och::timespan brick_init_time = brick_init_timer.read();
+		VkImageMemoryBarrier to_general_barrier;
+		to_general_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		to_general_barrier.pNext = nullptr;
+		to_general_barrier.srcAccessMask = 0;
+		to_general_barrier.dstAccessMask = 0;
+		to_general_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		to_general_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		to_general_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		to_general_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		to_general_barrier.image = brick_atlas_image;
+		to_general_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		to_general_barrier.subresourceRange.baseMipLevel = 0;
+		to_general_barrier.subresourceRange.levelCount = 1;
+		to_general_barrier.subresourceRange.baseArrayLayer = 0;
+		to_general_barrier.subresourceRange.layerCount = 1;
 
-		och::print("Finished initializing bricks in {}\n", brick_init_time);
+		vkCmdPipelineBarrier(trans_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_general_barrier);
+
+		check(ctx.submit_onetime_command(trans_command_buffer, ctx.m_staging_command_pool, ctx.m_staging_queue));
 
 		return {};
 	}
 
+	void destroy_brick_pool() noexcept
+	{
+		vkDestroyImageView(ctx.m_device, brick_atlas_image_view, nullptr);
 
+		vkDestroyImage(ctx.m_device, brick_atlas_image, nullptr);
 
-	och::status recreate_swapchain() noexcept
-	{
-		och::print("Recreating swapchain\n");
+		vkFreeMemory(ctx.m_device, brick_atlas_image_memory, nullptr);
 
-		uint32_t old_image_cnt = ctx.m_swapchain_image_cnt;
+		vkDestroyBuffer(ctx.m_device, leaf_free_stack_buffer, nullptr);
 
-		check(ctx.recreate_swapchain());
+		vkFreeMemory(ctx.m_device, leaf_free_stack_memory, nullptr);
 
-		check(vkResetDescriptorPool(ctx.m_device, descriptor_pool, 0));
+		vkDestroyBuffer(ctx.m_device, leaf_buffer, nullptr);
 
-		for (uint32_t i = 0; i != old_image_cnt; ++i)
-		{
-			// vkDestroyImageView(ctx.m_device, hit_index_image_views[i], nullptr);
+		vkFreeMemory(ctx.m_device, leaf_memory, nullptr);
 
-			// vkDestroyImage(ctx.m_device, hit_index_images[i], nullptr);
+		vkDestroyBuffer(ctx.m_device, brick_mask_buffer, nullptr);
 
-			vkDestroyImageView(ctx.m_device, hit_times_image_views[i], nullptr);
+		vkFreeMemory(ctx.m_device, brick_mask_memory, nullptr);
 
-			vkDestroyImage(ctx.m_device, hit_times_images[i], nullptr);
-		}
+		vkDestroyBuffer(ctx.m_device, brick_info_buffer, nullptr);
 
-		// vkFreeMemory(ctx.m_device, hit_index_memory, nullptr);
+		vkFreeMemory(ctx.m_device, brick_info_memory, nullptr);
 
-		vkFreeMemory(ctx.m_device, hit_times_memory, nullptr);
+		vkDestroyBuffer(ctx.m_device, dedup_table_buffer, nullptr);
 
-		check(create_hit_data_resources());
+		vkFreeMemory(ctx.m_device, dedup_table_memory, nullptr);
 
-		VkDescriptorSetLayout descriptor_set_layouts[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+		vkDestroyBuffer(ctx.m_device, brick_free_mask_buffer, nullptr);
 
-		for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
-			descriptor_set_layouts[i] = descriptor_set_layout;
+		vkFreeMemory(ctx.m_device, brick_free_mask_memory, nullptr);
 
-		VkDescriptorSetAllocateInfo descriptor_set_ai{};
-		descriptor_set_ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptor_set_ai.pNext = nullptr;
-		descriptor_set_ai.descriptorPool = descriptor_pool;
-		descriptor_set_ai.descriptorSetCount = ctx.m_swapchain_image_cnt;
-		descriptor_set_ai.pSetLayouts = descriptor_set_layouts;
+		vkDestroyBuffer(ctx.m_device, brick_free_stack_buffer, nullptr);
 
-		check(vkAllocateDescriptorSets(ctx.m_device, &descriptor_set_ai, descriptor_sets));
+		vkFreeMemory(ctx.m_device, brick_free_stack_memory, nullptr);
 
-		VkDescriptorImageInfo image_infos[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT * 3];
+		vkDestroyBuffer(ctx.m_device, brick_buffer, nullptr);
 
-		VkDescriptorBufferInfo buffer_infos[2]
-		{
-		   { brick_buffer, 0, VK_WHOLE_SIZE },
-		   { leaf_buffer , 0, VK_WHOLE_SIZE },
-		};
+		vkFreeMemory(ctx.m_device, brick_memory, nullptr);
 
-		VkWriteDescriptorSet writes[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT * 2];
+		brick_free_stack_buffer = nullptr;
 
-		for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
-		{
-			image_infos[3 * i + 0].sampler = nullptr;
-			image_infos[3 * i + 0].imageView = ctx.m_swapchain_image_views[i]; // hit_index_image_views[i];
-			image_infos[3 * i + 0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		brick_free_stack_memory = nullptr;
 
-			image_infos[3 * i + 1].sampler = nullptr;
-			image_infos[3 * i + 1].imageView = hit_times_image_views[i];
-			image_infos[3 * i + 1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		brick_free_mask_buffer = nullptr;
 
-			image_infos[3 * i + 2].sampler = nullptr;
-			image_infos[3 * i + 2].imageView = base_image_view;
-			image_infos[3 * i + 2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		brick_free_mask_memory = nullptr;
 
-			writes[2 * i + 0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writes[2 * i + 0].pNext = nullptr;
-			writes[2 * i + 0].dstSet = descriptor_sets[i];
-			writes[2 * i + 0].dstBinding = 0;
-			writes[2 * i + 0].dstArrayElement = 0;
-			writes[2 * i + 0].descriptorCount = 3;
-			writes[2 * i + 0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			writes[2 * i + 0].pImageInfo = &image_infos[3 * i];
-			writes[2 * i + 0].pBufferInfo = nullptr;
-			writes[2 * i + 0].pTexelBufferView = nullptr;
-
-			writes[2 * i + 1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writes[2 * i + 1].pNext = nullptr;
-			writes[2 * i + 1].dstSet = descriptor_sets[i];
-			writes[2 * i + 1].dstBinding = 3;
-			writes[2 * i + 1].dstArrayElement = 0;
-			writes[2 * i + 1].descriptorCount = 2;
-			writes[2 * i + 1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			writes[2 * i + 1].pImageInfo = nullptr;
-			writes[2 * i + 1].pBufferInfo = buffer_infos;
-			writes[2 * i + 1].pTexelBufferView = nullptr;
-		}
-
-		vkUpdateDescriptorSets(ctx.m_device, ctx.m_swapchain_image_cnt * 2, writes, 0, nullptr);
+		dedup_table_buffer = nullptr;
 
-		// TODO: Maybe recreate pipeline?
+		dedup_table_memory = nullptr;
 
-		och::print("Finished recreating swapchain\n");
+		brick_info_buffer = nullptr;
 
-		return {};
-	}
+		brick_info_memory = nullptr;
 
-	och::status create_hit_data_resources() noexcept
-	{
-		// Allocate hit index images
-		// check(ctx.create_images_with_views(
-		// 	ctx.m_swapchain_image_cnt,
-		// 	hit_index_image_views, hit_index_images, hit_index_memory,
-		// 	{ ctx.m_swapchain_extent.width, ctx.m_swapchain_extent.height, 1 },
-		// 	VK_IMAGE_ASPECT_COLOR_BIT,
-		// 	VK_IMAGE_USAGE_STORAGE_BIT,
-		// 	VK_IMAGE_TYPE_2D,
-		// 	VK_IMAGE_VIEW_TYPE_2D,
-		// 	VK_FORMAT_R16_UINT,
-		// 	VK_FORMAT_R16_UINT,
-		// 	VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		brick_mask_buffer = nullptr;
 
-		// Allocate hit times images
-		check(ctx.create_images_with_views(
-			ctx.m_swapchain_image_cnt,
-			hit_times_image_views, hit_times_images, hit_times_memory,
-			{ ctx.m_swapchain_extent.width, ctx.m_swapchain_extent.height, 1 },
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_USAGE_STORAGE_BIT,
-			VK_IMAGE_TYPE_2D,
-			VK_IMAGE_VIEW_TYPE_2D,
-			VK_FORMAT_R32_SFLOAT,
-			VK_FORMAT_R32_SFLOAT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		brick_mask_memory = nullptr;
 
-		// Transition hit time images to be usable
-		{
-			VkCommandPool trans_command_pool;
+		brick_buffer = nullptr;
 
-			VkCommandBuffer trans_command_buffer;
+		brick_memory = nullptr;
 
-			VkCommandPoolCreateInfo command_pool_ci{};
-			command_pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-			command_pool_ci.pNext = nullptr;
-			command_pool_ci.flags = 0;
-			command_pool_ci.queueFamilyIndex = ctx.m_general_queues.family_index;
+		leaf_buffer = nullptr;
 
-			check(vkCreateCommandPool(ctx.m_device, &command_pool_ci, nullptr, &trans_command_pool));
+		leaf_memory = nullptr;
 
-			check(ctx.begin_onetime_command(trans_command_buffer, trans_command_pool));
+		leaf_free_stack_buffer = nullptr;
 
-			VkImageMemoryBarrier hit_image_barriers[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+		leaf_free_stack_memory = nullptr;
 
-			for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
-			{
-				hit_image_barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				hit_image_barriers[i].pNext = nullptr;
-				hit_image_barriers[i].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-				hit_image_barriers[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-				hit_image_barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				hit_image_barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
-				hit_image_barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-				hit_image_barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-				hit_image_barriers[i].image = hit_times_images[i];
-				hit_image_barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				hit_image_barriers[i].subresourceRange.baseMipLevel = 0;
-				hit_image_barriers[i].subresourceRange.levelCount = 1;
-				hit_image_barriers[i].subresourceRange.baseArrayLayer = 0;
-				hit_image_barriers[i].subresourceRange.layerCount = 1;
-			}
+		brick_atlas_image_view = nullptr;
 
-			vkCmdPipelineBarrier(trans_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, ctx.m_swapchain_image_cnt, hit_image_barriers);
+		brick_atlas_image = nullptr;
 
-			check(ctx.submit_onetime_command(trans_command_buffer, trans_command_pool, ctx.m_general_queues[0]));
+		brick_atlas_image_memory = nullptr;
+	}
 
-			vkDestroyCommandPool(ctx.m_device, trans_command_pool, nullptr);
-		}
+	static uint64_t free_mask_word_cnt(uint32_t capacity) noexcept
+	{
+		return (static_cast<uint64_t>(capacity) + 31) / 32;
+	}
 
-		return {};
+	static uint64_t dedup_table_slot_cnt(uint32_t capacity) noexcept
+	{
+		// Between two and four slots per brick, matching the mask computed in init_dedupbricks
+		uint32_t msb = 31;
+
+		while ((capacity >> msb) == 0)
+			--msb;
+
+		return static_cast<uint64_t>(4) << msb;
 	}
 
-	och::status create() noexcept
+	static uint64_t padded_brick_capacity(uint32_t required_cnt) noexcept
 	{
-		och::print("Base MB: {}\nBrick MB: {}\nLeaf MB: {}\n", (BASE_VOL * sizeof(base_elem_t)) / (1024 * 1024), BRICK_BYTES / (1024 * 1024), LEAF_BYTES / (1024 * 1024));
+		// Leave some headroom, so that slightly different generation parameters do not immediately trigger another rebuild
+		uint64_t capacity = required_cnt + required_cnt / BRICK_CAPACITY_HEADROOM_DIVISOR;
 
-		VkPhysicalDevice16BitStorageFeatures physical_device_16_bit_storage_feats{};
-		physical_device_16_bit_storage_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES;
-		physical_device_16_bit_storage_feats.pNext = nullptr;
-		physical_device_16_bit_storage_feats.storageBuffer16BitAccess = VK_TRUE;
+		return (capacity + BRICK_CAPACITY_GRANULARITY - 1) & ~static_cast<uint64_t>(BRICK_CAPACITY_GRANULARITY - 1);
+	}
 
-		VkPhysicalDeviceFeatures2 physical_device_feats{};
-		physical_device_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-		physical_device_feats.pNext = &physical_device_16_bit_storage_feats;
+	bool is_brick_pool_overflowed() const noexcept
+	{
+		return brick_pool_data->allocated_cnt > brick_capacity || brick_pool_data->leaf_allocated_cnt > leaf_capacity;
+	}
 
-		vulkan_context_create_info context_ci{};
-		context_ci.app_name = "Voxel Volume";
-		context_ci.window_width = 1440;
-		context_ci.window_height = 810;
-		context_ci.requested_api_version = VK_API_VERSION_1_1;
-		context_ci.swapchain_image_usage = VK_IMAGE_USAGE_STORAGE_BIT;
-		context_ci.physical_device_suitable_callback = voxel_volume_physical_device_suitable_callback;
-		context_ci.enabled_device_features2 = &physical_device_feats;
+	// Grows whichever of the brick and leaf pools is smaller than required
+	och::status grow_brick_pool(uint32_t required_cnt, uint32_t required_leaf_cnt) noexcept
+	{
+		const uint64_t new_capacity = required_cnt > brick_capacity ? padded_brick_capacity(required_cnt) : brick_capacity;
 
-		check(ctx.create(&context_ci));
+		const uint64_t new_leaf_capacity = required_leaf_cnt > leaf_capacity ? padded_brick_capacity(required_leaf_cnt) : leaf_capacity;
 
-		// Create Base Image
-		check(ctx.create_image_with_view(base_image_view, base_image, base_image_memory, 
-			{ BASE_DIM * LEVEL_CNT, BASE_DIM, BASE_DIM },
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-			VK_IMAGE_TYPE_3D, 
-			VK_IMAGE_VIEW_TYPE_3D, 
-			VK_FORMAT_R32_UINT, 
-			VK_FORMAT_R32_UINT, 
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		// Brick indices have to fit into the index bits of a base texel
+		if (new_capacity > static_cast<uint64_t>(CELL_INDEX_MASK) + 1 || new_leaf_capacity > UINT32_MAX)
+			return to_status(och::error::argument_too_large);
 
-		// Allocate Brick buffer
-		check(ctx.create_buffer(brick_buffer, brick_memory, BRICK_BYTES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		if (new_capacity != brick_capacity)
+			och::print("Growing brick pool from {} to {} bricks ({} MB)\n", brick_capacity, new_capacity, brick_bytes(static_cast<uint32_t>(new_capacity)) / (1024 * 1024));
 
-		// Allocate Leaf buffer
-		check(ctx.create_buffer(leaf_buffer, leaf_memory, LEAF_BYTES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		if (new_leaf_capacity != leaf_capacity)
+			och::print("Growing leaf pool from {} to {} leaves ({} MB)\n", leaf_capacity, new_leaf_capacity, leaf_bytes(static_cast<uint32_t>(new_leaf_capacity)) / (1024 * 1024));
 
-		// Allocate hit data images
-		check(create_hit_data_resources());
+		// Fail before tearing down the current pool, which the descriptor sets still refer to
+		check(check_brick_pool_limits(static_cast<uint32_t>(new_capacity), static_cast<uint32_t>(new_leaf_capacity)));
 
-		// Create Pipeline
+		check(vkDeviceWaitIdle(ctx.m_device));
+
+		destroy_brick_pool();
+
+		check(create_brick_pool(static_cast<uint32_t>(new_capacity), static_cast<uint32_t>(new_leaf_capacity)));
+
+		write_generation_descriptor_sets();
+
+		write_trace_descriptor_sets();
+
+		return {};
+	}
+
+
+
+	int32_t level_window_min(int32_t anchor, uint32_t level) const noexcept
+	{
+		// Windows are aligned to even cells, so that the cell a ray steps into when leaving a level never overlaps that level
+		return ((anchor >> (level + 1)) << 1) - static_cast<int32_t>(base_dim / 2);
+	}
+
+	uint32_t get_full_regions(const int32_t anchor[3], generation_region* out_regions) const noexcept
+	{
+		for (uint32_t l = 0; l != level_cnt; ++l)
 		{
-			check(ctx.load_shader_module_file(trace_shader_module, "../spirv/trace.comp.spv"));
+			for (uint32_t a = 0; a != 3; ++a)
+			{
+				out_regions[l].min[a] = level_window_min(anchor[a], l);
 
-			struct
-			{
-				uint32_t group_size_x = TRACE_GROUP_SIZE_X;
-				uint32_t group_size_y = TRACE_GROUP_SIZE_Y;
-				uint32_t base_dim_log2 = BASE_DIM_LOG2;
-				uint32_t brick_dim_log2 = BRICK_DIM_LOG2;
-				uint32_t level_cnt = LEVEL_CNT;
-			} specialization_data;
-			
-			VkSpecializationMapEntry specialization_entries[]{
-				{ 1, offsetof(decltype(specialization_data), group_size_x), sizeof(uint32_t) },
-				{ 2, offsetof(decltype(specialization_data), group_size_y), sizeof(uint32_t) },
-				{ 3, offsetof(decltype(specialization_data), base_dim_log2), sizeof(uint32_t) },
-				{ 4, offsetof(decltype(specialization_data), brick_dim_log2), sizeof(uint32_t) },
-				{ 5, offsetof(decltype(specialization_data), level_cnt), sizeof(uint32_t) },
-			};
-			
-			VkSpecializationInfo specialization_info{};
-			specialization_info.mapEntryCount = _countof(specialization_entries);
-			specialization_info.pMapEntries = specialization_entries;
-			specialization_info.dataSize = sizeof(specialization_data);
-			specialization_info.pData = &specialization_data;
-			
-			VkDescriptorSetLayoutBinding descriptor_set_layout_bindings[5]{};
-			// Base image array
-			descriptor_set_layout_bindings[0].binding = 0;
-			descriptor_set_layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			descriptor_set_layout_bindings[0].descriptorCount = 1;
-			descriptor_set_layout_bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			descriptor_set_layout_bindings[0].pImmutableSamplers = nullptr;
-			// Brick buffer
-			descriptor_set_layout_bindings[1].binding = 1;
-			descriptor_set_layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			descriptor_set_layout_bindings[1].descriptorCount = 1;
-			descriptor_set_layout_bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			descriptor_set_layout_bindings[1].pImmutableSamplers = nullptr;
-			// Leaf buffer
-			descriptor_set_layout_bindings[2].binding = 2;
-			descriptor_set_layout_bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			descriptor_set_layout_bindings[2].descriptorCount = 1;
-			descriptor_set_layout_bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			descriptor_set_layout_bindings[2].pImmutableSamplers = nullptr;
-			// Hit ids
-			descriptor_set_layout_bindings[3].binding = 3;
-			descriptor_set_layout_bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			descriptor_set_layout_bindings[3].descriptorCount = 1;
-			descriptor_set_layout_bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			descriptor_set_layout_bindings[3].pImmutableSamplers = nullptr;
-			// Hit times
-			descriptor_set_layout_bindings[4].binding = 4;
-			descriptor_set_layout_bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			descriptor_set_layout_bindings[4].descriptorCount = 1;
-			descriptor_set_layout_bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			descriptor_set_layout_bindings[4].pImmutableSamplers = nullptr;
-			
-			VkDescriptorSetLayoutCreateInfo descriptor_set_layout_ci{};
-			descriptor_set_layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptor_set_layout_ci.pNext = nullptr;
-			descriptor_set_layout_ci.flags = 0;
-			descriptor_set_layout_ci.bindingCount = 5;
-			descriptor_set_layout_ci.pBindings = descriptor_set_layout_bindings;
-			
-			check(vkCreateDescriptorSetLayout(ctx.m_device, &descriptor_set_layout_ci, nullptr, &descriptor_set_layout));
-			
-			VkPushConstantRange push_constant_range;
-			push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-			push_constant_range.offset = 0;
-			push_constant_range.size = sizeof(push_constant_data_t);
-			
-			VkPipelineLayoutCreateInfo pipeline_layout_ci{};
-			pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-			pipeline_layout_ci.pNext = nullptr;
-			pipeline_layout_ci.flags = 0;
-			pipeline_layout_ci.setLayoutCount = 1;
-			pipeline_layout_ci.pSetLayouts = &descriptor_set_layout;
-			pipeline_layout_ci.pushConstantRangeCount = 1;
-			pipeline_layout_ci.pPushConstantRanges = &push_constant_range;
-			
-			check(vkCreatePipelineLayout(ctx.m_device, &pipeline_layout_ci, nullptr, &pipeline_layout));
-			
-			VkComputePipelineCreateInfo pipeline_ci{};
-			pipeline_ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-			pipeline_ci.pNext = nullptr;
-			pipeline_ci.flags = 0;
-			pipeline_ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			pipeline_ci.stage.pNext = nullptr;
-			pipeline_ci.stage.flags = 0;
-			pipeline_ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-			pipeline_ci.stage.module = trace_shader_module;
-			pipeline_ci.stage.pName = "main";
-			pipeline_ci.stage.pSpecializationInfo = &specialization_info;
-			pipeline_ci.layout = pipeline_layout;
-			pipeline_ci.basePipelineHandle = nullptr;
-			pipeline_ci.basePipelineIndex = -1;
-			
-			check(vkCreateComputePipelines(ctx.m_device, nullptr, 1, &pipeline_ci, nullptr, &pipeline));
+				out_regions[l].extent[a] = static_cast<uint32_t>(base_dim);
+			}
+
+			out_regions[l].level = l;
 		}
 
-		// Create Descriptors
+		return static_cast<uint32_t>(level_cnt);
+	}
+
+	uint32_t get_exposed_regions(const int32_t old_anchor[3], const int32_t new_anchor[3], generation_region* out_regions) const noexcept
+	{
+		uint32_t region_cnt = 0;
+
+		for (uint32_t l = 0; l != level_cnt; ++l)
 		{
-			VkDescriptorPoolSize descriptor_pool_sizes[2]{};
-			descriptor_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			descriptor_pool_sizes[0].descriptorCount = 3 * vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
-			descriptor_pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			descriptor_pool_sizes[1].descriptorCount = 2 * vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
+			int32_t old_min[3];
 
-			VkDescriptorPoolCreateInfo descriptor_pool_ci{};
-			descriptor_pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-			descriptor_pool_ci.pNext = nullptr;
-			descriptor_pool_ci.flags = 0;
-			descriptor_pool_ci.maxSets = vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
-			descriptor_pool_ci.poolSizeCount = 2;
-			descriptor_pool_ci.pPoolSizes = descriptor_pool_sizes;
-			
-			check(vkCreateDescriptorPool(ctx.m_device, &descriptor_pool_ci, nullptr, &descriptor_pool));
+			int32_t new_min[3];
 
-			VkDescriptorSetLayout descriptor_set_layouts[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+			bool is_disjoint = false;
 
-			for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
-				descriptor_set_layouts[i] = descriptor_set_layout;
+			for (uint32_t a = 0; a != 3; ++a)
+			{
+				old_min[a] = level_window_min(old_anchor[a], l);
 
-			VkDescriptorSetAllocateInfo descriptor_set_ai{};
-			descriptor_set_ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			descriptor_set_ai.pNext = nullptr;
-			descriptor_set_ai.descriptorPool = descriptor_pool;
-			descriptor_set_ai.descriptorSetCount = ctx.m_swapchain_image_cnt;
-			descriptor_set_ai.pSetLayouts = descriptor_set_layouts;
+				new_min[a] = level_window_min(new_anchor[a], l);
 
-			check(vkAllocateDescriptorSets(ctx.m_device, &descriptor_set_ai, descriptor_sets));
+				if (abs(new_min[a] - old_min[a]) >= static_cast<int32_t>(base_dim))
+					is_disjoint = true;
+			}
+
+			// Part of the new window that was already covered by the old one along the axes processed so far.
+			// Slicing the exposed shell axis by axis like this keeps the resulting regions disjoint.
+			int32_t kept_min[3]{ new_min[0], new_min[1], new_min[2] };
+
+			uint32_t kept_extent[3]{ static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim) };
+
+			if (is_disjoint)
+			{
+				generation_region& region = out_regions[region_cnt++];
+
+				for (uint32_t a = 0; a != 3; ++a)
+				{
+					region.min[a] = kept_min[a];
+
+					region.extent[a] = kept_extent[a];
+				}
+
+				region.level = l;
+
+				continue;
+			}
+
+			for (uint32_t a = 0; a != 3; ++a)
+			{
+				const int32_t delta = new_min[a] - old_min[a];
+
+				if (delta == 0)
+					continue;
+
+				generation_region& region = out_regions[region_cnt++];
+
+				for (uint32_t b = 0; b != 3; ++b)
+				{
+					region.min[b] = kept_min[b];
+
+					region.extent[b] = kept_extent[b];
+				}
+
+				region.level = l;
+
+				if (delta > 0)
+				{
+					region.min[a] = old_min[a] + static_cast<int32_t>(base_dim);
+
+					region.extent[a] = static_cast<uint32_t>(delta);
+
+					kept_extent[a] = static_cast<uint32_t>(base_dim - delta);
+				}
+				else
+				{
+					region.extent[a] = static_cast<uint32_t>(-delta);
 
-			 VkDescriptorImageInfo image_infos[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT * 3];
-			 
-			 VkDescriptorBufferInfo buffer_infos[2]
-			 {
-			 	{ brick_buffer, 0, VK_WHOLE_SIZE },
-			 	{ leaf_buffer , 0, VK_WHOLE_SIZE },
-			 };
-			 
-			 VkWriteDescriptorSet writes[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT * 2];
-			 
-			 for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
-			 {
-			 	image_infos[3 * i + 0].sampler = nullptr;
-				image_infos[3 * i + 0].imageView = ctx.m_swapchain_image_views[i]; // hit_index_image_views[i];
-			 	image_infos[3 * i + 0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			 
-			 	image_infos[3 * i + 1].sampler = nullptr;
-			 	image_infos[3 * i + 1].imageView = hit_times_image_views[i];
-			 	image_infos[3 * i + 1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			 
-			 	image_infos[3 * i + 2].sampler = nullptr;
-			 	image_infos[3 * i + 2].imageView = base_image_view;
-			 	image_infos[3 * i + 2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			 
-			 	writes[2 * i + 0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			 	writes[2 * i + 0].pNext = nullptr;
-			 	writes[2 * i + 0].dstSet = descriptor_sets[i];
-			 	writes[2 * i + 0].dstBinding = 0;
-			 	writes[2 * i + 0].dstArrayElement = 0;
-			 	writes[2 * i + 0].descriptorCount = 3;
-			 	writes[2 * i + 0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			 	writes[2 * i + 0].pImageInfo = &image_infos[3 * i];
-			 	writes[2 * i + 0].pBufferInfo = nullptr;
-			 	writes[2 * i + 0].pTexelBufferView = nullptr;
-			 
-			 	writes[2 * i + 1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			 	writes[2 * i + 1].pNext = nullptr;
-			 	writes[2 * i + 1].dstSet = descriptor_sets[i];
-			 	writes[2 * i + 1].dstBinding = 3;
-			 	writes[2 * i + 1].dstArrayElement = 0;
-			 	writes[2 * i + 1].descriptorCount = 2;
-			 	writes[2 * i + 1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-			 	writes[2 * i + 1].pImageInfo = nullptr;
-			 	writes[2 * i + 1].pBufferInfo = buffer_infos;
-			 	writes[2 * i + 1].pTexelBufferView = nullptr;
-			 }
-			 
-			 vkUpdateDescriptorSets(ctx.m_device, ctx.m_swapchain_image_cnt * 2, writes, 0, nullptr);
+					kept_min[a] = old_min[a];
+
+					kept_extent[a] = static_cast<uint32_t>(base_dim + delta);
+				}
+			}
 		}
 
-		// Create Command Buffers
+		return region_cnt;
+	}
+
+	och::status record_generation(const generation_region* regions, uint32_t region_cnt, bool is_full_rebuild) noexcept
+	{
+		// Record Command Buffer
 		{
-			VkCommandPoolCreateInfo command_pool_ci{};
-			command_pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-			command_pool_ci.pNext = nullptr;
-			command_pool_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			command_pool_ci.queueFamilyIndex = ctx.m_general_queues.family_index;
+			VkCommandBufferBeginInfo command_buffer_bi{};
+			command_buffer_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			command_buffer_bi.pNext = nullptr;
+			command_buffer_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			command_buffer_bi.pInheritanceInfo = nullptr;
+
+			check(vkBeginCommandBuffer(gen_command_buffer, &command_buffer_bi));
+
+			check(ctx.begin_profiler_frame(gen_command_buffer, GEN_PROFILER_FRAME));
+
+			uint32_t profile_slot;
+
+			// Order after earlier generation work on the compute queue. Frames on the general queue are waited for through gen_start_semaphore.
+
+			VkMemoryBarrier trace_barrier;
+			trace_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			trace_barrier.pNext = nullptr;
+			trace_barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			trace_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &trace_barrier, 0, nullptr, 0, nullptr);
+
+			// Encloses all generation passes, which build_volume reports the time of
+			uint32_t generate_profile_slot;
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "generate", generate_profile_slot));
+
+			if (is_full_rebuild)
+			{
+				// Forget all previous allocations, including a possibly partially consumed count buffer from an overflowed build
+
+				check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "clear", profile_slot));
+
+				vkCmdFillBuffer(gen_command_buffer, gen_count_buffer, 0, VK_WHOLE_SIZE, 0);
+
+				vkCmdFillBuffer(gen_command_buffer, brick_pool_buffer, 0, VK_WHOLE_SIZE, 0);
+
+				vkCmdFillBuffer(gen_command_buffer, dedup_table_buffer, 0, VK_WHOLE_SIZE, 0);
+
+				vkCmdFillBuffer(gen_command_buffer, brick_free_mask_buffer, 0, VK_WHOLE_SIZE, 0);
+
+				ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+				VkBufferMemoryBarrier cleared_buffer_barriers[4];
+				cleared_buffer_barriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				cleared_buffer_barriers[0].pNext = nullptr;
+				cleared_buffer_barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				cleared_buffer_barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				cleared_buffer_barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				cleared_buffer_barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				cleared_buffer_barriers[0].buffer = gen_count_buffer;
+				cleared_buffer_barriers[0].offset = 0;
+				cleared_buffer_barriers[0].size = VK_WHOLE_SIZE;
+				cleared_buffer_barriers[1] = cleared_buffer_barriers[0];
+				cleared_buffer_barriers[1].buffer = brick_pool_buffer;
+				cleared_buffer_barriers[2] = cleared_buffer_barriers[0];
+				cleared_buffer_barriers[2].buffer = dedup_table_buffer;
+				cleared_buffer_barriers[3] = cleared_buffer_barriers[0];
+				cleared_buffer_barriers[3].buffer = brick_free_mask_buffer;
+
+				check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "barriers", profile_slot));
+
+				vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 4, cleared_buffer_barriers, 0, nullptr);
+
+				ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+			}
+
+
+
+			VkImageMemoryBarrier inter_dispatch_barrier;
+			inter_dispatch_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			inter_dispatch_barrier.pNext = nullptr;
+			inter_dispatch_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
+			inter_dispatch_barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
+			inter_dispatch_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			inter_dispatch_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			inter_dispatch_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			inter_dispatch_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			inter_dispatch_barrier.image = base_image;
+			inter_dispatch_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			inter_dispatch_barrier.subresourceRange.baseMipLevel = 0;
+			inter_dispatch_barrier.subresourceRange.levelCount = 1;
+			inter_dispatch_barrier.subresourceRange.baseArrayLayer = 0;
+			inter_dispatch_barrier.subresourceRange.layerCount = 1;
+
+			VkBufferMemoryBarrier inter_dispatch_buffer_barriers[6];
+			inter_dispatch_buffer_barriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			inter_dispatch_buffer_barriers[0].pNext = nullptr;
+			inter_dispatch_buffer_barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			inter_dispatch_buffer_barriers[0].dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
+			inter_dispatch_buffer_barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			inter_dispatch_buffer_barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			inter_dispatch_buffer_barriers[0].buffer = brick_pool_buffer;
+			inter_dispatch_buffer_barriers[0].offset = 0;
+			inter_dispatch_buffer_barriers[0].size = VK_WHOLE_SIZE;
+			inter_dispatch_buffer_barriers[1] = inter_dispatch_buffer_barriers[0];
+			inter_dispatch_buffer_barriers[1].buffer = brick_free_stack_buffer;
+			inter_dispatch_buffer_barriers[2] = inter_dispatch_buffer_barriers[0];
+			inter_dispatch_buffer_barriers[2].buffer = dedup_table_buffer;
+			inter_dispatch_buffer_barriers[3] = inter_dispatch_buffer_barriers[0];
+			inter_dispatch_buffer_barriers[3].buffer = brick_info_buffer;
+			inter_dispatch_buffer_barriers[4] = inter_dispatch_buffer_barriers[0];
+			inter_dispatch_buffer_barriers[4].buffer = brick_mask_buffer;
+			inter_dispatch_buffer_barriers[5] = inter_dispatch_buffer_barriers[0];
+			inter_dispatch_buffer_barriers[5].buffer = brick_free_mask_buffer;
+
+			generation_push_constant_data_t push_constant_data;
+			push_constant_data.offset = gen_offset;
+			push_constant_data.scale = gen_scale;
+			push_constant_data.cutoff = gen_cutoff;
+			push_constant_data.brick_capacity = brick_capacity;
+			push_constant_data.leaf_capacity = leaf_capacity;
+			push_constant_data.atlas_dim_log2 = atlas_dim_log2;
+			push_constant_data.resolve_duplicates = 0;
+
+
+
+			// Return the bricks of cells that are about to be overwritten to the pool.
+			// Since the regions exactly cover the newly exposed cells, each image texel is visited at most once.
+			if (!is_full_rebuild)
+			{
+				check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "releasebricks", profile_slot));
+
+				vkCmdBindDescriptorSets(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[3], 0, 1, &gen_descriptor_sets[3], 0, nullptr);
+
+				vkCmdBindPipeline(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[3]);
+
+				for (uint32_t i = 0; i != region_cnt; ++i)
+				{
+					set_region(push_constant_data, regions[i]);
+
+					vkCmdPushConstants(gen_command_buffer, gen_pipeline_layouts[3], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+					vkCmdDispatch(gen_command_buffer, (regions[i].extent[0] + assignindex_group_size[0] - 1) / assignindex_group_size[0], (regions[i].extent[1] + assignindex_group_size[1] - 1) / assignindex_group_size[1], (regions[i].extent[2] + assignindex_group_size[2] - 1) / assignindex_group_size[2]);
+				}
+
+				ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+				check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "barriers", profile_slot));
+
+				vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 6, inter_dispatch_buffer_barriers, 1, &inter_dispatch_barrier);
+
+				ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+			}
+
+
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "checkempty", profile_slot));
+
+			vkCmdBindDescriptorSets(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[0], 0, 1, &gen_descriptor_sets[0], 0, nullptr);
+
+			vkCmdBindPipeline(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[0]);
+
+			for (uint32_t i = 0; i != region_cnt; ++i)
+			{
+				set_region(push_constant_data, regions[i]);
+
+				vkCmdPushConstants(gen_command_buffer, gen_pipeline_layouts[0], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+				vkCmdDispatch(gen_command_buffer, regions[i].extent[0] * brick_dim / checkempty_group_size[0], regions[i].extent[1] * brick_dim / checkempty_group_size[1], regions[i].extent[2] * brick_dim / checkempty_group_size[2]);
+			}
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+
+
+			VkBufferMemoryBarrier count_buffer_barrier;
+			count_buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			count_buffer_barrier.pNext = nullptr;
+			count_buffer_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			count_buffer_barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
+			count_buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			count_buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			count_buffer_barrier.buffer = gen_count_buffer;
+			count_buffer_barrier.offset = 0;
+			count_buffer_barrier.size = VK_WHOLE_SIZE;
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &count_buffer_barrier, 0, nullptr);
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+			
+
+
+			// Rank all cells needing a brick in Morton order. Cells outside the regions have a zero count, so scanning the
+			// whole volume instead of just the regions yields the same ranks, without having to know the regions' layout.
+
+			VkBufferMemoryBarrier scan_buffer_barriers[2];
+			scan_buffer_barriers[0] = count_buffer_barrier;
+			scan_buffer_barriers[1] = count_buffer_barrier;
+			scan_buffer_barriers[1].buffer = gen_scan_buffer;
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "scan", profile_slot));
+
+			vkCmdBindDescriptorSets(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[SCANCELLS_PASS], 0, 1, &gen_descriptor_sets[SCANCELLS_PASS], 0, nullptr);
+
+			vkCmdBindPipeline(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[SCANCELLS_PASS]);
+
+			vkCmdDispatch(gen_command_buffer, static_cast<uint32_t>(base_vol * level_cnt / SCAN_BLOCK_CELLS), 1, 1);
+
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 2, scan_buffer_barriers, 0, nullptr);
+
+			vkCmdBindDescriptorSets(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[SCANBLOCKS_PASS], 0, 1, &gen_descriptor_sets[SCANBLOCKS_PASS], 0, nullptr);
+
+			vkCmdBindPipeline(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[SCANBLOCKS_PASS]);
+
+			vkCmdDispatch(gen_command_buffer, 1, 1, 1);
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+			// The pool counters updated by init_scanblocks are used again from init_fillbricks on, and the free stack it
+			// filled from the free mask by init_assignindex
+			VkBufferMemoryBarrier scanned_buffer_barriers[3];
+			scanned_buffer_barriers[0] = scan_buffer_barriers[1];
+			scanned_buffer_barriers[1] = count_buffer_barrier;
+			scanned_buffer_barriers[1].buffer = brick_pool_buffer;
+			scanned_buffer_barriers[2] = count_buffer_barrier;
+			scanned_buffer_barriers[2].buffer = brick_free_stack_buffer;
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 3, scanned_buffer_barriers, 0, nullptr);
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "assignindex", profile_slot));
+
+			vkCmdBindDescriptorSets(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[1], 0, 1, &gen_descriptor_sets[1], 0, nullptr);
+			
+			vkCmdBindPipeline(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[1]);
+
+			for (uint32_t i = 0; i != region_cnt; ++i)
+			{
+				set_region(push_constant_data, regions[i]);
+
+				vkCmdPushConstants(gen_command_buffer, gen_pipeline_layouts[1], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+				vkCmdDispatch(gen_command_buffer, (regions[i].extent[0] + assignindex_group_size[0] - 1) / assignindex_group_size[0], (regions[i].extent[1] + assignindex_group_size[1] - 1) / assignindex_group_size[1], (regions[i].extent[2] + assignindex_group_size[2] - 1) / assignindex_group_size[2]);
+			}
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 6, inter_dispatch_buffer_barriers, 1, &inter_dispatch_barrier);
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+
+
+			// Which cells are empty is settled once indices are assigned. Later passes only change which brick a cell refers to.
+			{
+				uint32_t level_mask = 0;
+
+				for (uint32_t i = 0; i != region_cnt; ++i)
+					level_mask |= 1 << regions[i].level;
+
+				check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "distancefield", profile_slot));
+
+				record_distance_field(gen_command_buffer, level_mask);
+
+				ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+			}
+			
+			
+			
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "fillbricks", profile_slot));
+
+			vkCmdBindDescriptorSets(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[2], 0, 1, &gen_descriptor_sets[2], 0, nullptr);
+			
+			vkCmdBindPipeline(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[2]);
+
+			for (uint32_t i = 0; i != region_cnt; ++i)
+			{
+				set_region(push_constant_data, regions[i]);
+
+				vkCmdPushConstants(gen_command_buffer, gen_pipeline_layouts[2], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+				vkCmdDispatch(gen_command_buffer, regions[i].extent[0] * fillbricks_cell_dim / fillbricks_group_size[0], regions[i].extent[1] * fillbricks_cell_dim / fillbricks_group_size[1], regions[i].extent[2] * fillbricks_cell_dim / fillbricks_group_size[2]);
+			}
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+
+
+			// Fold bricks with identical contents into one. This has to follow fillbricks, as contents are unknown at index assignment.
+
+			VkBufferMemoryBarrier filled_brick_barrier;
+			filled_brick_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			filled_brick_barrier.pNext = nullptr;
+			filled_brick_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			filled_brick_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			filled_brick_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			filled_brick_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			filled_brick_barrier.buffer = brick_buffer;
+			filled_brick_barrier.offset = 0;
+			filled_brick_barrier.size = VK_WHOLE_SIZE;
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &filled_brick_barrier, 1, &inter_dispatch_barrier);
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+			check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "dedupbricks", profile_slot));
+
+			vkCmdBindDescriptorSets(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[4], 0, 1, &gen_descriptor_sets[4], 0, nullptr);
+
+			vkCmdBindPipeline(gen_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[4]);
+
+			for (uint32_t i = 0; i != region_cnt; ++i)
+			{
+				set_region(push_constant_data, regions[i]);
+
+				vkCmdPushConstants(gen_command_buffer, gen_pipeline_layouts[4], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+				vkCmdDispatch(gen_command_buffer, regions[i].extent[0], regions[i].extent[1], regions[i].extent[2]);
+			}
+
+			// Identical fresh bricks only know which of them keeps its cells once all of them have been looked up
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 6, inter_dispatch_buffer_barriers, 1, &inter_dispatch_barrier);
+
+			push_constant_data.resolve_duplicates = 1;
+
+			for (uint32_t i = 0; i != region_cnt; ++i)
+			{
+				set_region(push_constant_data, regions[i]);
+
+				vkCmdPushConstants(gen_command_buffer, gen_pipeline_layouts[4], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+				vkCmdDispatch(gen_command_buffer, regions[i].extent[0], regions[i].extent[1], regions[i].extent[2]);
+			}
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+
+
+			if (atlas_bricks)
+			{
+				// Brick contents are final, but dedupbricks may still have redirected cells in the base image
+				filled_brick_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+				check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "barriers", profile_slot));
+
+				vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &filled_brick_barrier, 1, &inter_dispatch_barrier);
+
+				ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+
+				check(ctx.begin_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, "fillatlas", profile_slot));
+
+				record_atlas_copy(gen_command_buffer, regions, region_cnt);
+
+				ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, profile_slot);
+			}
+
+
+
+			ctx.end_profile_scope(gen_command_buffer, GEN_PROFILER_FRAME, generate_profile_slot);
+
+			// Make the final allocation and deduplication counts visible to the host once the submission has completed
+
+			VkBufferMemoryBarrier brick_pool_readback_barrier;
+			brick_pool_readback_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			brick_pool_readback_barrier.pNext = nullptr;
+			brick_pool_readback_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			brick_pool_readback_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			brick_pool_readback_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			brick_pool_readback_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			brick_pool_readback_barrier.buffer = brick_pool_buffer;
+			brick_pool_readback_barrier.offset = 0;
+			brick_pool_readback_barrier.size = VK_WHOLE_SIZE;
+
+			vkCmdPipelineBarrier(gen_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &brick_pool_readback_barrier, 0, nullptr);
+
+
+
+			check(vkEndCommandBuffer(gen_command_buffer));
+		}
+
+		return {};
+	}
+
+	// Recomputes the distance field of every level in level_mask from base_image, which must already be visible to compute shaders
+	void record_distance_field(VkCommandBuffer command_buffer, uint32_t level_mask) noexcept
+	{
+		// Distances spread across the whole level, so the passes always cover complete levels rather than just the regions
+
+		generation_push_constant_data_t push_constant_data{};
+
+		VkImageMemoryBarrier scratch_barrier;
+		scratch_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		scratch_barrier.pNext = nullptr;
+		scratch_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+		scratch_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+		scratch_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		scratch_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		scratch_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		scratch_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		scratch_barrier.image = distance_scratch_image;
+		scratch_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		scratch_barrier.subresourceRange.baseMipLevel = 0;
+		scratch_barrier.subresourceRange.levelCount = 1;
+		scratch_barrier.subresourceRange.baseArrayLayer = 0;
+		scratch_barrier.subresourceRange.layerCount = 1;
+
+		for (uint32_t axis = 0; axis != 3; ++axis)
+		{
+			const uint32_t pass = DISTANCEFIELD_PASS_BEG + axis;
+
+			if (axis != 0)
+				vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &scratch_barrier);
+
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[pass], 0, 1, &gen_descriptor_sets[pass], 0, nullptr);
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[pass]);
+
+			for (uint32_t l = 0; l != level_cnt; ++l)
+			{
+				if ((level_mask & (1 << l)) == 0)
+					continue;
+
+				push_constant_data.level = l;
+
+				vkCmdPushConstants(command_buffer, gen_pipeline_layouts[pass], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+				vkCmdDispatch(command_buffer, static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim), 1);
+			}
+		}
+	}
+
+	// Copies the bricks of all cells in the given regions from brick_buffer into brick_atlas_image. The base image and
+	// bricks must already be visible to compute shaders.
+	void record_atlas_copy(VkCommandBuffer command_buffer, const generation_region* regions, uint32_t region_cnt) noexcept
+	{
+		generation_push_constant_data_t push_constant_data{};
+		push_constant_data.atlas_dim_log2 = atlas_dim_log2;
+
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipeline_layouts[FILLATLAS_PASS], 0, 1, &gen_descriptor_sets[FILLATLAS_PASS], 0, nullptr);
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gen_pipelines[FILLATLAS_PASS]);
+
+		for (uint32_t i = 0; i != region_cnt; ++i)
+		{
+			set_region(push_constant_data, regions[i]);
+
+			vkCmdPushConstants(command_buffer, gen_pipeline_layouts[FILLATLAS_PASS], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data), &push_constant_data);
+
+			// One invocation per voxel in workgroups of 4x4x4, which never straddle bricks
+			vkCmdDispatch(command_buffer, static_cast<uint32_t>(regions[i].extent[0] * brick_dim / 4), static_cast<uint32_t>(regions[i].extent[1] * brick_dim / 4), static_cast<uint32_t>(regions[i].extent[2] * brick_dim / 4));
+		}
+	}
+
+	// Generates regions on the compute queue and blocks until they are complete. Only used while no frames are in flight.
+	och::status generate_regions(const generation_region* regions, uint32_t region_cnt, bool is_full_rebuild) noexcept
+	{
+		check(record_generation(regions, region_cnt, is_full_rebuild));
+
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = nullptr;
+		submit_info.waitSemaphoreCount = 0;
+		submit_info.pWaitSemaphores = nullptr;
+		submit_info.pWaitDstStageMask = nullptr;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &gen_command_buffer;
+		submit_info.signalSemaphoreCount = 0;
+		submit_info.pSignalSemaphores = nullptr;
+
+		check(vkQueueSubmit(ctx.m_compute_queues[0], 1, &submit_info, gen_fence));
+
+		check(vkWaitForFences(ctx.m_device, 1, &gen_fence, VK_FALSE, UINT64_MAX));
+
+		check(vkResetFences(ctx.m_device, 1, &gen_fence));
+
+		return {};
+	}
+
+	static void set_region(generation_push_constant_data_t& push_constant_data, const generation_region& region) noexcept
+	{
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			push_constant_data.region_min[a] = region.min[a];
+
+			push_constant_data.region_extent[a] = region.extent[a];
+		}
+
+		push_constant_data.level = region.level;
+	}
+
+	och::status build_volume() noexcept
+	{
+		och::print("Started initialising bricks.\n");
+
+		och::timer brick_init_timer;
+
+		const uint32_t generate_scope = ctx.find_profile_scope("generate");
+
+		const uint64_t first_generate_sample = generate_scope == ~0u ? 0 : ctx.m_profiler_sample_cnts[generate_scope];
+
+		generation_region regions[MAX_LEVEL_CNT];
+
+		const uint32_t region_cnt = get_full_regions(volume_anchor, regions);
+
+		check(generate_regions(regions, region_cnt, true));
+
+		// Bricks that did not fit into the pool were left empty by init_assignindex, and blocks that did not get a leaf were
+		// approximated by init_fillbricks, so grow and rebuild the whole volume.
+		// Generation is deterministic for given parameters, so a single regrow suffices for bricks. Leaves are not counted
+		// for bricks that were left empty though, meaning the leaf pool may need a second one.
+		while (is_brick_pool_overflowed())
+		{
+			check(grow_brick_pool(brick_pool_data->allocated_cnt, brick_pool_data->leaf_allocated_cnt));
+
+			check(generate_regions(regions, region_cnt, true));
+		}
+
+		och::print("Brick IDs used: {} / {} ({} remaining)\n", brick_pool_data->allocated_cnt, brick_capacity, static_cast<int64_t>(brick_capacity) - brick_pool_data->allocated_cnt);
+
+		if (brick_fmt == brick_format::leaf)
+			och::print("Leaf IDs used: {} / {} ({} MB)\n", brick_pool_data->leaf_allocated_cnt - brick_pool_data->leaf_free_cnt, leaf_capacity, leaf_bytes(brick_pool_data->leaf_allocated_cnt) / (1024 * 1024));
+
+		// Every brick deduplicated by init_dedupbricks went back onto the free stack, so what remains allocated is unique
+		const uint32_t unique_brick_cnt = brick_pool_data->allocated_cnt - brick_pool_data->free_cnt;
+
+		if (unique_brick_cnt != 0)
+			och::print("Deduplicated {} bricks into {} unique ones (ratio {})\n", unique_brick_cnt + brick_pool_data->deduplicated_cnt, unique_brick_cnt, static_cast<float>(unique_brick_cnt + brick_pool_data->deduplicated_cnt) / unique_brick_cnt);
+
+		// Leaf bricks only pay for the leaves of their mixed blocks, so compare what they actually take against a bitpacked brick
+		if (brick_fmt == brick_format::leaf && unique_brick_cnt != 0)
+		{
+			const uint32_t used_leaf_cnt = brick_pool_data->leaf_allocated_cnt - brick_pool_data->leaf_free_cnt;
+
+			const float bytes_per_brick = static_cast<float>(brick_bytes(unique_brick_cnt) + leaf_bytes(used_leaf_cnt)) / unique_brick_cnt;
+
+			och::print("Bytes per brick: {:.1} including {:.2} leaves (bitpacked: {})\n", bytes_per_brick, static_cast<float>(used_leaf_cnt) / unique_brick_cnt, brick_vol / 8);
+		}
+
+		och::timespan brick_init_time = brick_init_timer.read();
+
+		last_build_ms = brick_init_time.milliseconds();
+
+		// The last generation is only collected once the profiler frame is reused, so do it here, as it has completed
+		check(ctx.collect_profiler_frame(GEN_PROFILER_FRAME));
+
+		// Includes the generations repeated after the brick pool overflowed, the same as last_build_ms
+		last_build_gpu_ms = ctx.get_profile_statistics(ctx.find_profile_scope("generate"), first_generate_sample).sum_ms;
+
+		och::print("Finished initializing bricks in {}\n", brick_init_time);
+
+		return {};
+	}
+
+	// Records the generation of all cells exposed by moving to new_anchor. The command buffer is submitted by
+	// submit_volume_update once the frame tracing the shrunk window has been submitted.
+	och::status begin_volume_update(const int32_t new_anchor[3]) noexcept
+	{
+		generation_region regions[MAX_GENERATION_REGIONS];
+
+		const uint32_t region_cnt = get_exposed_regions(volume_anchor, new_anchor, regions);
+
+		if (region_cnt == 0)
+		{
+			for (uint32_t a = 0; a != 3; ++a)
+				volume_anchor[a] = new_anchor[a];
+
+			return {};
+		}
+
+		check(record_generation(regions, region_cnt, false));
+
+		for (uint32_t a = 0; a != 3; ++a)
+			pending_volume_anchor[a] = new_anchor[a];
+
+		is_gen_submit_pending = true;
+
+		is_gen_inflight = true;
+
+		return {};
+	}
+
+	och::status submit_volume_update() noexcept
+	{
+		const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = nullptr;
+		submit_info.waitSemaphoreCount = 1;
+		submit_info.pWaitSemaphores = &gen_start_semaphore;
+		submit_info.pWaitDstStageMask = &wait_stage;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &gen_command_buffer;
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &gen_complete_semaphore;
+
+		check(vkQueueSubmit(ctx.m_compute_queues[0], 1, &submit_info, gen_fence));
+
+		is_gen_submit_pending = false;
+
+		return {};
+	}
+
+	// Polls the in-flight volume update, publishing its anchor to the tracer once it has completed
+	och::status poll_volume_update() noexcept
+	{
+		if (!is_gen_inflight || is_gen_submit_pending)
+			return {};
+
+		const VkResult fence_rst = vkGetFenceStatus(ctx.m_device, gen_fence);
+
+		if (fence_rst == VK_NOT_READY)
+			return {};
+
+		check(fence_rst);
+
+		check(vkResetFences(ctx.m_device, 1, &gen_fence));
+
+		for (uint32_t a = 0; a != 3; ++a)
+			volume_anchor[a] = pending_volume_anchor[a];
+
+		is_gen_inflight = false;
+
+		is_gen_complete_wait_pending = true;
+
+		// Surfaces in the freshly generated cells may have moved, so the previous hit times no longer bound the new ones
+		is_previous_frame_valid = false;
+
+		// Running out of bricks or leaves while streaming leaves the freshly exposed shell incomplete, so start over with larger pools
+		if (is_brick_pool_overflowed())
+		{
+			check(grow_brick_pool(brick_pool_data->allocated_cnt, brick_pool_data->leaf_allocated_cnt));
+
+			check(build_volume());
+		}
+
+		return {};
+	}
+
+
+
+	cpu_volume_params get_cpu_volume_params() const noexcept
+	{
+		cpu_volume_params params;
+		params.offset = gen_offset;
+		params.scale = gen_scale;
+		params.cutoff = gen_cutoff;
+		params.anchor[0] = volume_anchor[0];
+		params.anchor[1] = volume_anchor[1];
+		params.anchor[2] = volume_anchor[2];
+
+		return params;
+	}
+
+	// Fills out_queries with rays starting within a few cells of anchor in all directions, so that they cross every
+	// level. The rays only depend on anchor and query_cnt, so runs can be compared.
+	static void get_validation_rays(const int32_t anchor[3], cpu_ray_query* out_queries, uint32_t query_cnt) noexcept
+	{
+		uint32_t rng = 0x9E3779B9;
+
+		const auto next_float = [&rng]() noexcept
+		{
+			rng = rng * 1664525 + 1013904223;
+
+			return static_cast<float>(rng >> 8) * (2.0F / static_cast<float>(1 << 24)) - 1.0F;
+		};
+
+		for (uint32_t i = 0; i != query_cnt; ++i)
+		{
+			cpu_ray_query& query = out_queries[i];
+
+			for (uint32_t a = 0; a != 3; ++a)
+				query.origin[a] = static_cast<float>(anchor[a]) + next_float() * 4.0F;
+
+			for (uint32_t a = 0; a != 3; ++a)
+				query.direction[a] = next_float();
+
+			// Cut some rays short, so that max_time is covered as well
+			query.max_time = (i & 7) == 0 ? 32.0F : INFINITY;
+
+			query.unused = 0;
+		}
+	}
+
+	// Creates a host-visible buffer holding the tightly packed base image, followed by the first brick_cnt bricks and the first leaf_cnt leaves
+	och::status read_back_volume(VkBuffer& out_buffer, VkDeviceMemory& out_memory, uint32_t brick_cnt, uint32_t leaf_cnt) noexcept
+	{
+		const uint64_t base_bytes = base_vol * level_cnt * sizeof(base_elem_t);
+
+		const uint64_t brick_data_bytes = brick_bytes(brick_cnt);
+
+		const uint64_t leaf_data_bytes = leaf_bytes(leaf_cnt);
+
+		check(ctx.create_buffer(out_buffer, out_memory, base_bytes + brick_data_bytes + leaf_data_bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT));
+
+		// Copy base image, allocated bricks and allocated leaves to the host
+		{
+			VkCommandBuffer readback_command_buffer;
+
+			check(ctx.begin_onetime_command(readback_command_buffer, gen_command_pool));
+
+			VkBufferImageCopy base_region{};
+			base_region.bufferOffset = 0;
+			base_region.bufferRowLength = 0;
+			base_region.bufferImageHeight = 0;
+			base_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			base_region.imageSubresource.mipLevel = 0;
+			base_region.imageSubresource.baseArrayLayer = 0;
+			base_region.imageSubresource.layerCount = 1;
+			base_region.imageOffset = { 0, 0, 0 };
+			base_region.imageExtent = { static_cast<uint32_t>(base_dim * level_cnt), static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim) };
+
+			vkCmdCopyImageToBuffer(readback_command_buffer, base_image, VK_IMAGE_LAYOUT_GENERAL, out_buffer, 1, &base_region);
+
+			if (brick_data_bytes != 0)
+			{
+				VkBufferCopy brick_region{};
+				brick_region.srcOffset = 0;
+				brick_region.dstOffset = base_bytes;
+				brick_region.size = brick_data_bytes;
+
+				vkCmdCopyBuffer(readback_command_buffer, brick_buffer, out_buffer, 1, &brick_region);
+			}
+
+			if (leaf_data_bytes != 0)
+			{
+				VkBufferCopy leaf_region{};
+				leaf_region.srcOffset = 0;
+				leaf_region.dstOffset = base_bytes + brick_data_bytes;
+				leaf_region.size = leaf_data_bytes;
+
+				vkCmdCopyBuffer(readback_command_buffer, leaf_buffer, out_buffer, 1, &leaf_region);
+			}
+
+			VkMemoryBarrier host_barrier{};
+			host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			host_barrier.pNext = nullptr;
+			host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+			vkCmdPipelineBarrier(readback_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0, nullptr);
+
+			check(ctx.submit_onetime_command(readback_command_buffer, gen_command_pool, ctx.m_compute_queues[0]));
+		}
+
+		return {};
+	}
+
+	static uint32_t morton_spread(uint32_t v) noexcept
+	{
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+
+		return v;
+	}
+
+	// Offset of the voxel or leaf block at (x, y, z) within its brick, matching brick_voxel_offset in init_fillbricks
+	uint32_t brick_voxel_offset(uint32_t x, uint32_t y, uint32_t z, uint64_t dim_log2) const noexcept
+	{
+		if (voxel_layout == brick_layout::morton)
+			return morton_spread(x) | (morton_spread(y) << 1) | (morton_spread(z) << 2);
+
+		return static_cast<uint32_t>(x + (y << dim_log2) + (z << (dim_log2 * 2)));
+	}
+
+	// Maps a voxel_offset, which always counts voxels in linear order, to where that voxel is stored
+	uint32_t brick_storage_offset(uint32_t voxel_offset) const noexcept
+	{
+		const uint32_t x = voxel_offset & (brick_dim - 1);
+
+		const uint32_t y = (voxel_offset >> brick_dim_log2) & (brick_dim - 1);
+
+		const uint32_t z = voxel_offset >> (brick_dim_log2 * 2);
+
+		return brick_voxel_offset(x, y, z, brick_dim_log2);
+	}
+
+	uint32_t leaf_block_offset(uint32_t voxel_offset) const noexcept
+	{
+		const uint32_t x = (voxel_offset & (brick_dim - 1)) >> 1;
+
+		const uint32_t y = ((voxel_offset >> brick_dim_log2) & (brick_dim - 1)) >> 1;
+
+		const uint32_t z = (voxel_offset >> (brick_dim_log2 * 2)) >> 1;
+
+		return brick_voxel_offset(x, y, z, brick_dim_log2 - 1);
+	}
+
+	bool is_leaf_brick_voxel_filled(const leaf_brick_elem_t* bricks, const leaf_elem_t* leaves, uint32_t brick_index, uint32_t voxel_offset) const noexcept
+	{
+		const leaf_brick_elem_t block_value = bricks[brick_index * (brick_vol / LEAF_VOL) + leaf_block_offset(voxel_offset)];
+
+		if (block_value == 0 || block_value == 0xFFFFFFFF)
+			return block_value != 0;
+
+		const uint32_t leaf_offset = (voxel_offset & 1) | (((voxel_offset >> brick_dim_log2) & 1) << 1) | (((voxel_offset >> (brick_dim_log2 * 2)) & 1) << 2);
+
+		return ((leaves[block_value - 1] >> leaf_offset) & 1) != 0;
+	}
+
+	bool is_brick_voxel_filled(const uint8_t* bricks, const leaf_elem_t* leaves, uint32_t brick_index, uint32_t voxel_offset) const noexcept
+	{
+		if (brick_fmt == brick_format::leaf)
+			return is_leaf_brick_voxel_filled(reinterpret_cast<const leaf_brick_elem_t*>(bricks), leaves, brick_index, voxel_offset);
+
+		const uint32_t storage_offset = brick_storage_offset(voxel_offset);
+
+		if (brick_fmt == brick_format::bitpacked)
+			return ((reinterpret_cast<const bitpacked_brick_elem_t*>(bricks)[(brick_index * brick_vol + storage_offset) >> 5] >> (storage_offset & 31)) & 1) != 0;
+		else
+			return reinterpret_cast<const brick_elem_t*>(bricks)[brick_index * brick_vol + storage_offset] != 0;
+	}
+
+	// Bit of brick_mask_t covering the given voxel, matching sub_block_bit in init_fillbricks
+	uint32_t sub_block_index(uint32_t voxel_offset) const noexcept
+	{
+		const uint32_t x = (voxel_offset & (brick_dim - 1)) >> sub_block_dim_log2;
+
+		const uint32_t y = ((voxel_offset >> brick_dim_log2) & (brick_dim - 1)) >> sub_block_dim_log2;
+
+		const uint32_t z = (voxel_offset >> (brick_dim_log2 * 2)) >> sub_block_dim_log2;
+
+		return x | (y << 2) | (z << 4);
+	}
+
+	och::status validate_volume() noexcept
+	{
+		const uint64_t voxel_cnt = base_vol * level_cnt * brick_vol;
+
+		// Build the volume once more, timed like the CPU build below. Generation is deterministic, so this leaves the volume
+		// unchanged. A loaded volume is validated as it is instead.
+		if (volume_load_path == nullptr)
+		{
+			generation_region regions[MAX_LEVEL_CNT];
+
+			const uint32_t region_cnt = get_full_regions(volume_anchor, regions);
+
+			och::timer gpu_timer;
+
+			check(generate_regions(regions, region_cnt, true));
+
+			const och::timespan gpu_time = gpu_timer.read();
+
+			och::print("Validation: GPU built the volume in {} ({} Mvoxels/s)\n", gpu_time, voxel_cnt / ((gpu_time.milliseconds() + 1) * 1000));
+		}
+
+		const uint32_t gpu_brick_cnt = brick_pool_data->allocated_cnt;
+
+		const uint32_t gpu_leaf_cnt = brick_pool_data->leaf_allocated_cnt;
+
+		const uint64_t base_bytes = base_vol * level_cnt * sizeof(base_elem_t);
+
+		VkBuffer readback_buffer;
+
+		VkDeviceMemory readback_memory;
+
+		check(read_back_volume(readback_buffer, readback_memory, gpu_brick_cnt, gpu_leaf_cnt));
+
+		void* readback_data;
+
+		check(vkMapMemory(ctx.m_device, readback_memory, 0, VK_WHOLE_SIZE, 0, &readback_data));
+
+		const base_elem_t* gpu_base = static_cast<const base_elem_t*>(readback_data);
+
+		const uint8_t* gpu_bricks = static_cast<const uint8_t*>(readback_data) + base_bytes;
+
+		const leaf_elem_t* gpu_leaves = reinterpret_cast<const leaf_elem_t*>(gpu_bricks + brick_bytes(gpu_brick_cnt));
+
+		och::timer cpu_timer;
+
+		cpu_volume cpu(static_cast<uint32_t>(level_cnt), static_cast<uint32_t>(base_dim_log2), static_cast<uint32_t>(brick_dim_log2));
+
+		check(cpu.build(get_cpu_volume_params(), cpu_thread_cnt));
+
+		och::timespan cpu_time = cpu_timer.read();
+
+		// Brick indices are assigned in different orders, so compare cell by cell, looking through to the bricks where both sides have one
+
+		uint32_t classification_mismatch_cnt = 0;
+
+		uint64_t voxel_mismatch_cnt = 0;
+
+		uint64_t compared_voxel_cnt = 0;
+
+		for (uint32_t texel = 0; texel != base_vol * level_cnt; ++texel)
+		{
+			const uint32_t gpu_value = gpu_base[texel];
+
+			const uint32_t cpu_value = cpu.base[texel];
+
+			const bool gpu_is_brick = is_brick_cell(gpu_value);
+
+			const bool cpu_is_brick = is_brick_cell(cpu_value);
+
+			if (gpu_is_brick != cpu_is_brick || (!gpu_is_brick && gpu_value != cpu_value))
+			{
+				++classification_mismatch_cnt;
+
+				continue;
+			}
+
+			if (!gpu_is_brick)
+				continue;
+
+			compared_voxel_cnt += brick_vol;
+
+			for (uint32_t i = 0; i != brick_vol; ++i)
+			{
+				if (is_brick_voxel_filled(gpu_bricks, gpu_leaves, gpu_value, i) != cpu.is_voxel_filled(cpu_value, i))
+					++voxel_mismatch_cnt;
+			}
+		}
+
+		vkUnmapMemory(ctx.m_device, readback_memory);
+
+		vkDestroyBuffer(ctx.m_device, readback_buffer, nullptr);
+
+		vkFreeMemory(ctx.m_device, readback_memory, nullptr);
+
+		och::print("Validation: CPU built {} bricks in {} on {} threads ({} Mvoxels/s), GPU built {} bricks\n", cpu.brick_cnt, cpu_time, cpu_thread_cnt, voxel_cnt / ((cpu_time.milliseconds() + 1) * 1000), gpu_brick_cnt);
+
+		och::print("Validation: {} cell classification mismatches, {} voxel mismatches\n", classification_mismatch_cnt, voxel_mismatch_cnt);
+
+		if (classification_mismatch_cnt > base_vol * level_cnt / VALIDATION_VOXEL_TOLERANCE_DIVISOR || voxel_mismatch_cnt > compared_voxel_cnt / VALIDATION_VOXEL_TOLERANCE_DIVISOR)
+		{
+			och::print("Validation: Failed, more mismatches than the isolated ones caused by fused multiply-adds in simplex3d\n");
+
+			return to_status(och::error::argument_invalid);
+		}
+
+		// Trace the validation rays through the CPU volume now, and through the GPU one on run()'s first frame
+
+		// Leave room for run()'s view query, which shares the batch
+		const uint32_t validation_ray_cnt = VALIDATION_RAY_CNT < ray_query_capacity ? VALIDATION_RAY_CNT : ray_query_capacity - 1;
+
+		validation_queries.allocate(validation_ray_cnt);
+
+		validation_hits.allocate(validation_ray_cnt);
+
+		get_validation_rays(volume_anchor, validation_queries.data(), validation_ray_cnt);
+
+		if (validation_tracer.m_workers.thread_cnt() != cpu_thread_cnt)
+		{
+			validation_tracer.destroy();
+
+			validation_tracer.create(cpu_thread_cnt);
+		}
+
+		och::timer trace_timer;
+
+		check(validation_tracer.trace(cpu, validation_queries.data(), validation_ray_cnt, validation_hits.data()));
+
+		och::timespan trace_time = trace_timer.read();
+
+		och::print("Validation: CPU traced {} rays in {} on {} threads\n", validation_ray_cnt, trace_time, cpu_thread_cnt);
+
+		return {};
+	}
+
+	// Compares the query pass's hits for validation_queries against validation_hits. Hits entering the same voxel
+	// through the same side match, while hits at about the same time but in a neighbouring voxel are rounding at edges.
+	// Fails if too many of the remaining hits disagree.
+	och::status report_validation_hits(const ray_hit_t* gpu_hits) noexcept
+	{
+		uint32_t match_cnt = 0;
+
+		uint32_t edge_cnt = 0;
+
+		uint32_t capped_cnt = 0;
+
+		uint32_t mismatch_cnt = 0;
+
+		for (uint32_t i = 0; i != validation_hits.size(); ++i)
+		{
+			const ray_hit_t& gpu_hit = gpu_hits[i];
+
+			const cpu_ray_hit& cpu_hit = validation_hits[i];
+
+			const bool is_cpu_hit = cpu_hit.face != cpu_tracer::RAY_HIT_MISS;
+
+			const bool is_gpu_hit = gpu_hit.face != RAY_HIT_MISS;
+
+			if (gpu_hit.face == RAY_HIT_CAPPED)
+				++capped_cnt;
+			else if (gpu_hit.face == cpu_hit.face && gpu_hit.level == cpu_hit.level && (!is_gpu_hit || (gpu_hit.voxel[0] == cpu_hit.voxel[0] && gpu_hit.voxel[1] == cpu_hit.voxel[1] && gpu_hit.voxel[2] == cpu_hit.voxel[2])))
+				++match_cnt;
+			else if (is_cpu_hit && is_gpu_hit && fabsf(gpu_hit.time - cpu_hit.time) * static_cast<float>(brick_dim) <= static_cast<float>(1 << (gpu_hit.level > cpu_hit.level ? gpu_hit.level : cpu_hit.level)))
+				++edge_cnt;
+			else
+				++mismatch_cnt;
+		}
+
+		och::print("Validation: {} of {} ray queries match the CPU tracer, {} differ at an edge, {} disagree, {} ran into the iteration cap\n", match_cnt, validation_hits.size(), edge_cnt, mismatch_cnt, capped_cnt);
+
+		if (mismatch_cnt > validation_hits.size() / VALIDATION_RAY_TOLERANCE_DIVISOR)
+		{
+			och::print("Validation: Failed, too many ray queries disagree with the CPU tracer\n");
+
+			return to_status(och::error::argument_invalid);
+		}
+
+		return {};
+	}
+
+
+
+	och::status save_volume() noexcept
+	{
+		och::timer save_timer;
+
+		const uint32_t gpu_brick_cnt = brick_pool_data->allocated_cnt < brick_capacity ? brick_pool_data->allocated_cnt : brick_capacity;
+
+		const uint32_t gpu_leaf_cnt = brick_pool_data->leaf_allocated_cnt < leaf_capacity ? brick_pool_data->leaf_allocated_cnt : leaf_capacity;
+
+		const uint64_t base_bytes = base_vol * level_cnt * sizeof(base_elem_t);
+
+		const uint64_t bytes_per_brick = brick_bytes(1);
+
+		VkBuffer readback_buffer;
+
+		VkDeviceMemory readback_memory;
+
+		check(read_back_volume(readback_buffer, readback_memory, gpu_brick_cnt, gpu_leaf_cnt));
+
+		void* readback_data;
+
+		check(vkMapMemory(ctx.m_device, readback_memory, 0, VK_WHOLE_SIZE, 0, &readback_data));
+
+		const base_elem_t* gpu_base = static_cast<const base_elem_t*>(readback_data);
+
+		const uint8_t* gpu_bricks = static_cast<const uint8_t*>(readback_data) + base_bytes;
+
+		const leaf_elem_t* gpu_leaves = reinterpret_cast<const leaf_elem_t*>(gpu_bricks + brick_bytes(gpu_brick_cnt));
+
+		// Streaming leaves released bricks scattered through the pool, so renumber the referenced ones in base image order.
+		// Bricks shared by several cells are written once and stay shared.
+
+		heap_buffer<base_elem_t> compacted_base(static_cast<uint32_t>(base_vol * level_cnt));
+
+		heap_buffer<uint8_t> compacted_bricks(static_cast<uint32_t>(brick_bytes(gpu_brick_cnt)));
+
+		heap_buffer<uint32_t> compacted_indices(gpu_brick_cnt);
+
+		for (uint32_t i = 0; i != gpu_brick_cnt; ++i)
+			compacted_indices[i] = ~0u;
+
+		uint32_t compacted_brick_cnt = 0;
+
+		// Leaves are owned by a single brick, so they are simply appended in the order their bricks are compacted
+
+		heap_buffer<leaf_elem_t> compacted_leaves(static_cast<uint32_t>(leaf_bytes(gpu_leaf_cnt) / sizeof(leaf_elem_t)));
+
+		memset(compacted_leaves.data(), 0, leaf_bytes(gpu_leaf_cnt));
+
+		uint32_t compacted_leaf_cnt = 0;
+
+		for (uint32_t texel = 0; texel != base_vol * level_cnt; ++texel)
+		{
+			const base_elem_t value = gpu_base[texel];
+
+			if (!is_brick_cell(value))
+			{
+				compacted_base[texel] = value;
+			}
+			else
+			{
+				if (compacted_indices[value] == ~0u)
+				{
+					memcpy(compacted_bricks.data() + compacted_brick_cnt * bytes_per_brick, gpu_bricks + value * bytes_per_brick, bytes_per_brick);
+
+					if (brick_fmt == brick_format::leaf)
+					{
+						leaf_brick_elem_t* blocks = reinterpret_cast<leaf_brick_elem_t*>(compacted_bricks.data() + compacted_brick_cnt * bytes_per_brick);
+
+						for (uint32_t i = 0; i != brick_vol / LEAF_VOL; ++i)
+						{
+							if (blocks[i] == 0 || blocks[i] == 0xFFFFFFFF)
+								continue;
+
+							compacted_leaves[compacted_leaf_cnt] = gpu_leaves[blocks[i] - 1];
+
+							blocks[i] = ++compacted_leaf_cnt;
+						}
+					}
+
+					compacted_indices[value] = compacted_brick_cnt++;
+				}
+
+				compacted_base[texel] = compacted_indices[value];
+			}
+		}
+
+		vkUnmapMemory(ctx.m_device, readback_memory);
+
+		vkDestroyBuffer(ctx.m_device, readback_buffer, nullptr);
+
+		vkFreeMemory(ctx.m_device, readback_memory, nullptr);
+
+		volume_file_header header{};
+		header.level_cnt = level_cnt;
+		header.base_dim_log2 = base_dim_log2;
+		header.brick_dim_log2 = brick_dim_log2;
+		header.brick_format = static_cast<uint32_t>(brick_fmt);
+		header.brick_layout = static_cast<uint32_t>(voxel_layout);
+		header.gen_offset = gen_offset;
+		header.gen_scale = gen_scale;
+		header.gen_cutoff = gen_cutoff;
+		header.anchor[0] = volume_anchor[0];
+		header.anchor[1] = volume_anchor[1];
+		header.anchor[2] = volume_anchor[2];
+		header.brick_cnt = compacted_brick_cnt;
+		header.base_bytes = base_bytes;
+		header.brick_bytes = brick_bytes(compacted_brick_cnt);
+		header.leaf_cnt = compacted_leaf_cnt;
+		header.leaf_bytes = leaf_bytes(compacted_leaf_cnt);
+
+		check(write_volume_file(volume_save_path, header, compacted_base.data(), compacted_bricks.data(), compacted_leaves.data()));
+
+		och::print("Saved volume with {} bricks and {} leaves to {} in {}\n", compacted_brick_cnt, compacted_leaf_cnt, volume_save_path, save_timer.read());
+
+		return {};
+	}
+
+	// Maps volume_load_path and takes over its format and generation parameters. Must run before any resources depending on them are created.
+	och::status open_volume_file() noexcept
+	{
+		check(map_volume_file(volume_file, volume_file_hdr, volume_load_path));
+
+		level_cnt = volume_file_hdr->level_cnt;
+
+		base_dim_log2 = volume_file_hdr->base_dim_log2;
+
+		brick_dim_log2 = volume_file_hdr->brick_dim_log2;
+
+		check(init_geometry());
+
+		if (volume_file_hdr->brick_format > static_cast<uint32_t>(brick_format::leaf))
+			return to_status(och::error::argument_invalid);
+
+		brick_fmt = static_cast<brick_format>(volume_file_hdr->brick_format);
+
+		if (volume_file_hdr->brick_layout > static_cast<uint32_t>(brick_layout::morton))
+			return to_status(och::error::argument_invalid);
+
+		voxel_layout = static_cast<brick_layout>(volume_file_hdr->brick_layout);
+
+		if (volume_file_hdr->base_bytes != base_vol * level_cnt * sizeof(base_elem_t) || volume_file_hdr->brick_bytes != brick_bytes(volume_file_hdr->brick_cnt) || volume_file_hdr->leaf_bytes != leaf_bytes(volume_file_hdr->leaf_cnt))
+			return to_status(och::error::argument_invalid);
+
+		gen_offset = volume_file_hdr->gen_offset;
+
+		gen_scale = volume_file_hdr->gen_scale;
+
+		gen_cutoff = volume_file_hdr->gen_cutoff;
+
+		for (uint32_t a = 0; a != 3; ++a)
+			volume_anchor[a] = volume_file_hdr->anchor[a];
+
+		// Start the camera in the anchor cell, so that the first frame does not immediately stream in a new shell
+		input_position = och::vec3(static_cast<float>(volume_anchor[0]), static_cast<float>(volume_anchor[1]), static_cast<float>(volume_anchor[2]));
+
+		return {};
+	}
+
+	// Streams the mapped volume file into base_image and brick_buffer
+	och::status load_volume() noexcept
+	{
+		och::print("Started loading volume from {}\n", volume_load_path);
+
+		och::timer load_timer;
+
+		const base_elem_t* file_base = reinterpret_cast<const base_elem_t*>(volume_file.data() + volume_file_hdr->base_offset);
+
+		const uint8_t* file_bricks = volume_file.data() + volume_file_hdr->brick_offset;
+
+		const leaf_elem_t* file_leaves = reinterpret_cast<const leaf_elem_t*>(volume_file.data() + volume_file_hdr->leaf_offset);
+
+		// Check every reference in the file before staging any of it, so that a corrupt file leaves no partial uploads
+		// behind and is not read out of bounds below
+		for (uint32_t texel = 0; texel != base_vol * level_cnt; ++texel)
+			if (is_brick_cell(file_base[texel]) && file_base[texel] >= volume_file_hdr->brick_cnt)
+				return to_status(och::error::argument_invalid);
+
+		if (brick_fmt == brick_format::leaf)
+		{
+			const leaf_brick_elem_t* file_block_values = reinterpret_cast<const leaf_brick_elem_t*>(file_bricks);
+
+			const uint64_t block_cnt = static_cast<uint64_t>(volume_file_hdr->brick_cnt) * (brick_vol / LEAF_VOL);
+
+			// Blocks are uniform or hold their leaf's index plus one
+			for (uint64_t i = 0; i != block_cnt; ++i)
+				if (file_block_values[i] != 0xFFFFFFFF && file_block_values[i] > volume_file_hdr->leaf_cnt)
+					return to_status(och::error::argument_invalid);
+		}
+
+		// The generation counts are otherwise zeroed by every full rebuild
+		{
+			VkCommandBuffer clear_command_buffer;
+
+			check(ctx.begin_onetime_command(clear_command_buffer, gen_command_pool));
+
+			vkCmdFillBuffer(clear_command_buffer, gen_count_buffer, 0, VK_WHOLE_SIZE, 0);
+
+			vkCmdFillBuffer(clear_command_buffer, dedup_table_buffer, 0, VK_WHOLE_SIZE, 0);
+
+			vkCmdFillBuffer(clear_command_buffer, brick_free_mask_buffer, 0, VK_WHOLE_SIZE, 0);
+
+			check(ctx.submit_onetime_command(clear_command_buffer, gen_command_pool, ctx.m_compute_queues[0]));
+		}
+
+		VkBufferImageCopy base_region{};
+		base_region.bufferOffset = 0;
+		base_region.bufferRowLength = 0;
+		base_region.bufferImageHeight = 0;
+		base_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		base_region.imageSubresource.mipLevel = 0;
+		base_region.imageSubresource.baseArrayLayer = 0;
+		base_region.imageSubresource.layerCount = 1;
+		base_region.imageOffset = { 0, 0, 0 };
+		base_region.imageExtent = { static_cast<uint32_t>(base_dim * level_cnt), static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim) };
+
+		check(ctx.stage_image_upload(base_image, VK_IMAGE_LAYOUT_GENERAL, base_region, volume_file.data() + volume_file_hdr->base_offset, volume_file_hdr->base_bytes));
+
+		check(ctx.stage_buffer_upload(brick_buffer, 0, volume_file.data() + volume_file_hdr->brick_offset, volume_file_hdr->brick_bytes));
+
+		if (volume_file_hdr->leaf_bytes != 0)
+			check(ctx.stage_buffer_upload(leaf_buffer, 0, volume_file.data() + volume_file_hdr->leaf_offset, volume_file_hdr->leaf_bytes));
+
+		// Loaded bricks are not in the dedup table, but shared ones still need their reference counts for releasing them correctly
+		if (volume_file_hdr->brick_cnt != 0)
+		{
+			heap_buffer<brick_info_t> brick_infos(volume_file_hdr->brick_cnt);
+
+			memset(brick_infos.data(), 0, volume_file_hdr->brick_cnt * sizeof(brick_info_t));
+
+			for (uint32_t texel = 0; texel != base_vol * level_cnt; ++texel)
+				if (is_brick_cell(file_base[texel]))
+					++brick_infos[file_base[texel]].extra_ref_cnt;
+
+			for (uint32_t i = 0; i != volume_file_hdr->brick_cnt; ++i)
+				if (brick_infos[i].extra_ref_cnt != 0)
+					--brick_infos[i].extra_ref_cnt;
+
+			check(ctx.stage_buffer_upload(brick_info_buffer, 0, brick_infos.data(), volume_file_hdr->brick_cnt * sizeof(brick_info_t)));
+
+			// Sub-block masks are not part of the file, as they follow directly from the bricks
+			heap_buffer<brick_mask_t> brick_masks(volume_file_hdr->brick_cnt);
+
+			parallel_for(volume_file_hdr->brick_cnt, cpu_thread_cnt, [&](uint32_t brick_index) noexcept
+			{
+				brick_mask_t mask = 0;
+
+				for (uint32_t i = 0; i != brick_vol; ++i)
+					if (is_brick_voxel_filled(file_bricks, file_leaves, brick_index, i))
+						mask |= static_cast<brick_mask_t>(1) << sub_block_index(i);
+
+				brick_masks[brick_index] = mask;
+			});
+
+			check(ctx.stage_buffer_upload(brick_mask_buffer, 0, brick_masks.data(), volume_file_hdr->brick_cnt * sizeof(brick_mask_t)));
+		}
+
+		check(ctx.wait_staging_ring_idle());
+
+		// The distance field and brick atlas are not part of the file either, but have to wait for the uploads
+		{
+			VkCommandBuffer distance_command_buffer;
+
+			check(ctx.begin_onetime_command(distance_command_buffer, gen_command_pool));
+
+			VkMemoryBarrier upload_barrier;
+			upload_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			upload_barrier.pNext = nullptr;
+			upload_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			upload_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(distance_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &upload_barrier, 0, nullptr, 0, nullptr);
+
+			record_distance_field(distance_command_buffer, static_cast<uint32_t>((1 << level_cnt) - 1));
+
+			if (atlas_bricks)
+			{
+				generation_region regions[MAX_LEVEL_CNT];
+
+				const uint32_t region_cnt = get_full_regions(volume_anchor, regions);
+
+				record_atlas_copy(distance_command_buffer, regions, region_cnt);
+			}
+
+			check(ctx.submit_onetime_command(distance_command_buffer, gen_command_pool, ctx.m_compute_queues[0]));
+		}
+
+		// The loaded bricks are densely packed, so the free stack starts out empty
+		brick_pool_data->allocated_cnt = volume_file_hdr->brick_cnt;
+
+		brick_pool_data->free_cnt = 0;
+
+		brick_pool_data->deduplicated_cnt = 0;
+
+		brick_pool_data->leaf_allocated_cnt = volume_file_hdr->leaf_cnt;
+
+		brick_pool_data->leaf_free_cnt = 0;
+
+		const uint64_t file_bytes = volume_file_hdr->leaf_offset + volume_file_hdr->leaf_bytes;
+
+		volume_file.close();
+
+		volume_file_hdr = nullptr;
+
+		och::timespan load_time = load_timer.read();
+
+		och::print("Finished loading {} bricks ({} MB) in {}\n", brick_pool_data->allocated_cnt, file_bytes / (1024 * 1024), load_time);
+
+		return {};
+	}
+
+
+
+	och::status recreate_swapchain() noexcept
+	{
+		och::print("Recreating swapchain\n");
+
+		uint32_t old_image_cnt = ctx.m_swapchain_image_cnt;
+
+		check(ctx.recreate_swapchain());
+
+		check(vkResetDescriptorPool(ctx.m_device, descriptor_pool, 0));
+
+		for (uint32_t i = 0; i != old_image_cnt; ++i)
+		{
+			// vkDestroyImageView(ctx.m_device, hit_index_image_views[i], nullptr);
+
+			// vkDestroyImage(ctx.m_device, hit_index_images[i], nullptr);
+
+			vkDestroyImageView(ctx.m_device, hit_times_image_views[i], nullptr);
+
+			vkDestroyImage(ctx.m_device, hit_times_images[i], nullptr);
+
+			vkDestroyImageView(ctx.m_device, tile_start_image_views[i], nullptr);
+
+			vkDestroyImage(ctx.m_device, tile_start_images[i], nullptr);
+
+			vkDestroyImageView(ctx.m_device, reprojected_time_image_views[i], nullptr);
+
+			vkDestroyImage(ctx.m_device, reprojected_time_images[i], nullptr);
+
+			vkDestroyImageView(ctx.m_device, render_image_views[i], nullptr);
+
+			vkDestroyImage(ctx.m_device, render_images[i], nullptr);
+		}
+
+		// vkFreeMemory(ctx.m_device, hit_index_memory, nullptr);
+
+		vkFreeMemory(ctx.m_device, hit_times_memory, nullptr);
+
+		vkFreeMemory(ctx.m_device, tile_start_memory, nullptr);
+
+		vkFreeMemory(ctx.m_device, reprojected_time_memory, nullptr);
+
+		vkFreeMemory(ctx.m_device, render_image_memory, nullptr);
+
+		is_previous_frame_valid = false;
+
+		check(create_hit_data_resources());
+
+		VkDescriptorSetLayout descriptor_set_layouts[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+
+		for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
+			descriptor_set_layouts[i] = descriptor_set_layout;
+
+		VkDescriptorSetAllocateInfo descriptor_set_ai{};
+		descriptor_set_ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		descriptor_set_ai.pNext = nullptr;
+		descriptor_set_ai.descriptorPool = descriptor_pool;
+		descriptor_set_ai.descriptorSetCount = ctx.m_swapchain_image_cnt;
+		descriptor_set_ai.pSetLayouts = descriptor_set_layouts;
+
+		check(vkAllocateDescriptorSets(ctx.m_device, &descriptor_set_ai, descriptor_sets));
+
+		write_trace_descriptor_sets();
+
+		// TODO: Maybe recreate pipeline?
+
+		och::print("Finished recreating swapchain\n");
+
+		return {};
+	}
+
+	void write_trace_descriptor_sets() noexcept
+	{
+		VkDescriptorImageInfo image_infos[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT * 3];
+
+		VkDescriptorImageInfo distance_image_info{ nullptr, distance_image_view, VK_IMAGE_LAYOUT_GENERAL };
+
+		VkDescriptorBufferInfo buffer_infos[3]
+		{
+			{ brick_buffer     , 0, VK_WHOLE_SIZE },
+			{ leaf_buffer      , 0, VK_WHOLE_SIZE },
+			{ brick_mask_buffer, 0, VK_WHOLE_SIZE },
+		};
+
+		VkDescriptorBufferInfo trace_stats_info{ trace_stats_buffer, 0, VK_WHOLE_SIZE };
+
+		VkDescriptorBufferInfo ray_buffer_infos[3]
+		{
+			{ ray_queue_buffer, 0, VK_WHOLE_SIZE },
+			{ ray_query_buffer, 0, VK_WHOLE_SIZE },
+			{ ray_hit_buffer  , 0, VK_WHOLE_SIZE },
+		};
+
+		VkDescriptorImageInfo brick_atlas_info{ nullptr, brick_atlas_image_view, VK_IMAGE_LAYOUT_GENERAL };
+
+		VkDescriptorImageInfo tile_start_infos[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+
+		VkDescriptorImageInfo reprojected_time_infos[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+
+		// Every element of the array is written, with unused ones repeating the first swapchain image's
+		VkDescriptorImageInfo hit_times_history_infos[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+
+		for (uint32_t i = 0; i != vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT; ++i)
+		{
+			hit_times_history_infos[i].sampler = nullptr;
+			hit_times_history_infos[i].imageView = hit_times_image_views[i < ctx.m_swapchain_image_cnt ? i : 0];
+			hit_times_history_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+
+		VkDescriptorImageInfo swapchain_image_infos[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+
+		VkWriteDescriptorSet writes[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT * 10];
+
+		for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
+		{
+			image_infos[3 * i + 0].sampler = nullptr;
+			image_infos[3 * i + 0].imageView = dynamic_resolution_target_ms != 0.0F ? render_image_views[i] : ctx.m_swapchain_image_views[i]; // hit_index_image_views[i];
+			image_infos[3 * i + 0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			image_infos[3 * i + 1].sampler = nullptr;
+			image_infos[3 * i + 1].imageView = hit_times_image_views[i];
+			image_infos[3 * i + 1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			image_infos[3 * i + 2].sampler = nullptr;
+			image_infos[3 * i + 2].imageView = base_image_view;
+			image_infos[3 * i + 2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			writes[10 * i + 0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 0].pNext = nullptr;
+			writes[10 * i + 0].dstSet = descriptor_sets[i];
+			writes[10 * i + 0].dstBinding = 0;
+			writes[10 * i + 0].dstArrayElement = 0;
+			writes[10 * i + 0].descriptorCount = 3;
+			writes[10 * i + 0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[10 * i + 0].pImageInfo = &image_infos[3 * i];
+			writes[10 * i + 0].pBufferInfo = nullptr;
+			writes[10 * i + 0].pTexelBufferView = nullptr;
+
+			writes[10 * i + 1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 1].pNext = nullptr;
+			writes[10 * i + 1].dstSet = descriptor_sets[i];
+			writes[10 * i + 1].dstBinding = 3;
+			writes[10 * i + 1].dstArrayElement = 0;
+			writes[10 * i + 1].descriptorCount = 3;
+			writes[10 * i + 1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[10 * i + 1].pImageInfo = nullptr;
+			writes[10 * i + 1].pBufferInfo = buffer_infos;
+			writes[10 * i + 1].pTexelBufferView = nullptr;
+
+			writes[10 * i + 2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 2].pNext = nullptr;
+			writes[10 * i + 2].dstSet = descriptor_sets[i];
+			writes[10 * i + 2].dstBinding = 6;
+			writes[10 * i + 2].dstArrayElement = 0;
+			writes[10 * i + 2].descriptorCount = 1;
+			writes[10 * i + 2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[10 * i + 2].pImageInfo = &distance_image_info;
+			writes[10 * i + 2].pBufferInfo = nullptr;
+			writes[10 * i + 2].pTexelBufferView = nullptr;
+
+			writes[10 * i + 3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 3].pNext = nullptr;
+			writes[10 * i + 3].dstSet = descriptor_sets[i];
+			writes[10 * i + 3].dstBinding = 7;
+			writes[10 * i + 3].dstArrayElement = 0;
+			writes[10 * i + 3].descriptorCount = 1;
+			writes[10 * i + 3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[10 * i + 3].pImageInfo = nullptr;
+			writes[10 * i + 3].pBufferInfo = &trace_stats_info;
+			writes[10 * i + 3].pTexelBufferView = nullptr;
+
+			writes[10 * i + 4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 4].pNext = nullptr;
+			writes[10 * i + 4].dstSet = descriptor_sets[i];
+			writes[10 * i + 4].dstBinding = 8;
+			writes[10 * i + 4].dstArrayElement = 0;
+			writes[10 * i + 4].descriptorCount = 1;
+			writes[10 * i + 4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[10 * i + 4].pImageInfo = &brick_atlas_info;
+			writes[10 * i + 4].pBufferInfo = nullptr;
+			writes[10 * i + 4].pTexelBufferView = nullptr;
+
+			tile_start_infos[i].sampler = nullptr;
+			tile_start_infos[i].imageView = tile_start_image_views[i];
+			tile_start_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			writes[10 * i + 5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 5].pNext = nullptr;
+			writes[10 * i + 5].dstSet = descriptor_sets[i];
+			writes[10 * i + 5].dstBinding = 9;
+			writes[10 * i + 5].dstArrayElement = 0;
+			writes[10 * i + 5].descriptorCount = 1;
+			writes[10 * i + 5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[10 * i + 5].pImageInfo = &tile_start_infos[i];
+			writes[10 * i + 5].pBufferInfo = nullptr;
+			writes[10 * i + 5].pTexelBufferView = nullptr;
+
+			writes[10 * i + 6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 6].pNext = nullptr;
+			writes[10 * i + 6].dstSet = descriptor_sets[i];
+			writes[10 * i + 6].dstBinding = 10;
+			writes[10 * i + 6].dstArrayElement = 0;
+			writes[10 * i + 6].descriptorCount = vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
+			writes[10 * i + 6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[10 * i + 6].pImageInfo = hit_times_history_infos;
+			writes[10 * i + 6].pBufferInfo = nullptr;
+			writes[10 * i + 6].pTexelBufferView = nullptr;
+
+			reprojected_time_infos[i].sampler = nullptr;
+			reprojected_time_infos[i].imageView = reprojected_time_image_views[i];
+			reprojected_time_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			writes[10 * i + 7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 7].pNext = nullptr;
+			writes[10 * i + 7].dstSet = descriptor_sets[i];
+			writes[10 * i + 7].dstBinding = 11;
+			writes[10 * i + 7].dstArrayElement = 0;
+			writes[10 * i + 7].descriptorCount = 1;
+			writes[10 * i + 7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[10 * i + 7].pImageInfo = &reprojected_time_infos[i];
+			writes[10 * i + 7].pBufferInfo = nullptr;
+			writes[10 * i + 7].pTexelBufferView = nullptr;
+
+			writes[10 * i + 8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 8].pNext = nullptr;
+			writes[10 * i + 8].dstSet = descriptor_sets[i];
+			writes[10 * i + 8].dstBinding = 12;
+			writes[10 * i + 8].dstArrayElement = 0;
+			writes[10 * i + 8].descriptorCount = 3;
+			writes[10 * i + 8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[10 * i + 8].pImageInfo = nullptr;
+			writes[10 * i + 8].pBufferInfo = ray_buffer_infos;
+			writes[10 * i + 8].pTexelBufferView = nullptr;
+
+			swapchain_image_infos[i].sampler = nullptr;
+			swapchain_image_infos[i].imageView = ctx.m_swapchain_image_views[i];
+			swapchain_image_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			writes[10 * i + 9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[10 * i + 9].pNext = nullptr;
+			writes[10 * i + 9].dstSet = descriptor_sets[i];
+			writes[10 * i + 9].dstBinding = 15;
+			writes[10 * i + 9].dstArrayElement = 0;
+			writes[10 * i + 9].descriptorCount = 1;
+			writes[10 * i + 9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[10 * i + 9].pImageInfo = &swapchain_image_infos[i];
+			writes[10 * i + 9].pBufferInfo = nullptr;
+			writes[10 * i + 9].pTexelBufferView = nullptr;
+		}
+
+		vkUpdateDescriptorSets(ctx.m_device, ctx.m_swapchain_image_cnt * 10, writes, 0, nullptr);
+	}
+
+	och::status create_hit_data_resources() noexcept
+	{
+		// Allocate hit index images
+		// check(ctx.create_images_with_views(
+		// 	ctx.m_swapchain_image_cnt,
+		// 	hit_index_image_views, hit_index_images, hit_index_memory,
+		// 	{ ctx.m_swapchain_extent.width, ctx.m_swapchain_extent.height, 1 },
+		// 	VK_IMAGE_ASPECT_COLOR_BIT,
+		// 	VK_IMAGE_USAGE_STORAGE_BIT,
+		// 	VK_IMAGE_TYPE_2D,
+		// 	VK_IMAGE_VIEW_TYPE_2D,
+		// 	VK_FORMAT_R16_UINT,
+		// 	VK_FORMAT_R16_UINT,
+		// 	VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+
+		// Allocate hit times images
+		check(ctx.create_images_with_views(
+			ctx.m_swapchain_image_cnt,
+			hit_times_image_views, hit_times_images, hit_times_memory,
+			{ ctx.m_swapchain_extent.width, ctx.m_swapchain_extent.height, 1 },
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_VIEW_TYPE_2D,
+			VK_FORMAT_R32_SFLOAT,
+			VK_FORMAT_R32_SFLOAT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+
+		// Allocate tile start images. They are tiny, so they exist even without depth_prepass to keep the descriptor sets complete.
+		check(ctx.create_images_with_views(
+			ctx.m_swapchain_image_cnt,
+			tile_start_image_views, tile_start_images, tile_start_memory,
+			{ (ctx.m_swapchain_extent.width + PREPASS_TILE_DIM - 1) / PREPASS_TILE_DIM, (ctx.m_swapchain_extent.height + PREPASS_TILE_DIM - 1) / PREPASS_TILE_DIM, 1 },
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_VIEW_TYPE_2D,
+			VK_FORMAT_R32G32_SFLOAT,
+			VK_FORMAT_R32G32_SFLOAT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+
+		// Allocate reprojected time images, which are cleared before every reprojection
+		check(ctx.create_images_with_views(
+			ctx.m_swapchain_image_cnt,
+			reprojected_time_image_views, reprojected_time_images, reprojected_time_memory,
+			{ ctx.m_swapchain_extent.width, ctx.m_swapchain_extent.height, 1 },
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_VIEW_TYPE_2D,
+			VK_FORMAT_R32_UINT,
+			VK_FORMAT_R32_UINT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+
+		// Allocate render images, which are as large as the swapchain images so that any render extent fits
+		if (dynamic_resolution_target_ms != 0.0F)
+			check(ctx.create_images_with_views(
+				ctx.m_swapchain_image_cnt,
+				render_image_views, render_images, render_image_memory,
+				{ ctx.m_swapchain_extent.width, ctx.m_swapchain_extent.height, 1 },
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_USAGE_STORAGE_BIT,
+				VK_IMAGE_TYPE_2D,
+				VK_IMAGE_VIEW_TYPE_2D,
+				VK_FORMAT_R8G8B8A8_UNORM,
+				VK_FORMAT_R8G8B8A8_UNORM,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+
+		// Transition hit time, tile start, reprojected time and render images to be usable
+		{
+			VkCommandPool trans_command_pool;
+
+			VkCommandBuffer trans_command_buffer;
+
+			VkCommandPoolCreateInfo command_pool_ci{};
+			command_pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			command_pool_ci.pNext = nullptr;
+			command_pool_ci.flags = 0;
+			command_pool_ci.queueFamilyIndex = ctx.m_general_queues.family_index;
+
+			check(vkCreateCommandPool(ctx.m_device, &command_pool_ci, nullptr, &trans_command_pool));
+
+			check(ctx.begin_onetime_command(trans_command_buffer, trans_command_pool));
+
+			VkImageMemoryBarrier hit_image_barriers[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT * 4];
+
+			VkImage* const hit_images[4]{ hit_times_images, tile_start_images, reprojected_time_images, render_images };
+
+			const uint32_t hit_image_kind_cnt = dynamic_resolution_target_ms != 0.0F ? 4 : 3;
+
+			for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt * hit_image_kind_cnt; ++i)
+			{
+				hit_image_barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				hit_image_barriers[i].pNext = nullptr;
+				hit_image_barriers[i].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+				hit_image_barriers[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				hit_image_barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				hit_image_barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+				hit_image_barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				hit_image_barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				hit_image_barriers[i].image = hit_images[i / ctx.m_swapchain_image_cnt][i % ctx.m_swapchain_image_cnt];
+				hit_image_barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				hit_image_barriers[i].subresourceRange.baseMipLevel = 0;
+				hit_image_barriers[i].subresourceRange.levelCount = 1;
+				hit_image_barriers[i].subresourceRange.baseArrayLayer = 0;
+				hit_image_barriers[i].subresourceRange.layerCount = 1;
+			}
+
+			vkCmdPipelineBarrier(trans_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, ctx.m_swapchain_image_cnt * hit_image_kind_cnt, hit_image_barriers);
+
+			check(ctx.submit_onetime_command(trans_command_buffer, trans_command_pool, ctx.m_general_queues[0]));
+
+			vkDestroyCommandPool(ctx.m_device, trans_command_pool, nullptr);
+		}
+
+		return {};
+	}
+
+	och::status create() noexcept
+	{
+		check(init_geometry());
+
+		if (persistent_trace && ray_rate == trace_rate::variable)
+			return to_status(och::error::argument_invalid);
+
+		if (volume_load_path != nullptr)
+			check(open_volume_file());
+
+		och::print("Base MB: {}\nBrick MB: {} ({})\nLeaf MB: {}\n", (base_vol * sizeof(base_elem_t)) / (1024 * 1024), brick_bytes(initial_brick_capacity()) / (1024 * 1024), brick_format_name(), brick_fmt == brick_format::leaf ? leaf_bytes(OCCUPIED_LEAVES) / (1024 * 1024) : 0);
+
+		VkPhysicalDevice16BitStorageFeatures physical_device_16_bit_storage_feats{};
+		physical_device_16_bit_storage_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES;
+		physical_device_16_bit_storage_feats.pNext = nullptr;
+		physical_device_16_bit_storage_feats.storageBuffer16BitAccess = VK_TRUE;
+
+		VkPhysicalDeviceFeatures2 physical_device_feats{};
+		physical_device_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		physical_device_feats.pNext = &physical_device_16_bit_storage_feats;
+		physical_device_feats.features.shaderStorageImageExtendedFormats = VK_TRUE;
+		physical_device_feats.features.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
+
+		vulkan_context_create_info context_ci{};
+		context_ci.app_name = "Voxel Volume";
+		context_ci.window_width = 1440;
+		context_ci.window_height = 810;
+		context_ci.requested_api_version = VK_API_VERSION_1_1;
+		context_ci.swapchain_image_usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		context_ci.requested_compute_queues = 1;
+		context_ci.requested_transfer_queues = 1;
+		context_ci.transfer_queues_optional = true;
+		context_ci.staging_ring_bytes = STAGING_RING_BYTES;
+		// Dynamic resolution is adjusted by the profiled time of the passes working at the render extent
+		context_ci.profiler_frame_cnt = profile_path != nullptr || measure_gpu_times || dynamic_resolution_target_ms != 0.0F ? MAX_FRAMES_INFLIGHT + 1 : 0;
+		context_ci.physical_device_suitable_callback = voxel_volume_physical_device_suitable_callback;
+		context_ci.enabled_device_features2 = &physical_device_feats;
+
+		check(ctx.create(&context_ci));
+
+		// Collect the distinct queue families accessing the volume
+		{
+			const uint32_t families[]{ ctx.m_general_queues.family_index, ctx.m_compute_queues.family_index, ctx.m_staging_queue_family_index };
+
+			for (uint32_t family : families)
+			{
+				bool is_duplicate = false;
+
+				for (uint32_t i = 0; i != volume_queue_family_cnt; ++i)
+					is_duplicate |= volume_queue_families[i] == family;
+
+				if (!is_duplicate)
+					volume_queue_families[volume_queue_family_cnt++] = family;
+			}
+
+			if (volume_queue_family_cnt > 1)
+			{
+				volume_sharing_mode = VK_SHARING_MODE_CONCURRENT;
+			}
+			else
+			{
+				volume_sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+
+				volume_queue_family_cnt = 0;
+			}
+		}
+
+		// Create Base Image
+		check(ctx.create_image_with_view(base_image_view, base_image, base_image_memory, 
+			{ static_cast<uint32_t>(base_dim * level_cnt), static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim) },
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_IMAGE_TYPE_3D, 
+			VK_IMAGE_VIEW_TYPE_3D, 
+			VK_FORMAT_R32_UINT, 
+			VK_FORMAT_R32_UINT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			volume_sharing_mode,
+			volume_queue_family_cnt,
+			volume_queue_families));
+
+		// Create Distance Images. Only the final distances are read by the tracer.
+		check(ctx.create_image_with_view(distance_image_view, distance_image, distance_image_memory, 
+			{ static_cast<uint32_t>(base_dim * level_cnt), static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim) },
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_TYPE_3D, 
+			VK_IMAGE_VIEW_TYPE_3D, 
+			VK_FORMAT_R8_UINT, 
+			VK_FORMAT_R8_UINT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			volume_sharing_mode,
+			volume_queue_family_cnt,
+			volume_queue_families));
+
+		check(ctx.create_image_with_view(distance_scratch_image_view, distance_scratch_image, distance_scratch_image_memory, 
+			{ static_cast<uint32_t>(base_dim * level_cnt), static_cast<uint32_t>(base_dim), static_cast<uint32_t>(base_dim) },
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_IMAGE_TYPE_3D, 
+			VK_IMAGE_VIEW_TYPE_3D, 
+			VK_FORMAT_R8_UINT, 
+			VK_FORMAT_R8_UINT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+
+		// Allocate Brick and Leaf buffers, making sure a loaded volume fits without immediately growing.
+		// Only leaf bricks use the leaf pool, so it is kept minimal for the other formats.
+		{
+			uint64_t initial_capacity = initial_brick_capacity();
+
+			uint64_t initial_leaf_capacity = brick_fmt == brick_format::leaf ? OCCUPIED_LEAVES : 1;
+
+			if (volume_file_hdr != nullptr && volume_file_hdr->brick_cnt > initial_brick_capacity())
+				initial_capacity = padded_brick_capacity(volume_file_hdr->brick_cnt);
+
+			if (volume_file_hdr != nullptr && volume_file_hdr->leaf_cnt > initial_leaf_capacity)
+				initial_leaf_capacity = padded_brick_capacity(volume_file_hdr->leaf_cnt);
+
+			if (initial_capacity > static_cast<uint64_t>(CELL_INDEX_MASK) + 1 || initial_leaf_capacity > UINT32_MAX)
+				return to_status(och::error::argument_too_large);
+
+			check(create_brick_pool(static_cast<uint32_t>(initial_capacity), static_cast<uint32_t>(initial_leaf_capacity)));
+		}
+
+		// Allocate hit data images
+		check(create_hit_data_resources());
+
+		// Create trace statistics counters. They stay zero unless count_brick_lines or count_lane_steps is set.
+		check(ctx.create_buffer(trace_stats_buffer, trace_stats_memory, 
+			sizeof(trace_stats_data_t), 
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+		check(vkMapMemory(ctx.m_device, trace_stats_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&trace_stats_data)));
+
+		*trace_stats_data = {};
+
+		// Create the persistent tracer's ray queue, which is zeroed before every frame
+		check(ctx.create_buffer(ray_queue_buffer, ray_queue_memory, 
+			sizeof(uint32_t), 
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+
+		// Create the ray query and hit buffers, which are written and read by the host without staging
+		if (ray_query_capacity == 0)
+			return to_status(och::error::argument_invalid);
+
+		check(ctx.create_buffer(ray_query_buffer, ray_query_memory, 
+			RAY_QUERY_SLICE_CNT * ray_query_capacity * sizeof(ray_query_t), 
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+		check(vkMapMemory(ctx.m_device, ray_query_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&ray_query_data)));
+
+		check(ctx.create_buffer(ray_hit_buffer, ray_hit_memory, 
+			RAY_QUERY_SLICE_CNT * ray_query_capacity * sizeof(ray_hit_t), 
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+		check(vkMapMemory(ctx.m_device, ray_hit_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&ray_hit_data)));
+
+		// Create the sampler through which the tracer fetches atlas texels. Only texelFetch is used, so filtering is irrelevant.
+		{
+			VkSamplerCreateInfo sampler_ci{};
+			sampler_ci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+			sampler_ci.pNext = nullptr;
+			sampler_ci.flags = 0;
+			sampler_ci.magFilter = VK_FILTER_NEAREST;
+			sampler_ci.minFilter = VK_FILTER_NEAREST;
+			sampler_ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			sampler_ci.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			sampler_ci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			sampler_ci.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			sampler_ci.mipLodBias = 0.0F;
+			sampler_ci.anisotropyEnable = VK_FALSE;
+			sampler_ci.maxAnisotropy = 1.0F;
+			sampler_ci.compareEnable = VK_FALSE;
+			sampler_ci.compareOp = VK_COMPARE_OP_NEVER;
+			sampler_ci.minLod = 0.0F;
+			sampler_ci.maxLod = 0.0F;
+			sampler_ci.borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK;
+			sampler_ci.unnormalizedCoordinates = VK_FALSE;
+
+			check(vkCreateSampler(ctx.m_device, &sampler_ci, nullptr, &brick_atlas_sampler));
+		}
+
+		// Create Pipeline
+		{
+			check(ctx.load_shader_module_file(trace_shader_module, "../spirv/trace.comp.spv"));
+
+			if (persistent_trace)
+				check(ctx.load_shader_module_file(persistent_trace_shader_module, "../spirv/trace_persistent.comp.spv"));
+
+			check(ctx.load_shader_module_file(query_shader_module, "../spirv/query.comp.spv"));
+
+			struct
+			{
+				uint32_t group_size_x;
+				uint32_t group_size_y;
+				uint32_t base_dim_log2;
+				uint32_t brick_dim_log2;
+				uint32_t level_cnt;
+				VkBool32 bitpacked_bricks;
+				VkBool32 leaf_bricks;
+				VkBool32 morton_bricks;
+				VkBool32 count_brick_lines;
+				VkBool32 atlas_bricks;
+				VkBool32 depth_prepass;
+				VkBool32 prepass_start;
+				VkBool32 reproject_start;
+				uint32_t sparse_trace;
+				VkBool32 count_lane_steps;
+				VkBool32 ray_query;
+				VkBool32 swizzle_groups;
+			} specialization_data;
+
+			specialization_data.group_size_x = trace_group_size[0];
+			specialization_data.group_size_y = trace_group_size[1];
+			specialization_data.base_dim_log2 = static_cast<uint32_t>(base_dim_log2);
+			specialization_data.brick_dim_log2 = static_cast<uint32_t>(brick_dim_log2);
+			specialization_data.level_cnt = static_cast<uint32_t>(level_cnt);
+			specialization_data.bitpacked_bricks = brick_fmt == brick_format::bitpacked;
+			specialization_data.leaf_bricks = brick_fmt == brick_format::leaf;
+			specialization_data.morton_bricks = voxel_layout == brick_layout::morton;
+			specialization_data.count_brick_lines = count_brick_lines;
+			specialization_data.atlas_bricks = atlas_bricks;
+			specialization_data.depth_prepass = false;
+			specialization_data.prepass_start = depth_prepass;
+			specialization_data.reproject_start = reproject_hits;
+			specialization_data.sparse_trace = static_cast<uint32_t>(ray_rate);
+			specialization_data.count_lane_steps = count_lane_steps;
+			specialization_data.ray_query = false;
+			specialization_data.swizzle_groups = swizzle_groups;
+			
+			VkSpecializationMapEntry specialization_entries[]{
+				{ 1, offsetof(decltype(specialization_data), group_size_x), sizeof(uint32_t) },
+				{ 2, offsetof(decltype(specialization_data), group_size_y), sizeof(uint32_t) },
+				{ 3, offsetof(decltype(specialization_data), base_dim_log2), sizeof(uint32_t) },
+				{ 4, offsetof(decltype(specialization_data), brick_dim_log2), sizeof(uint32_t) },
+				{ 5, offsetof(decltype(specialization_data), level_cnt), sizeof(uint32_t) },
+				{ 6, offsetof(decltype(specialization_data), bitpacked_bricks), sizeof(VkBool32) },
+				{ 7, offsetof(decltype(specialization_data), leaf_bricks), sizeof(VkBool32) },
+				{ 9, offsetof(decltype(specialization_data), morton_bricks), sizeof(VkBool32) },
+				{ 10, offsetof(decltype(specialization_data), count_brick_lines), sizeof(VkBool32) },
+				{ 11, offsetof(decltype(specialization_data), atlas_bricks), sizeof(VkBool32) },
+				{ 12, offsetof(decltype(specialization_data), depth_prepass), sizeof(VkBool32) },
+				{ 13, offsetof(decltype(specialization_data), prepass_start), sizeof(VkBool32) },
+				{ 14, offsetof(decltype(specialization_data), reproject_start), sizeof(VkBool32) },
+				{ 15, offsetof(decltype(specialization_data), sparse_trace), sizeof(uint32_t) },
+				{ 16, offsetof(decltype(specialization_data), count_lane_steps), sizeof(VkBool32) },
+				{ 17, offsetof(decltype(specialization_data), ray_query), sizeof(VkBool32) },
+				{ 18, offsetof(decltype(specialization_data), swizzle_groups), sizeof(VkBool32) },
+			};
+			
+			VkSpecializationInfo specialization_info{};
+			specialization_info.mapEntryCount = _countof(specialization_entries);
+			specialization_info.pMapEntries = specialization_entries;
+			specialization_info.dataSize = sizeof(specialization_data);
+			specialization_info.pData = &specialization_data;
+			
+			VkDescriptorSetLayoutBinding descriptor_set_layout_bindings[16]{};
+			// Base image array
+			descriptor_set_layout_bindings[0].binding = 0;
+			descriptor_set_layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[0].descriptorCount = 1;
+			descriptor_set_layout_bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[0].pImmutableSamplers = nullptr;
+			// Brick buffer
+			descriptor_set_layout_bindings[1].binding = 1;
+			descriptor_set_layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[1].descriptorCount = 1;
+			descriptor_set_layout_bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[1].pImmutableSamplers = nullptr;
+			// Leaf buffer
+			descriptor_set_layout_bindings[2].binding = 2;
+			descriptor_set_layout_bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[2].descriptorCount = 1;
+			descriptor_set_layout_bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[2].pImmutableSamplers = nullptr;
+			// Hit ids
+			descriptor_set_layout_bindings[3].binding = 3;
+			descriptor_set_layout_bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_set_layout_bindings[3].descriptorCount = 1;
+			descriptor_set_layout_bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[3].pImmutableSamplers = nullptr;
+			// Hit times
+			descriptor_set_layout_bindings[4].binding = 4;
+			descriptor_set_layout_bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_set_layout_bindings[4].descriptorCount = 1;
+			descriptor_set_layout_bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[4].pImmutableSamplers = nullptr;
+
+			descriptor_set_layout_bindings[5].binding = 5;
+			descriptor_set_layout_bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_set_layout_bindings[5].descriptorCount = 1;
+			descriptor_set_layout_bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[5].pImmutableSamplers = nullptr;
+
+			descriptor_set_layout_bindings[6].binding = 6;
+			descriptor_set_layout_bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[6].descriptorCount = 1;
+			descriptor_set_layout_bindings[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[6].pImmutableSamplers = nullptr;
+			// Trace statistics
+			descriptor_set_layout_bindings[7].binding = 7;
+			descriptor_set_layout_bindings[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_set_layout_bindings[7].descriptorCount = 1;
+			descriptor_set_layout_bindings[7].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[7].pImmutableSamplers = nullptr;
+			// Brick atlas
+			descriptor_set_layout_bindings[8].binding = 8;
+			descriptor_set_layout_bindings[8].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptor_set_layout_bindings[8].descriptorCount = 1;
+			descriptor_set_layout_bindings[8].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[8].pImmutableSamplers = &brick_atlas_sampler;
+			// Tile starts
+			descriptor_set_layout_bindings[9].binding = 9;
+			descriptor_set_layout_bindings[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[9].descriptorCount = 1;
+			descriptor_set_layout_bindings[9].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[9].pImmutableSamplers = nullptr;
+			// Hit times of all swapchain images
+			descriptor_set_layout_bindings[10].binding = 10;
+			descriptor_set_layout_bindings[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[10].descriptorCount = vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
+			descriptor_set_layout_bindings[10].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[10].pImmutableSamplers = nullptr;
+			// Reprojected times
+			descriptor_set_layout_bindings[11].binding = 11;
+			descriptor_set_layout_bindings[11].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[11].descriptorCount = 1;
+			descriptor_set_layout_bindings[11].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[11].pImmutableSamplers = nullptr;
+			// Ray queue
+			descriptor_set_layout_bindings[12].binding = 12;
+			descriptor_set_layout_bindings[12].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_set_layout_bindings[12].descriptorCount = 1;
+			descriptor_set_layout_bindings[12].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[12].pImmutableSamplers = nullptr;
+			// Ray queries
+			descriptor_set_layout_bindings[13].binding = 13;
+			descriptor_set_layout_bindings[13].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_set_layout_bindings[13].descriptorCount = 1;
+			descriptor_set_layout_bindings[13].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[13].pImmutableSamplers = nullptr;
+			// Ray hits
+			descriptor_set_layout_bindings[14].binding = 14;
+			descriptor_set_layout_bindings[14].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_set_layout_bindings[14].descriptorCount = 1;
+			descriptor_set_layout_bindings[14].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[14].pImmutableSamplers = nullptr;
+			// Swapchain image, written by upscale
+			descriptor_set_layout_bindings[15].binding = 15;
+			descriptor_set_layout_bindings[15].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_set_layout_bindings[15].descriptorCount = 1;
+			descriptor_set_layout_bindings[15].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			descriptor_set_layout_bindings[15].pImmutableSamplers = nullptr;
+			
+			VkDescriptorSetLayoutCreateInfo descriptor_set_layout_ci{};
+			descriptor_set_layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			descriptor_set_layout_ci.pNext = nullptr;
+			descriptor_set_layout_ci.flags = 0;
+			descriptor_set_layout_ci.bindingCount = 16;
+			descriptor_set_layout_ci.pBindings = descriptor_set_layout_bindings;
+			
+			check(vkCreateDescriptorSetLayout(ctx.m_device, &descriptor_set_layout_ci, nullptr, &descriptor_set_layout));
+			
+			VkPushConstantRange push_constant_range;
+			push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			push_constant_range.offset = 0;
+			push_constant_range.size = sizeof(push_constant_data_t);
+			
+			VkPipelineLayoutCreateInfo pipeline_layout_ci{};
+			pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			pipeline_layout_ci.pNext = nullptr;
+			pipeline_layout_ci.flags = 0;
+			pipeline_layout_ci.setLayoutCount = 1;
+			pipeline_layout_ci.pSetLayouts = &descriptor_set_layout;
+			pipeline_layout_ci.pushConstantRangeCount = 1;
+			pipeline_layout_ci.pPushConstantRanges = &push_constant_range;
+			
+			check(vkCreatePipelineLayout(ctx.m_device, &pipeline_layout_ci, nullptr, &pipeline_layout));
+			
+			VkComputePipelineCreateInfo pipeline_ci{};
+			pipeline_ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			pipeline_ci.pNext = nullptr;
+			pipeline_ci.flags = 0;
+			pipeline_ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipeline_ci.stage.pNext = nullptr;
+			pipeline_ci.stage.flags = 0;
+			pipeline_ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipeline_ci.stage.module = persistent_trace ? persistent_trace_shader_module : trace_shader_module;
+			pipeline_ci.stage.pName = "main";
+			pipeline_ci.stage.pSpecializationInfo = &specialization_info;
+			pipeline_ci.layout = pipeline_layout;
+			pipeline_ci.basePipelineHandle = nullptr;
+			pipeline_ci.basePipelineIndex = -1;
+			
+			check(vkCreateComputePipelines(ctx.m_device, nullptr, 1, &pipeline_ci, nullptr, &pipeline));
+
+			// The prepass only reads base cells, so brick statistics are left off
+			if (depth_prepass)
+			{
+				specialization_data.count_brick_lines = false;
+				specialization_data.count_lane_steps = false;
+				specialization_data.depth_prepass = true;
+				specialization_data.prepass_start = false;
+				specialization_data.reproject_start = false;
+				specialization_data.sparse_trace = static_cast<uint32_t>(trace_rate::full);
+
+				pipeline_ci.stage.module = trace_shader_module;
+
+				check(vkCreateComputePipelines(ctx.m_device, nullptr, 1, &pipeline_ci, nullptr, &prepass_pipeline));
+			}
+
+			// Queries start from their own origin, so nothing carries over from earlier passes
+			{
+				specialization_data.count_brick_lines = false;
+				specialization_data.count_lane_steps = false;
+				specialization_data.depth_prepass = false;
+				specialization_data.prepass_start = false;
+				specialization_data.reproject_start = false;
+				specialization_data.sparse_trace = static_cast<uint32_t>(trace_rate::full);
+				specialization_data.ray_query = true;
+
+				pipeline_ci.stage.module = query_shader_module;
+
+				check(vkCreateComputePipelines(ctx.m_device, nullptr, 1, &pipeline_ci, nullptr, &query_pipeline));
+			}
+
+			// reproject, resolve and upscale only read the workgroup size from the specialization constants
+			if (reproject_hits)
+			{
+				check(ctx.load_shader_module_file(reproject_shader_module, "../spirv/reproject.comp.spv"));
+
+				pipeline_ci.stage.module = reproject_shader_module;
+
+				check(vkCreateComputePipelines(ctx.m_device, nullptr, 1, &pipeline_ci, nullptr, &reproject_pipeline));
+			}
+
+			if (ray_rate != trace_rate::full)
+			{
+				check(ctx.load_shader_module_file(resolve_shader_module, "../spirv/resolve.comp.spv"));
+
+				pipeline_ci.stage.module = resolve_shader_module;
+
+				check(vkCreateComputePipelines(ctx.m_device, nullptr, 1, &pipeline_ci, nullptr, &resolve_pipeline));
+			}
+
+			if (dynamic_resolution_target_ms != 0.0F)
+			{
+				check(ctx.load_shader_module_file(upscale_shader_module, "../spirv/upscale.comp.spv"));
+
+				pipeline_ci.stage.module = upscale_shader_module;
+
+				check(vkCreateComputePipelines(ctx.m_device, nullptr, 1, &pipeline_ci, nullptr, &upscale_pipeline));
+			}
+		}
+
+		// Create Descriptors
+		{
+			VkDescriptorPoolSize descriptor_pool_sizes[3]{};
+			descriptor_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptor_pool_sizes[0].descriptorCount = (7 + vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT) * vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
+			descriptor_pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_pool_sizes[1].descriptorCount = 7 * vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
+			descriptor_pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptor_pool_sizes[2].descriptorCount = vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
+
+			VkDescriptorPoolCreateInfo descriptor_pool_ci{};
+			descriptor_pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			descriptor_pool_ci.pNext = nullptr;
+			descriptor_pool_ci.flags = 0;
+			descriptor_pool_ci.maxSets = vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT;
+			descriptor_pool_ci.poolSizeCount = 3;
+			descriptor_pool_ci.pPoolSizes = descriptor_pool_sizes;
+			
+			check(vkCreateDescriptorPool(ctx.m_device, &descriptor_pool_ci, nullptr, &descriptor_pool));
+
+			VkDescriptorSetLayout descriptor_set_layouts[vulkan_context::MAX_SWAPCHAIN_IMAGE_CNT];
+
+			for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
+				descriptor_set_layouts[i] = descriptor_set_layout;
+
+			VkDescriptorSetAllocateInfo descriptor_set_ai{};
+			descriptor_set_ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			descriptor_set_ai.pNext = nullptr;
+			descriptor_set_ai.descriptorPool = descriptor_pool;
+			descriptor_set_ai.descriptorSetCount = ctx.m_swapchain_image_cnt;
+			descriptor_set_ai.pSetLayouts = descriptor_set_layouts;
+
+			check(vkAllocateDescriptorSets(ctx.m_device, &descriptor_set_ai, descriptor_sets));
+
+			write_trace_descriptor_sets();
+		}
+
+		// Create Command Buffers
+		{
+			VkCommandPoolCreateInfo command_pool_ci{};
+			command_pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			command_pool_ci.pNext = nullptr;
+			command_pool_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			command_pool_ci.queueFamilyIndex = ctx.m_general_queues.family_index;
+
+			check(vkCreateCommandPool(ctx.m_device, &command_pool_ci, nullptr, &command_pool));
+
+			VkCommandBufferAllocateInfo command_buffer_ai{};
+			command_buffer_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			command_buffer_ai.pNext = nullptr;
+			command_buffer_ai.commandPool = command_pool;
+			command_buffer_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			command_buffer_ai.commandBufferCount = MAX_FRAMES_INFLIGHT;
+
+			check(vkAllocateCommandBuffers(ctx.m_device, &command_buffer_ai, command_buffers));
+		}
+
+		// Create sync resources
+		{
+			VkSemaphoreCreateInfo semaphore_ci{};
+			semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphore_ci.pNext = nullptr;
+			semaphore_ci.flags = 0;
+
+			VkFenceCreateInfo fence_ci{};
+			fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fence_ci.pNext = nullptr;
+			fence_ci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+			for (uint32_t i = 0; i != MAX_FRAMES_INFLIGHT; ++i)
+			{
+				check(vkCreateSemaphore(ctx.m_device, &semaphore_ci, nullptr, &image_available_semaphores[i]));
+
+				check(vkCreateSemaphore(ctx.m_device, &semaphore_ci, nullptr, &render_complete_semaphores[i]));
+
+				check(vkCreateFence(ctx.m_device, &fence_ci, nullptr, &frame_inflight_fences[i]));
+			}
+		}
+
+		check(create_generation_resources());
+
+		if (volume_load_path != nullptr)
+			check(load_volume());
+		else
+			check(build_volume());
+
+		if (volume_save_path != nullptr)
+			check(save_volume());
+
+		if (validate_build)
+			check(validate_volume());
+
+		return {};
+	}
+
+	void destroy() noexcept
+	{
+		validation_tracer.destroy();
+
+		if (ctx.m_device == nullptr)
+			return;
+
+		if (vkDeviceWaitIdle(ctx.m_device) != VK_SUCCESS)
+			return;
+
+		for (uint32_t i = 0; i != MAX_FRAMES_INFLIGHT; ++i)
+		{
+			vkDestroySemaphore(ctx.m_device, image_available_semaphores[i], nullptr);
+
+			vkDestroySemaphore(ctx.m_device, render_complete_semaphores[i], nullptr);
+
+			vkDestroyFence(ctx.m_device, frame_inflight_fences[i], nullptr);
+		}
+
+		destroy_generation_resources();
+
+		vkDestroyPipeline(ctx.m_device, pipeline, nullptr);
+
+		vkDestroyPipeline(ctx.m_device, prepass_pipeline, nullptr);
+
+		vkDestroyPipeline(ctx.m_device, reproject_pipeline, nullptr);
+
+		vkDestroyPipeline(ctx.m_device, resolve_pipeline, nullptr);
+
+		vkDestroyPipeline(ctx.m_device, query_pipeline, nullptr);
+
+		vkDestroyPipeline(ctx.m_device, upscale_pipeline, nullptr);
+
+		vkDestroyPipelineLayout(ctx.m_device, pipeline_layout, nullptr);
+
+		vkDestroyDescriptorSetLayout(ctx.m_device, descriptor_set_layout, nullptr);
+
+		vkDestroyShaderModule(ctx.m_device, trace_shader_module, nullptr);
+
+		vkDestroyShaderModule(ctx.m_device, reproject_shader_module, nullptr);
+
+		vkDestroyShaderModule(ctx.m_device, resolve_shader_module, nullptr);
+
+		vkDestroyShaderModule(ctx.m_device, persistent_trace_shader_module, nullptr);
+
+		vkDestroyShaderModule(ctx.m_device, query_shader_module, nullptr);
+
+		vkDestroyShaderModule(ctx.m_device, upscale_shader_module, nullptr);
+
+
+
+		vkDestroyDescriptorPool(ctx.m_device, descriptor_pool, nullptr);
+
+		vkDestroyCommandPool(ctx.m_device, command_pool, nullptr);
+
+
+
+		for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
+		{
+			vkDestroyImageView(ctx.m_device, hit_times_image_views[i], nullptr);
+		
+			vkDestroyImage(ctx.m_device, hit_times_images[i], nullptr);
+
+			vkDestroyImageView(ctx.m_device, tile_start_image_views[i], nullptr);
+
+			vkDestroyImage(ctx.m_device, tile_start_images[i], nullptr);
+
+			vkDestroyImageView(ctx.m_device, reprojected_time_image_views[i], nullptr);
+
+			vkDestroyImage(ctx.m_device, reprojected_time_images[i], nullptr);
+
+			vkDestroyImageView(ctx.m_device, render_image_views[i], nullptr);
+
+			vkDestroyImage(ctx.m_device, render_images[i], nullptr);
+
+			// vkDestroyImageView(ctx.m_device, hit_index_image_views[i], nullptr);
+
+			// vkDestroyImage(ctx.m_device, hit_index_images[i], nullptr);
+		}
+
+		vkFreeMemory(ctx.m_device, hit_times_memory, nullptr);
+
+		vkFreeMemory(ctx.m_device, tile_start_memory, nullptr);
+
+		vkFreeMemory(ctx.m_device, reprojected_time_memory, nullptr);
+
+		vkFreeMemory(ctx.m_device, render_image_memory, nullptr);
+
+		// vkFreeMemory(ctx.m_device, hit_index_memory, nullptr);
+
+		vkDestroySampler(ctx.m_device, brick_atlas_sampler, nullptr);
+
+		vkDestroyBuffer(ctx.m_device, trace_stats_buffer, nullptr);
+
+		vkFreeMemory(ctx.m_device, trace_stats_memory, nullptr);
+
+		vkDestroyBuffer(ctx.m_device, ray_queue_buffer, nullptr);
+
+		vkFreeMemory(ctx.m_device, ray_queue_memory, nullptr);
+
+		vkDestroyBuffer(ctx.m_device, ray_query_buffer, nullptr);
+
+		vkFreeMemory(ctx.m_device, ray_query_memory, nullptr);
+
+		vkDestroyBuffer(ctx.m_device, ray_hit_buffer, nullptr);
+
+		vkFreeMemory(ctx.m_device, ray_hit_memory, nullptr);
+
+
+
+		vkDestroyImageView(ctx.m_device, base_image_view, nullptr);
+
+		vkDestroyImage(ctx.m_device, base_image, nullptr);
+
+		vkFreeMemory(ctx.m_device, base_image_memory, nullptr);
+
+		vkDestroyImageView(ctx.m_device, distance_scratch_image_view, nullptr);
+
+		vkDestroyImage(ctx.m_device, distance_scratch_image, nullptr);
+
+		vkFreeMemory(ctx.m_device, distance_scratch_image_memory, nullptr);
+
+		vkDestroyImageView(ctx.m_device, distance_image_view, nullptr);
+
+		vkDestroyImage(ctx.m_device, distance_image, nullptr);
+
+		vkFreeMemory(ctx.m_device, distance_image_memory, nullptr);
+
+		destroy_brick_pool();
+
+
+
+		ctx.destroy();
+	}
+
+	// Queues rays to be traced by the next recorded frame, along with any queued before it in the same frame.
+	// out_batch identifies the batch to pass to poll_ray_queries, which holds the hit of queries[i] at out_first_hit + i.
+	och::status enqueue_ray_queries(const ray_query_t* queries, uint32_t query_cnt, uint64_t& out_batch, uint32_t& out_first_hit) noexcept
+	{
+		if (query_cnt > ray_query_capacity - pending_ray_query_cnt)
+			return to_status(och::error::argument_too_large);
+
+		ray_query_t* const slice = ray_query_data + (pending_ray_query_batch % RAY_QUERY_SLICE_CNT) * ray_query_capacity;
+
+		memcpy(slice + pending_ray_query_cnt, queries, query_cnt * sizeof(ray_query_t));
+
+		out_batch = pending_ray_query_batch;
+
+		out_first_hit = pending_ray_query_cnt;
+
+		pending_ray_query_cnt += query_cnt;
+
+		return {};
+	}
+
+	// Sets out_hits to the hits of batch if its frame is done, and to nullptr otherwise. The hits stay valid until
+	// RAY_QUERY_SLICE_CNT further batches have been recorded, after which batch can no longer be polled.
+	och::status poll_ray_queries(uint64_t batch, const ray_hit_t*& out_hits) noexcept
+	{
+		out_hits = nullptr;
+
+		if (batch == 0 || batch + RAY_QUERY_SLICE_CNT < pending_ray_query_batch)
+			return to_status(och::error::argument_invalid);
+
+		if (batch >= pending_ray_query_batch)
+			return {};
+
+		// A batch no longer held by any frame slot has been waited on before its slot was reused
+		for (uint32_t i = 0; i != MAX_FRAMES_INFLIGHT; ++i)
+			if (frame_ray_query_batches[i] == batch)
+			{
+				const VkResult fence_rst = vkGetFenceStatus(ctx.m_device, frame_inflight_fences[i]);
+
+				if (fence_rst == VK_NOT_READY)
+					return {};
+
+				check(fence_rst);
+			}
+
+		out_hits = ray_hit_data + (batch % RAY_QUERY_SLICE_CNT) * ray_query_capacity;
+
+		return {};
+	}
+
+	// Traces the pending ray query batch, if it holds any rays, and moves on to the next one. Expects the trace descriptor
+	// set to be bound and trace's push constants, with the batch's ray_query_ fields, to be set.
+	void record_ray_queries(VkCommandBuffer command_buffer) noexcept
+	{
+		if (pending_ray_query_cnt != 0)
+		{
+			const uint32_t group_invocation_cnt = trace_group_size[0] * trace_group_size[1];
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, query_pipeline);
+
+			vkCmdDispatch(command_buffer, (pending_ray_query_cnt + group_invocation_cnt - 1) / group_invocation_cnt, 1, 1);
+
+			VkMemoryBarrier hit_barrier{};
+			hit_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			hit_barrier.pNext = nullptr;
+			hit_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			hit_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hit_barrier, 0, nullptr, 0, nullptr);
+		}
+
+		frame_ray_query_batches[frame_idx] = pending_ray_query_batch;
+
+		++pending_ray_query_batch;
+
+		pending_ray_query_cnt = 0;
+	}
+
+	// Moves render_scale_steps towards dynamic_resolution_target_ms, going by the profiled render scope of the frame last
+	// recorded into the current frame slot. Expects that frame's fence to have been waited on.
+	och::status update_render_scale() noexcept
+	{
+		check(ctx.collect_profiler_frame(frame_idx));
+
+		const uint32_t render_scope = ctx.find_profile_scope("render");
+
+		// Nothing has been rendered yet, or the frame was not submitted
+		if (render_scope == ~0u || ctx.m_profiler_sample_cnts[render_scope] == render_scale_sample_cnt)
+			return {};
+
+		render_scale_sample_cnt = ctx.m_profiler_sample_cnts[render_scope];
+
+		const float render_ms = ctx.get_latest_profile_sample(render_scope);
+
+		// Tracing time goes with the number of pixels, and so with the square of the scale
+		float target_steps = render_ms <= 0.0F ? static_cast<float>(RENDER_SCALE_STEPS) : static_cast<float>(render_scale_steps) * sqrtf(dynamic_resolution_target_ms / render_ms);
+
+		if (target_steps > static_cast<float>(RENDER_SCALE_STEPS))
+			target_steps = static_cast<float>(RENDER_SCALE_STEPS);
+		else if (target_steps < static_cast<float>(MIN_RENDER_SCALE_STEPS))
+			target_steps = static_cast<float>(MIN_RENDER_SCALE_STEPS);
+
+		// Going halfway damps the swings caused by the measurements lagging MAX_FRAMES_INFLIGHT frames behind, and
+		// leaving differences of less than a step alone keeps noise from dropping the history every frame
+		render_scale_steps = static_cast<uint32_t>(static_cast<int32_t>(render_scale_steps) + static_cast<int32_t>((target_steps - static_cast<float>(render_scale_steps)) * 0.5F));
+
+		return {};
+	}
+
+	// Dispatches trace with one invocation per pixel, or prepass tile, of extent. With swizzle_groups set, the groups are
+	// dispatched in whole blocks, see trace_invocation in trace_common.glsl.
+	void dispatch_trace_groups(VkCommandBuffer command_buffer, uint32_t extent_x, uint32_t extent_y) const noexcept
+	{
+		const uint32_t group_cnt_x = (extent_x + trace_group_size[0] - 1) / trace_group_size[0];
+
+		const uint32_t group_cnt_y = (extent_y + trace_group_size[1] - 1) / trace_group_size[1];
+
+		if (swizzle_groups)
+		{
+			const uint32_t block_cnt_x = (group_cnt_x + SWIZZLE_BLOCK_DIM - 1) / SWIZZLE_BLOCK_DIM;
+
+			const uint32_t block_cnt_y = (group_cnt_y + SWIZZLE_BLOCK_DIM - 1) / SWIZZLE_BLOCK_DIM;
+
+			vkCmdDispatch(command_buffer, block_cnt_x * SWIZZLE_BLOCK_DIM * SWIZZLE_BLOCK_DIM, block_cnt_y, 1);
+		}
+		else
+		{
+			vkCmdDispatch(command_buffer, group_cnt_x, group_cnt_y, 1);
+		}
+	}
+
+	// Angle between neighbouring rays, which grows as the render extent shrinks so that the view stays the same
+	void get_direction_delta(float out_direction_delta[2]) const noexcept
+	{
+		out_direction_delta[0] = 0.001F * static_cast<float>(ctx.m_swapchain_extent.width) / static_cast<float>(render_extent.width);
+
+		out_direction_delta[1] = 0.001F * static_cast<float>(ctx.m_swapchain_extent.height) / static_cast<float>(render_extent.height);
+	}
+
+	// Clears this frame's reprojected times and, if there is a previous frame, scatters its hit times into them.
+	// Expects the trace descriptor set to be bound, and leaves the push constants to be overwritten by trace's.
+	void record_reprojection(VkCommandBuffer command_buffer, uint32_t swapchain_idx, och::mat3 rotation, och::vec3 position) noexcept
+	{
+		VkClearColorValue clear_value{};
+		clear_value.uint32[0] = 0x7F800000; // Bits of positive infinity
+
+		VkImageSubresourceRange clear_range{};
+		clear_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		clear_range.baseMipLevel = 0;
+		clear_range.levelCount = 1;
+		clear_range.baseArrayLayer = 0;
+		clear_range.layerCount = 1;
+
+		vkCmdClearColorImage(command_buffer, reprojected_time_images[swapchain_idx], VK_IMAGE_LAYOUT_GENERAL, &clear_value, 1, &clear_range);
+
+		VkMemoryBarrier clear_barrier{};
+		clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clear_barrier.pNext = nullptr;
+		clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clear_barrier, 0, nullptr, 0, nullptr);
+
+		if (!is_previous_frame_valid)
+			return;
+
+		// Trace turns camera-space directions d into world-space ones as rotation^T * d, see direction_rotation, so a point p
+		// in the previous camera's space lies at rotation * (previous_rotation^T * p + previous_position - position) in the current one.
+		const float delta[3]{ previous_position.x - position.x, previous_position.y - position.y, previous_position.z - position.z };
+
+		float relative_rotation[3][3];
+
+		float relative_offset[3];
+
+		for (uint32_t i = 0; i != 3; ++i)
+		{
+			for (uint32_t j = 0; j != 3; ++j)
+			{
+				relative_rotation[i][j] = 0.0F;
+
+				for (uint32_t k = 0; k != 3; ++k)
+					relative_rotation[i][j] += rotation(i, k) * previous_rotation[j][k];
+			}
+
+			relative_offset[i] = rotation(i, 0) * delta[0] + rotation(i, 1) * delta[1] + rotation(i, 2) * delta[2];
+		}
+
+		reproject_push_constant_data_t push_data;
+		push_data.relative_rotation[0] = { relative_rotation[0][0], relative_rotation[1][0], relative_rotation[2][0], 0.0F };
+		push_data.relative_rotation[1] = { relative_rotation[0][1], relative_rotation[1][1], relative_rotation[2][1], 0.0F };
+		push_data.relative_rotation[2] = { relative_rotation[0][2], relative_rotation[1][2], relative_rotation[2][2], 0.0F };
+		push_data.relative_offset = { relative_offset[0], relative_offset[1], relative_offset[2], 0.0F };
+		get_direction_delta(push_data.direction_delta);
+		push_data.render_extent[0] = render_extent.width;
+		push_data.render_extent[1] = render_extent.height;
+		push_data.previous_image_index = previous_swapchain_idx;
+
+		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_data), &push_data);
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, reproject_pipeline);
+
+		vkCmdDispatch(command_buffer, (render_extent.width + trace_group_size[0] - 1) / trace_group_size[0], (render_extent.height + trace_group_size[1] - 1) / trace_group_size[1], 1);
+
+		VkMemoryBarrier reproject_barrier{};
+		reproject_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		reproject_barrier.pNext = nullptr;
+		reproject_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		reproject_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reproject_barrier, 0, nullptr, 0, nullptr);
+	}
+
+	och::status record_command_buffer(VkCommandBuffer command_buffer, uint32_t swapchain_idx) noexcept
+	{
+		VkCommandBufferBeginInfo command_buffer_bi{};
+		command_buffer_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		command_buffer_bi.pNext = nullptr;
+		command_buffer_bi.flags = 0;
+		command_buffer_bi.pInheritanceInfo = nullptr;
+
+		check(vkBeginCommandBuffer(command_buffer, &command_buffer_bi));
+
+		check(ctx.begin_profiler_frame(command_buffer, frame_idx));
+
+		uint32_t profile_slot;
+
+		VkImageMemoryBarrier to_general_barrier{};
+		to_general_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		to_general_barrier.pNext = nullptr;
+		to_general_barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		to_general_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		to_general_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		to_general_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		to_general_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		to_general_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		to_general_barrier.image = ctx.m_swapchain_images[swapchain_idx];
+		to_general_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		to_general_barrier.subresourceRange.baseMipLevel = 0;
+		to_general_barrier.subresourceRange.levelCount = 1;
+		to_general_barrier.subresourceRange.baseArrayLayer = 0;
+		to_general_barrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_general_barrier);
+
+		// Only part of the render image is traced at a dynamic resolution, while otherwise all of the swapchain image is
+		const VkExtent2D frame_render_extent{
+			(ctx.m_swapchain_extent.width * render_scale_steps + RENDER_SCALE_STEPS - 1) / RENDER_SCALE_STEPS,
+			(ctx.m_swapchain_extent.height * render_scale_steps + RENDER_SCALE_STEPS - 1) / RENDER_SCALE_STEPS,
+		};
+
+		// The previous frame's pixels no longer line up with this one's
+		if (frame_render_extent.width != render_extent.width || frame_render_extent.height != render_extent.height)
+			is_previous_frame_valid = false;
+
+		render_extent = frame_render_extent;
+
+		och::mat3 rotation = och::mat3::rotate_y(input_rotation.y) * och::mat3::rotate_x(input_rotation.x);
+
+		// While a volume update is in flight, only cells resident under both the old and the new anchor may be traced.
+		// Window bounds are monotonic in the anchor, so that intersection is spanned by the per-axis minimum and maximum anchor.
+		int32_t anchor_min[3];
+
+		int32_t anchor_max[3];
+
+		for (uint32_t a = 0; a != 3; ++a)
+		{
+			const int32_t pending_anchor = is_gen_inflight ? pending_volume_anchor[a] : volume_anchor[a];
+
+			anchor_min[a] = volume_anchor[a] < pending_anchor ? volume_anchor[a] : pending_anchor;
+
+			anchor_max[a] = volume_anchor[a] < pending_anchor ? pending_anchor : volume_anchor[a];
+		}
+
+		// Trace relative to the anchor rounded down to a whole cell of the coarsest level, keeping coordinates small in an unbounded world
+		const float frame_base[3]{
+			static_cast<float>((anchor_min[0] >> level_cnt) << level_cnt),
+			static_cast<float>((anchor_min[1] >> level_cnt) << level_cnt),
+			static_cast<float>((anchor_min[2] >> level_cnt) << level_cnt),
+		};
+
+		push_constant_data_t push_data;
+		push_data.origin = { input_position.x - frame_base[0], input_position.y - frame_base[1], input_position.z - frame_base[2], 0.0F };
+		get_direction_delta(push_data.direction_delta);
+		push_data.render_extent[0] = render_extent.width;
+		push_data.render_extent[1] = render_extent.height;
+		push_data.direction_rotation[0] = { rotation(0, 0), rotation(1, 0), rotation(2, 0), 0.0F };
+		push_data.direction_rotation[1] = { rotation(0, 1), rotation(1, 1), rotation(2, 1), 0.0F };
+		push_data.direction_rotation[2] = { rotation(0, 2), rotation(1, 2), rotation(2, 2), 0.0F };
+		push_data.anchor_min[0] = anchor_min[0];
+		push_data.anchor_min[1] = anchor_min[1];
+		push_data.anchor_min[2] = anchor_min[2];
+		push_data.frame_index = recorded_frame_cnt++;
+		push_data.anchor_max[0] = anchor_max[0];
+		push_data.anchor_max[1] = anchor_max[1];
+		push_data.anchor_max[2] = anchor_max[2];
+		push_data.atlas_dim_log2 = atlas_dim_log2;
+		push_data.previous_image_index = is_previous_frame_valid ? previous_swapchain_idx : NO_PREVIOUS_IMAGE;
+		push_data.ray_query_offset = static_cast<uint32_t>(pending_ray_query_batch % RAY_QUERY_SLICE_CNT) * ray_query_capacity;
+		push_data.ray_query_cnt = pending_ray_query_cnt;
+
+		// Input below only affects the next frame
+		const och::vec3 frame_position = input_position;
+
+		if (ctx.get_keycode(och::vk::arrow_up))
+			input_rotation.x -= input_rotation_delta;
+
+		if (ctx.get_keycode(och::vk::arrow_down))
+			input_rotation.x += input_rotation_delta;
+
+		if (ctx.get_keycode(och::vk::arrow_left))
+			input_rotation.y += input_rotation_delta;
+
+		if (ctx.get_keycode(och::vk::arrow_right))
+			input_rotation.y -= input_rotation_delta;
+
+		if (ctx.get_keycode(och::vk::key_w))
+			input_position += rotation * och::vec3(0.0F, 0.0F, -input_position_delta);
+
+		if (ctx.get_keycode(och::vk::key_s))
+		input_position += rotation * och::vec3(0.0F, 0.0F, input_position_delta);
+
+		if (ctx.get_keycode(och::vk::key_a))
+			input_position += rotation * och::vec3(-input_position_delta, 0.0F, 0.0F);
+
+		if (ctx.get_keycode(och::vk::key_d))
+			input_position += rotation * och::vec3(input_position_delta, 0.0F, 0.0F);
+
+		if (ctx.get_keycode(och::vk::space))
+			input_position += rotation * och::vec3(0.0F, -input_position_delta, 0.0F);
+
+		if (ctx.get_keycode(och::vk::shift))
+			input_position += rotation * och::vec3(0.0F, input_position_delta, 0.0F);
+
+		if (ctx.get_keycode(och::vk::key_x))
+			input_position_delta += 1.0 / 64.0;
+
+		if(ctx.get_keycode(och::vk::key_y))
+			input_position_delta -= 1.0 / 64.0;
+
+		if (ctx.get_keycode(och::vk::key_m))
+			input_rotation_delta += 1.0 / 1024.0;
+
+		if (ctx.get_keycode(och::vk::key_n))
+			input_rotation_delta -= 1.0 / 1024.0;
+
+		if (ctx.get_keycode(och::vk::key_r))
+			input_position = { 0.0, 0.0, 0.0 };
+
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_sets[swapchain_idx], 0, nullptr);
+
+		// Encloses the passes working at the render extent, which update_render_scale goes by
+		uint32_t render_profile_slot;
+
+		check(ctx.begin_profile_scope(command_buffer, frame_idx, "render", render_profile_slot));
+
+		// The previous frame's hit times were written by another submission, which the frame fences do not order against
+		// this one, as they belong to a different frame slot. A barrier covers all earlier commands on the queue though.
+		// Both reproject and variable rate tracing read them.
+		if ((reproject_hits || ray_rate == trace_rate::variable) && is_previous_frame_valid)
+		{
+			VkMemoryBarrier history_barrier{};
+			history_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			history_barrier.pNext = nullptr;
+			history_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			history_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &history_barrier, 0, nullptr, 0, nullptr);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+		}
+
+		if (reproject_hits)
+		{
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "reproject", profile_slot));
+
+			record_reprojection(command_buffer, swapchain_idx, rotation, frame_position);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+		}
+
+		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data_t), &push_data);
+
+		if (depth_prepass)
+		{
+			const uint32_t tile_cnt_x = (render_extent.width + PREPASS_TILE_DIM - 1) / PREPASS_TILE_DIM;
+
+			const uint32_t tile_cnt_y = (render_extent.height + PREPASS_TILE_DIM - 1) / PREPASS_TILE_DIM;
+
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "prepass", profile_slot));
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, prepass_pipeline);
+
+			dispatch_trace_groups(command_buffer, tile_cnt_x, tile_cnt_y);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+
+			VkMemoryBarrier tile_start_barrier{};
+			tile_start_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			tile_start_barrier.pNext = nullptr;
+			tile_start_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			tile_start_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &tile_start_barrier, 0, nullptr, 0, nullptr);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+		}
+
+		check(ctx.begin_profile_scope(command_buffer, frame_idx, "trace", profile_slot));
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+		uint32_t group_cnt_x = (render_extent.width + trace_group_size[0] - 1) / trace_group_size[0];
+
+		uint32_t group_cnt_y = (render_extent.height + trace_group_size[1] - 1) / trace_group_size[1];
+
+		if (persistent_trace)
+		{
+			vkCmdFillBuffer(command_buffer, ray_queue_buffer, 0, VK_WHOLE_SIZE, 0);
+
+			VkMemoryBarrier ray_queue_barrier{};
+			ray_queue_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			ray_queue_barrier.pNext = nullptr;
+			ray_queue_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			ray_queue_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &ray_queue_barrier, 0, nullptr, 0, nullptr);
+
+			vkCmdDispatch(command_buffer, PERSISTENT_GROUP_CNT, 1, 1);
+		}
+		else
+		{
+			dispatch_trace_groups(command_buffer, render_extent.width, render_extent.height);
+		}
+
+		ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+
+		if (ray_rate != trace_rate::full)
+		{
+			VkMemoryBarrier trace_barrier{};
+			trace_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			trace_barrier.pNext = nullptr;
+			trace_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			trace_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &trace_barrier, 0, nullptr, 0, nullptr);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "resolve", profile_slot));
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolve_pipeline);
+
+			vkCmdDispatch(command_buffer, group_cnt_x, group_cnt_y, 1);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+		}
+
+		ctx.end_profile_scope(command_buffer, frame_idx, render_profile_slot);
+
+		if (dynamic_resolution_target_ms != 0.0F)
+		{
+			VkMemoryBarrier render_barrier{};
+			render_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			render_barrier.pNext = nullptr;
+			render_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			render_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "barriers", profile_slot));
+
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &render_barrier, 0, nullptr, 0, nullptr);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+
+			check(ctx.begin_profile_scope(command_buffer, frame_idx, "upscale", profile_slot));
+
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, upscale_pipeline);
+
+			vkCmdDispatch(command_buffer, (ctx.m_swapchain_extent.width + trace_group_size[0] - 1) / trace_group_size[0], (ctx.m_swapchain_extent.height + trace_group_size[1] - 1) / trace_group_size[1], 1);
+
+			ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+		}
+
+		check(ctx.begin_profile_scope(command_buffer, frame_idx, "query", profile_slot));
+
+		record_ray_queries(command_buffer);
+
+		ctx.end_profile_scope(command_buffer, frame_idx, profile_slot);
+
+		for (uint32_t i = 0; i != 3; ++i)
+			for (uint32_t j = 0; j != 3; ++j)
+				previous_rotation[i][j] = rotation(i, j);
+
+		previous_position = frame_position;
+
+		previous_swapchain_idx = swapchain_idx;
+
+		is_previous_frame_valid = true;
+
+		VkImageMemoryBarrier to_present_barrier;
+		to_present_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		to_present_barrier.pNext = nullptr;
+		to_present_barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		to_present_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		to_present_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		to_present_barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		to_present_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		to_present_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		to_present_barrier.image = ctx.m_swapchain_images[swapchain_idx];
+		to_present_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		to_present_barrier.subresourceRange.baseMipLevel = 0;
+		to_present_barrier.subresourceRange.levelCount = 1;
+		to_present_barrier.subresourceRange.baseArrayLayer = 0;
+		to_present_barrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_present_barrier);
+
+		check(vkEndCommandBuffer(command_buffer));
+
+		return {};
+	}
+
+	och::status run() noexcept
+	{
+		check(ctx.begin_message_processing());
+
+		och::time last_report_time = och::time::now();
+
+		uint64_t frames_since_last_report = 0;
+
+		const och::time run_begin_time = och::time::now();
+
+		last_run_frame_cnt = 0;
+
+		const uint32_t trace_scope = ctx.find_profile_scope("trace");
+
+		const uint64_t first_trace_sample = trace_scope == ~0u ? 0 : ctx.m_profiler_sample_cnts[trace_scope];
+
+		// Distance to the surface at the center of the screen, or -1 if there is none, found through a ray query and
+		// shown alongside the FPS
+		float view_distance = -1.0F;
+
+		uint64_t view_query_batch = 0;
+
+		uint32_t view_query_hit = 0;
+
+		uint64_t validation_batch = 0;
+
+		uint32_t validation_first_hit = 0;
+
+		while (!ctx.is_window_closed() && (frame_limit == 0 || last_run_frame_cnt != frame_limit))
+		{
+			check(vkWaitForFences(ctx.m_device, 1, &frame_inflight_fences[frame_idx], VK_FALSE, UINT64_MAX));
+
+			if (dynamic_resolution_target_ms != 0.0F)
+				check(update_render_scale());
+
+			uint32_t swapchain_idx;
+
+			VkResult acquire_rst = vkAcquireNextImageKHR(ctx.m_device, ctx.m_swapchain, UINT64_MAX, image_available_semaphores[frame_idx], nullptr, &swapchain_idx);
+
+			if (acquire_rst == VK_ERROR_OUT_OF_DATE_KHR)
+			{
+				check(recreate_swapchain());
+
+				continue;
+			}
+			else if (acquire_rst != VK_SUBOPTIMAL_KHR)
+				check(acquire_rst);
+
+			if (image_inflight_fences[swapchain_idx] != nullptr)
+				check(vkWaitForFences(ctx.m_device, 1, &image_inflight_fences[swapchain_idx], VK_FALSE, UINT64_MAX));
+
+			image_inflight_fences[swapchain_idx] = frame_inflight_fences[frame_idx];
+
+			// Trace the rays cpu_tracer traced in validate_volume, and compare the hits once they are back
+			if (validation_queries.size() != 0)
+			{
+				const ray_hit_t* validation_gpu_hits = nullptr;
+
+				if (validation_batch == 0)
+					check(enqueue_ray_queries(reinterpret_cast<const ray_query_t*>(validation_queries.data()), validation_queries.size(), validation_batch, validation_first_hit));
+				else
+					check(poll_ray_queries(validation_batch, validation_gpu_hits));
+
+				if (validation_gpu_hits != nullptr)
+				{
+					check(report_validation_hits(validation_gpu_hits + validation_first_hit));
+
+					validation_queries.deallocate();
+
+					validation_hits.deallocate();
+				}
+			}
+
+			// Stream in the cells that scrolled into view, one update at a time, on the compute queue. Held off while the
+			// validation rays are pending, as they must see the volume cpu_tracer traced them through.
+			{
+				check(poll_volume_update());
+
+				const int32_t camera_anchor[3]{
+					static_cast<int32_t>(floorf(input_position.x)),
+					static_cast<int32_t>(floorf(input_position.y)),
+					static_cast<int32_t>(floorf(input_position.z)),
+				};
+
+				if (!is_gen_inflight && validation_queries.size() == 0 && (camera_anchor[0] != volume_anchor[0] || camera_anchor[1] != volume_anchor[1] || camera_anchor[2] != volume_anchor[2]))
+					check(begin_volume_update(camera_anchor));
+			}
+
+			{
+				const ray_hit_t* view_hits = nullptr;
+
+				if (view_query_batch != 0)
+					check(poll_ray_queries(view_query_batch, view_hits));
+
+				if (view_hits != nullptr)
+				{
+					view_distance = view_hits[view_query_hit].face == RAY_HIT_MISS ? -1.0F : view_hits[view_query_hit].time;
+
+					view_query_batch = 0;
+				}
+
+				if (view_query_batch == 0)
+				{
+					och::mat3 rotation = och::mat3::rotate_y(input_rotation.y) * och::mat3::rotate_x(input_rotation.x);
+
+					// The center ray's direction, which trace computes as rotation^T * (0, 0, -1)
+					const ray_query_t view_query{
+						{ input_position.x, input_position.y, input_position.z },
+						INFINITY,
+						{ -rotation(2, 0), -rotation(2, 1), -rotation(2, 2) },
+						0,
+					};
+
+					check(enqueue_ray_queries(&view_query, 1, view_query_batch, view_query_hit));
+				}
+			}
+
+			check(record_command_buffer(command_buffers[frame_idx], swapchain_idx));
+
+			VkSemaphore wait_semaphores[2]{ image_available_semaphores[frame_idx], gen_complete_semaphore };
+
+			VkPipelineStageFlags wait_stages[2]{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+
+			VkSemaphore signal_semaphores[2]{ render_complete_semaphores[frame_idx], gen_start_semaphore };
+
+			VkSubmitInfo submit_info{};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.pNext = nullptr;
+			submit_info.waitSemaphoreCount = is_gen_complete_wait_pending ? 2 : 1;
+			submit_info.pWaitSemaphores = wait_semaphores;
+			submit_info.pWaitDstStageMask = wait_stages;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &command_buffers[frame_idx];
+			submit_info.signalSemaphoreCount = is_gen_submit_pending ? 2 : 1;
+			submit_info.pSignalSemaphores = signal_semaphores;
+
+			check(vkResetFences(ctx.m_device, 1, &frame_inflight_fences[frame_idx]));
+
+			check(vkQueueSubmit(ctx.m_general_queues[0], 1, &submit_info, frame_inflight_fences[frame_idx]));
+
+			is_gen_complete_wait_pending = false;
+
+			// The frame just submitted already traces the shrunk window, and its signal covers all earlier frames on the queue
+			if (is_gen_submit_pending)
+				check(submit_volume_update());
+
+			VkPresentInfoKHR present_info{};
+			present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			present_info.pNext = nullptr;
+			present_info.waitSemaphoreCount = 1;
+			present_info.pWaitSemaphores = &render_complete_semaphores[frame_idx];
+			present_info.swapchainCount = 1;
+			present_info.pSwapchains = &ctx.m_swapchain;
+			present_info.pImageIndices = &swapchain_idx;
+			present_info.pResults = nullptr;
+
+			VkResult present_rst = vkQueuePresentKHR(ctx.m_general_queues[0], &present_info);
+
+			if (present_rst == VK_ERROR_OUT_OF_DATE_KHR || present_rst == VK_SUBOPTIMAL_KHR || ctx.is_framebuffer_resized())
+			{
+				ctx.m_flags.framebuffer_resized.store(false, std::memory_order::memory_order_release);
+
+				recreate_swapchain();
+			}
+			else
+				check(present_rst);
+
+			frame_idx = (frame_idx + 1) % MAX_FRAMES_INFLIGHT;
+
+			++last_run_frame_cnt;
+
+			// FPS counter
+			{
+				++frames_since_last_report;
+
+				och::time now = och::time::now();
+
+				och::timespan elapsed_time = (now - last_report_time);
+
+				uint64_t elapsed_ms = elapsed_time.milliseconds();
+
+				if (elapsed_ms > 1000)
+				{
+					char fps_buf[1024];
+
+					och::sprint(fps_buf, "    (FPS: {}  x: {:.2}  y: {:.2}  z: {:.2}  view: {:.2}  render: {}x{})", (frames_since_last_report * 1000) / (elapsed_ms + 1), input_position.x, input_position.y, input_position.z, view_distance, render_extent.width, render_extent.height);
+
+					check(ctx.set_window_note(fps_buf));
+
+					frames_since_last_report = 0;
+
+					last_report_time = now;
+				}
+			}
+		}
+
+		// Let the last frames finish, so that they are included in the measured time
+		check(vkDeviceWaitIdle(ctx.m_device));
+
+		last_run_ms = (och::time::now() - run_begin_time).milliseconds();
+
+		for (uint32_t i = 0; i != ctx.m_profiler_frame_cnt; ++i)
+			check(ctx.collect_profiler_frame(i));
+
+		last_trace_gpu_ms = ctx.get_profile_statistics(ctx.find_profile_scope("trace"), first_trace_sample).avg_ms;
+
+		if (profile_path != nullptr)
+			check(write_profile());
+
+		return {};
+	}
+
+	// Prints the statistics of every profiled pass and writes them to profile_path. All profiler frames must have been collected.
+	och::status write_profile() noexcept
+	{
+		och::print("\npass            samples  |  min ms  avg ms  p99 ms\n");
+
+		for (uint32_t s = 0; s != ctx.m_profiler_scope_cnt; ++s)
+		{
+			const vulkan_context::profile_statistics statistics = ctx.get_profile_statistics(s);
+
+			const char* name = ctx.m_profiler_scope_names[s];
+
+			och::print("{:14}  {:7}  |  {:.4}  {:.4}  {:.4}\n", name, statistics.sample_cnt, statistics.min_ms, statistics.avg_ms, statistics.p99_ms);
+		}
+
+		check(ctx.write_profile(profile_path));
+
+		och::print("\nWrote profile to {}\n", profile_path);
+
+		return {};
+	}
+
+	// Takes over the volume and tracing settings of config, for benchmark runs comparing variations of one configuration.
+	// Validation, volume files, profiling and dynamic resolution are left out, as they would interfere with the measurements.
+	void copy_config(const voxel_volume& config) noexcept
+	{
+		brick_fmt = config.brick_fmt;
+
+		voxel_layout = config.voxel_layout;
+
+		atlas_bricks = config.atlas_bricks;
+
+		level_cnt = config.level_cnt;
+
+		base_dim_log2 = config.base_dim_log2;
+
+		brick_dim_log2 = config.brick_dim_log2;
+
+		for (uint32_t i = 0; i != 3; ++i)
+		{
+			checkempty_group_size[i] = config.checkempty_group_size[i];
+
+			assignindex_group_size[i] = config.assignindex_group_size[i];
+		}
+
+		gen_offset = config.gen_offset;
+
+		gen_scale = config.gen_scale;
+
+		gen_cutoff = config.gen_cutoff;
+
+		cpu_thread_cnt = config.cpu_thread_cnt;
+
+		for (uint32_t i = 0; i != 2; ++i)
+			trace_group_size[i] = config.trace_group_size[i];
+
+		depth_prepass = config.depth_prepass;
+
+		reproject_hits = config.reproject_hits;
+
+		ray_rate = config.ray_rate;
+
+		persistent_trace = config.persistent_trace;
+
+		swizzle_groups = config.swizzle_groups;
+
+		ray_query_capacity = config.ray_query_capacity;
+
+		input_rotation = config.input_rotation;
+
+		input_position = config.input_position;
+	}
+
+	// Bytes of device memory allocated for the base image, brick and leaf pools and brick atlas, and how many of them are in use
+	void get_memory_usage(uint64_t& out_allocated_bytes, uint64_t& out_used_bytes) const noexcept
+	{
+		const uint64_t base_bytes = base_vol * level_cnt * sizeof(base_elem_t);
+
+		const uint32_t used_brick_cnt = brick_pool_data->allocated_cnt - brick_pool_data->free_cnt;
+
+		out_allocated_bytes = base_bytes + brick_bytes(brick_capacity) + (brick_fmt == brick_format::leaf ? leaf_bytes(leaf_capacity) : 0) + (atlas_bricks ? brick_capacity * brick_vol : 0);
+
+		out_used_bytes = base_bytes + brick_bytes(used_brick_cnt) + (brick_fmt == brick_format::leaf ? leaf_bytes(brick_pool_data->leaf_allocated_cnt - brick_pool_data->leaf_free_cnt) : 0) + (atlas_bricks ? used_brick_cnt * brick_vol : 0);
+	}
+};
+
+// Parses exactly cnt comma-separated positive integers
+static bool parse_uint_list(const char* str, uint32_t* out, uint32_t cnt) noexcept
+{
+	for (uint32_t i = 0; i != cnt; ++i)
+	{
+		// strtoul would also take leading whitespace and signs
+		if (*str < '0' || *str > '9')
+			return false;
+
+		char* end;
+
+		errno = 0;
+
+		const unsigned long value = strtoul(str, &end, 10);
+
+		if (errno == ERANGE || value == 0 || value > UINT32_MAX)
+			return false;
+
+		out[i] = static_cast<uint32_t>(value);
+
+		if (*end != (i + 1 == cnt ? '\0' : ','))
+			return false;
+
+		str = end + 1;
+	}
+
+	return true;
+}
+
+// Parses a single finite positive number
+static bool parse_positive_float(const char* str, float* out) noexcept
+{
+	if ((*str < '0' || *str > '9') && *str != '.')
+		return false;
+
+	char* end;
+
+	errno = 0;
+
+	const float value = strtof(str, &end);
+
+	if (end == str || *end != '\0' || errno == ERANGE || !std::isfinite(value) || value <= 0.0F)
+		return false;
+
+	*out = value;
+
+	return true;
+}
+
+// Builds and traces the volume for every combination of the geometry parameters not given on the command line and
+// prints generation time, memory use and trace time for each, followed by the configurations ranked by trace time.
+// Both times are GPU times taken from the profiler, so that they are not skewed by the host or by presentation.
+static och::status autotune_voxel_volume(const voxel_volume& base_config, bool is_level_cnt_set, bool is_base_dim_set, bool is_brick_dim_set, bool is_trace_group_set, bool is_gen_group_set, uint64_t frame_cnt) noexcept
+{
+	const uint64_t level_cnt_options[]{ 4, 5, 6 };
+
+	const uint64_t base_dim_log2_options[]{ 5, 6, 7 };
+
+	const uint64_t brick_dim_log2_options[]{ 3, 4, 5 };
+
+	const uint32_t trace_group_options[][2]{ { 8, 8 }, { 16, 16 } };
+
+	const uint32_t gen_group_options[][3]{ { 4, 4, 4 }, { 8, 8, 1 } };
+
+	const uint32_t level_cnt_option_cnt = is_level_cnt_set ? 1 : _countof(level_cnt_options);
+
+	const uint32_t base_dim_option_cnt = is_base_dim_set ? 1 : _countof(base_dim_log2_options);
+
+	const uint32_t brick_dim_option_cnt = is_brick_dim_set ? 1 : _countof(brick_dim_log2_options);
+
+	const uint32_t trace_group_option_cnt = is_trace_group_set ? 1 : _countof(trace_group_options);
+
+	const uint32_t gen_group_option_cnt = is_gen_group_set ? 1 : _countof(gen_group_options);
+
+	och::print("Autotuning {} configurations over {} frames each\n\n", level_cnt_option_cnt * base_dim_option_cnt * brick_dim_option_cnt * trace_group_option_cnt * gen_group_option_cnt, frame_cnt);
+
+	struct autotune_result
+	{
+		uint32_t level_cnt;
+
+		uint32_t base_dim;
+
+		uint32_t brick_dim;
+
+		uint32_t trace_group_size[2];
+
+		uint32_t gen_group_size[3];
+
+		float build_gpu_ms;
+
+		float trace_gpu_ms;
+	};
+
+	autotune_result results[_countof(level_cnt_options) * _countof(base_dim_log2_options) * _countof(brick_dim_log2_options) * _countof(trace_group_options) * _countof(gen_group_options)];
+
+	uint32_t result_cnt = 0;
+
+	och::print("levels  base  brick  trace   generation  |  build ms  alloc MB  used MB  trace ms\n");
+
+	for (uint32_t l = 0; l != level_cnt_option_cnt; ++l)
+		for (uint32_t b = 0; b != base_dim_option_cnt; ++b)
+			for (uint32_t r = 0; r != brick_dim_option_cnt; ++r)
+				for (uint32_t t = 0; t != trace_group_option_cnt; ++t)
+					for (uint32_t g = 0; g != gen_group_option_cnt; ++g)
+					{
+						voxel_volume program;
+
+						program.copy_config(base_config);
+
+						program.frame_limit = frame_cnt;
+
+						program.measure_gpu_times = true;
+
+						if (!is_level_cnt_set)
+							program.level_cnt = level_cnt_options[l];
+
+						if (!is_base_dim_set)
+							program.base_dim_log2 = base_dim_log2_options[b];
+
+						if (!is_brick_dim_set)
+							program.brick_dim_log2 = brick_dim_log2_options[r];
+
+						if (!is_trace_group_set)
+						{
+							for (uint32_t i = 0; i != 2; ++i)
+								program.trace_group_size[i] = trace_group_options[t][i];
+						}
+
+						if (!is_gen_group_set)
+						{
+							for (uint32_t i = 0; i != 3; ++i)
+							{
+								program.checkempty_group_size[i] = gen_group_options[g][i];
+
+								program.assignindex_group_size[i] = gen_group_options[g][i];
+							}
+						}
+
+						och::print("{:6}  {:4}  {:5}  {:2}x{}  {:4}x{}x{}  |  ",
+							program.level_cnt, 1 << program.base_dim_log2, 1 << program.brick_dim_log2,
+							program.trace_group_size[0], program.trace_group_size[1],
+							program.checkempty_group_size[0], program.checkempty_group_size[1], program.checkempty_group_size[2]);
+
+						// A configuration that is invalid or does not fit onto the device must not end the sweep
+						och::status err = program.create();
+
+						if (!err)
+							err = program.run();
+
+						if (!err)
+						{
+							uint64_t allocated_bytes;
+
+							uint64_t used_bytes;
+
+							program.get_memory_usage(allocated_bytes, used_bytes);
+
+							och::print("{:.3}  {:8}  {:7}  {:.3}\n", program.last_build_gpu_ms, allocated_bytes / (1024 * 1024), used_bytes / (1024 * 1024), program.last_trace_gpu_ms);
+
+							autotune_result& result = results[result_cnt];
+
+							result.level_cnt = static_cast<uint32_t>(program.level_cnt);
+
+							result.base_dim = 1u << program.base_dim_log2;
+
+							result.brick_dim = 1u << program.brick_dim_log2;
+
+							for (uint32_t i = 0; i != 2; ++i)
+								result.trace_group_size[i] = program.trace_group_size[i];
+
+							for (uint32_t i = 0; i != 3; ++i)
+								result.gen_group_size[i] = program.checkempty_group_size[i];
+
+							result.build_gpu_ms = program.last_build_gpu_ms;
+
+							result.trace_gpu_ms = program.last_trace_gpu_ms;
+
+							// Insertion sort by trace time, which is plenty for the ~100 configurations swept
+							uint32_t j = result_cnt;
+
+							while (j != 0 && results[j - 1].trace_gpu_ms > result.trace_gpu_ms)
+							{
+								const autotune_result tmp = results[j - 1];
+
+								results[j - 1] = results[j];
+
+								results[j] = tmp;
+
+								--j;
+							}
+
+							++result_cnt;
+						}
+						else
+						{
+							och::print("failed\n");
+						}
+
+						program.destroy();
+					}
+
+	och::print("\nRanked by trace time:\n\nrank  levels  base  brick  trace   generation  |  trace ms  build ms\n");
+
+	for (uint32_t i = 0; i != result_cnt; ++i)
+	{
+		const autotune_result& result = results[i];
+
+		och::print("{:4}  {:6}  {:4}  {:5}  {:2}x{}  {:4}x{}x{}  |  {:.3}  {:.3}\n",
+			i + 1, result.level_cnt, result.base_dim, result.brick_dim,
+			result.trace_group_size[0], result.trace_group_size[1],
+			result.gen_group_size[0], result.gen_group_size[1], result.gen_group_size[2],
+			result.trace_gpu_ms, result.build_gpu_ms);
+	}
+
+	return {};
+}
+
+// Traces the same volume with each brick layout, looking along all six axis directions, and prints how many brick
+// reads and distinct 64-byte lines each ray touches on average, as counted by trace over one ray in 16, along with
+// the GPU time of the trace pass. Line counts stand in for memory transactions, which cannot be queried portably.
+static och::status benchmark_brick_layouts(const voxel_volume& base_config, uint64_t frame_cnt) noexcept
+{
+	const brick_layout layouts[]{ brick_layout::linear, brick_layout::morton };
+
+	const char* const layout_names[]{ "linear", "morton" };
+
+	constexpr float PI = 3.14159265F;
+
+	// input_rotation is applied as rotate_y(y) * rotate_x(x)
+	const och::vec3 directions[]{
+		{ 0.0F, 0.0F, 0.0F },
+		{ 0.0F, PI, 0.0F },
+		{ 0.0F, PI * 0.5F, 0.0F },
+		{ 0.0F, -PI * 0.5F, 0.0F },
+		{ PI * 0.5F, 0.0F, 0.0F },
+		{ -PI * 0.5F, 0.0F, 0.0F },
+	};
+
+	const char* const direction_names[]{ "+z", "-z", "+x", "-x", "-y", "+y" };
+
+	och::print("Benchmarking brick layouts over {} frames per direction\n\n", frame_cnt);
+
+	och::print("layout  dir  |  reads/ray  lines/ray  trace ms\n");
+
+	for (uint32_t l = 0; l != _countof(layouts); ++l)
+	{
+		voxel_volume program;
+
+		program.copy_config(base_config);
+
+		program.voxel_layout = layouts[l];
 
-			check(vkCreateCommandPool(ctx.m_device, &command_pool_ci, nullptr, &command_pool));
+		program.count_brick_lines = true;
 
-			VkCommandBufferAllocateInfo command_buffer_ai{};
-			command_buffer_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-			command_buffer_ai.pNext = nullptr;
-			command_buffer_ai.commandPool = command_pool;
-			command_buffer_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			command_buffer_ai.commandBufferCount = MAX_FRAMES_INFLIGHT;
+		program.frame_limit = frame_cnt;
 
-			check(vkAllocateCommandBuffers(ctx.m_device, &command_buffer_ai, command_buffers));
-		}
+		program.measure_gpu_times = true;
 
-		// Create sync resources
+		och::status err = program.create();
+
+		for (uint32_t d = 0; !err && d != _countof(directions); ++d)
 		{
-			VkSemaphoreCreateInfo semaphore_ci{};
-			semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-			semaphore_ci.pNext = nullptr;
-			semaphore_ci.flags = 0;
+			program.input_rotation = directions[d];
 
-			VkFenceCreateInfo fence_ci{};
-			fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-			fence_ci.pNext = nullptr;
-			fence_ci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			*program.trace_stats_data = {};
 
-			for (uint32_t i = 0; i != MAX_FRAMES_INFLIGHT; ++i)
-			{
-				check(vkCreateSemaphore(ctx.m_device, &semaphore_ci, nullptr, &image_available_semaphores[i]));
+			err = program.run();
 
-				check(vkCreateSemaphore(ctx.m_device, &semaphore_ci, nullptr, &render_complete_semaphores[i]));
+			if (err)
+				break;
 
-				check(vkCreateFence(ctx.m_device, &fence_ci, nullptr, &frame_inflight_fences[i]));
-			}
+			const voxel_volume::trace_stats_data_t stats = *program.trace_stats_data;
+
+			const float ray_cnt = stats.ray_cnt != 0 ? static_cast<float>(stats.ray_cnt) : 1.0F;
+
+			och::print("{:6}  {:3}  |  {:.3}  {:.3}  {:.3}\n", layout_names[l], direction_names[d], static_cast<float>(stats.brick_read_cnt) / ray_cnt, static_cast<float>(stats.brick_line_cnt) / ray_cnt, program.last_trace_gpu_ms);
 		}
 
-		check(temp_populate_bricks());
+		program.destroy();
 
-		return {};
+		check(err);
 	}
 
-	void destroy() noexcept
-	{
-		if (ctx.m_device == nullptr)
-			return;
+	return {};
+}
 
-		if (vkDeviceWaitIdle(ctx.m_device) != VK_SUCCESS)
-			return;
+// Compares the SIMD utilisation and GPU trace time of the per-pixel and the persistent tracer, over the given number of frames each
+static och::status benchmark_tracers(const voxel_volume& base_config, uint64_t frame_cnt) noexcept
+{
+	const bool tracers[]{ false, true };
 
-		for (uint32_t i = 0; i != MAX_FRAMES_INFLIGHT; ++i)
-		{
-			vkDestroySemaphore(ctx.m_device, image_available_semaphores[i], nullptr);
+	const char* const tracer_names[]{ "pixel", "persistent" };
 
-			vkDestroySemaphore(ctx.m_device, render_complete_semaphores[i], nullptr);
+	if (base_config.ray_rate == trace_rate::variable)
+	{
+		och::print("The persistent tracer does not support --trace-rate=variable\n");
 
-			vkDestroyFence(ctx.m_device, frame_inflight_fences[i], nullptr);
-		}
+		return to_status(och::error::argument_invalid);
+	}
 
-		vkDestroyPipeline(ctx.m_device, pipeline, nullptr);
+	och::print("Benchmarking tracers over {} frames each\n\n", frame_cnt);
 
-		vkDestroyPipelineLayout(ctx.m_device, pipeline_layout, nullptr);
+	och::print("tracer      |  SIMD util %  steps/frame  trace ms\n");
 
-		vkDestroyDescriptorSetLayout(ctx.m_device, descriptor_set_layout, nullptr);
+	for (uint32_t t = 0; t != _countof(tracers); ++t)
+	{
+		voxel_volume program;
 
-		vkDestroyShaderModule(ctx.m_device, trace_shader_module, nullptr);
+		program.copy_config(base_config);
 
+		program.persistent_trace = tracers[t];
 
+		program.count_lane_steps = true;
 
-		vkDestroyDescriptorPool(ctx.m_device, descriptor_pool, nullptr);
+		program.frame_limit = frame_cnt;
 
-		vkDestroyCommandPool(ctx.m_device, command_pool, nullptr);
+		program.measure_gpu_times = true;
 
+		och::status err = program.create();
 
+		if (!err)
+			err = program.run();
 
-		for (uint32_t i = 0; i != ctx.m_swapchain_image_cnt; ++i)
+		if (!err)
 		{
-			vkDestroyImageView(ctx.m_device, hit_times_image_views[i], nullptr);
-		
-			vkDestroyImage(ctx.m_device, hit_times_images[i], nullptr);
+			const voxel_volume::trace_stats_data_t stats = *program.trace_stats_data;
 
-			// vkDestroyImageView(ctx.m_device, hit_index_image_views[i], nullptr);
+			const uint64_t lane_step_cnt = (static_cast<uint64_t>(stats.lane_step_cnt_high) << 32) | stats.lane_step_cnt_low;
 
-			// vkDestroyImage(ctx.m_device, hit_index_images[i], nullptr);
-		}
+			const uint64_t active_lane_step_cnt = (static_cast<uint64_t>(stats.active_lane_step_cnt_high) << 32) | stats.active_lane_step_cnt_low;
 
-		vkFreeMemory(ctx.m_device, hit_times_memory, nullptr);
+			const uint64_t measured_frame_cnt = program.last_run_frame_cnt != 0 ? program.last_run_frame_cnt : 1;
 
-		// vkFreeMemory(ctx.m_device, hit_index_memory, nullptr);
+			const float utilisation = lane_step_cnt != 0 ? static_cast<float>(active_lane_step_cnt) * 100.0F / static_cast<float>(lane_step_cnt) : 0.0F;
 
+			och::print("{:10}  |  {:.3}  {}  {:.3}\n", tracer_names[t], utilisation, active_lane_step_cnt / measured_frame_cnt, program.last_trace_gpu_ms);
+		}
 
+		program.destroy();
 
-		vkDestroyImageView(ctx.m_device, base_image_view, nullptr);
+		check(err);
+	}
 
-		vkDestroyImage(ctx.m_device, base_image, nullptr);
+	return {};
+}
 
-		vkFreeMemory(ctx.m_device, base_image_memory, nullptr);
+// Traces with every combination of workgroup shape and group order. Hit rates of the GPU's caches are not exposed through
+// Vulkan, so their effect shows up in the GPU trace time, with SIMD utilisation telling it apart from the divergence that
+// wider or flatter groups bring along.
+static och::status benchmark_dispatch(const voxel_volume& base_config, uint64_t frame_cnt) noexcept
+{
+	const uint32_t group_shapes[][2]{ { 8, 8 }, { 16, 4 }, { 32, 2 } };
 
-		vkDestroyBuffer(ctx.m_device, brick_buffer, nullptr);
+	const bool orders[]{ false, true };
 
-		vkFreeMemory(ctx.m_device, brick_memory, nullptr);
+	const char* const order_names[]{ "raster", "swizzled" };
 
-		vkDestroyBuffer(ctx.m_device, leaf_buffer, nullptr);
+	och::print("Benchmarking trace dispatch over {} frames each\n\n", frame_cnt);
 
-		vkFreeMemory(ctx.m_device, leaf_memory, nullptr);
+	och::print("group  order     |  SIMD util %  trace ms\n");
 
+	for (uint32_t g = 0; g != _countof(group_shapes); ++g)
+		for (uint32_t o = 0; o != _countof(orders); ++o)
+		{
+			voxel_volume program;
 
+			program.copy_config(base_config);
 
-		ctx.destroy();
-	}
+			for (uint32_t i = 0; i != 2; ++i)
+				program.trace_group_size[i] = group_shapes[g][i];
 
-	och::status record_command_buffer(VkCommandBuffer command_buffer, uint32_t swapchain_idx) noexcept
-	{
-		VkCommandBufferBeginInfo command_buffer_bi{};
-		command_buffer_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		command_buffer_bi.pNext = nullptr;
-		command_buffer_bi.flags = 0;
-		command_buffer_bi.pInheritanceInfo = nullptr;
+			program.swizzle_groups = orders[o];
 
-		check(vkBeginCommandBuffer(command_buffer, &command_buffer_bi));
+			program.count_lane_steps = true;
 
-		VkImageMemoryBarrier to_general_barrier{};
-		to_general_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		to_general_barrier.pNext = nullptr;
-		to_general_barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
-		to_general_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
-		to_general_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		to_general_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-		to_general_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		to_general_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		to_general_barrier.image = ctx.m_swapchain_images[swapchain_idx];
-		to_general_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		to_general_barrier.subresourceRange.baseMipLevel = 0;
-		to_general_barrier.subresourceRange.levelCount = 1;
-		to_general_barrier.subresourceRange.baseArrayLayer = 0;
-		to_general_barrier.subresourceRange.layerCount = 1;
+			program.frame_limit = frame_cnt;
 
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_general_barrier);
+			program.measure_gpu_times = true;
 
-		och::mat3 rotation = och::mat3::rotate_y(input_rotation.y) * och::mat3::rotate_x(input_rotation.x);
+			och::status err = program.create();
 
-		push_constant_data_t push_data;
-		push_data.origin = { input_position.x, input_position.y, input_position.z, 0.0F };
-		push_data.direction_delta = { 0.001F, 0.001F, 0.0F, 0.0F };
-		push_data.direction_rotation[0] = { rotation(0, 0), rotation(1, 0), rotation(2, 0), 0.0F };
-		push_data.direction_rotation[1] = { rotation(0, 1), rotation(1, 1), rotation(2, 1), 0.0F };
-		push_data.direction_rotation[2] = { rotation(0, 2), rotation(1, 2), rotation(2, 2), 0.0F };
+			if (!err)
+				err = program.run();
 
-		if (ctx.get_keycode(och::vk::arrow_up))
-			input_rotation.x -= input_rotation_delta;
+			if (!err)
+			{
+				const voxel_volume::trace_stats_data_t stats = *program.trace_stats_data;
 
-		if (ctx.get_keycode(och::vk::arrow_down))
-			input_rotation.x += input_rotation_delta;
+				const uint64_t lane_step_cnt = (static_cast<uint64_t>(stats.lane_step_cnt_high) << 32) | stats.lane_step_cnt_low;
 
-		if (ctx.get_keycode(och::vk::arrow_left))
-			input_rotation.y += input_rotation_delta;
+				const uint64_t active_lane_step_cnt = (static_cast<uint64_t>(stats.active_lane_step_cnt_high) << 32) | stats.active_lane_step_cnt_low;
 
-		if (ctx.get_keycode(och::vk::arrow_right))
-			input_rotation.y -= input_rotation_delta;
+				const float utilisation = lane_step_cnt != 0 ? static_cast<float>(active_lane_step_cnt) * 100.0F / static_cast<float>(lane_step_cnt) : 0.0F;
 
-		if (ctx.get_keycode(och::vk::key_w))
-			input_position += rotation * och::vec3(0.0F, 0.0F, -input_position_delta);
+				och::print("{:2}x{:<2}  {:8}  |  {:.3}  {:.3}\n", group_shapes[g][0], group_shapes[g][1], order_names[o], utilisation, program.last_trace_gpu_ms);
+			}
 
-		if (ctx.get_keycode(och::vk::key_s))
-		input_position += rotation * och::vec3(0.0F, 0.0F, input_position_delta);
+			program.destroy();
 
-		if (ctx.get_keycode(och::vk::key_a))
-			input_position += rotation * och::vec3(-input_position_delta, 0.0F, 0.0F);
+			check(err);
+		}
 
-		if (ctx.get_keycode(och::vk::key_d))
-			input_position += rotation * och::vec3(input_position_delta, 0.0F, 0.0F);
+	return {};
+}
 
-		if (ctx.get_keycode(och::vk::space))
-			input_position += rotation * och::vec3(0.0F, -input_position_delta, 0.0F);
+och::status run_voxel_volume(int argc, const char** argv) noexcept
+{
+	voxel_volume program;
 
-		if (ctx.get_keycode(och::vk::shift))
-			input_position += rotation * och::vec3(0.0F, input_position_delta, 0.0F);
+	bool is_cpu_build_only = false;
 
-		if (ctx.get_keycode(och::vk::key_x))
-			input_position_delta += 1.0 / 64.0;
+	bool is_autotune = false;
 
-		if(ctx.get_keycode(och::vk::key_y))
-			input_position_delta -= 1.0 / 64.0;
+	uint64_t autotune_frame_cnt = 256;
 
-		if (ctx.get_keycode(och::vk::key_m))
-			input_rotation_delta += 1.0 / 1024.0;
+	bool is_layout_benchmark = false;
 
-		if (ctx.get_keycode(och::vk::key_n))
-			input_rotation_delta -= 1.0 / 1024.0;
+	uint64_t layout_benchmark_frame_cnt = 256;
 
-		if (ctx.get_keycode(och::vk::key_r))
-			input_position = { 0.0, 0.0, 0.0 };
+	bool is_tracer_benchmark = false;
 
-		vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant_data_t), &push_data);
+	uint64_t tracer_benchmark_frame_cnt = 256;
 
-		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_sets[swapchain_idx], 0, nullptr);
+	bool is_dispatch_benchmark = false;
 
-		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	uint64_t dispatch_benchmark_frame_cnt = 256;
 
-		uint32_t group_cnt_x = (ctx.m_swapchain_extent.width + TRACE_GROUP_SIZE_X - 1) / TRACE_GROUP_SIZE_X;
+	bool is_level_cnt_set = false;
 
-		uint32_t group_cnt_y = (ctx.m_swapchain_extent.height + TRACE_GROUP_SIZE_Y - 1) / TRACE_GROUP_SIZE_Y;
+	bool is_base_dim_set = false;
 
-		vkCmdDispatch(command_buffer, group_cnt_x, group_cnt_y, 1);
+	bool is_brick_dim_set = false;
 
-		VkImageMemoryBarrier to_present_barrier;
-		to_present_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		to_present_barrier.pNext = nullptr;
-		to_present_barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
-		to_present_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
-		to_present_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-		to_present_barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		to_present_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		to_present_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		to_present_barrier.image = ctx.m_swapchain_images[swapchain_idx];
-		to_present_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		to_present_barrier.subresourceRange.baseMipLevel = 0;
-		to_present_barrier.subresourceRange.levelCount = 1;
-		to_present_barrier.subresourceRange.baseArrayLayer = 0;
-		to_present_barrier.subresourceRange.layerCount = 1;
+	bool is_trace_group_set = false;
 
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_present_barrier);
+	bool is_gen_group_set = false;
 
-		check(vkEndCommandBuffer(command_buffer));
+	// Parsed values of numeric arguments
+	uint32_t uint_arg;
 
-		return {};
-	}
+	float float_arg;
 
-	och::status run() noexcept
+	for (int i = 1; i < argc; ++i)
 	{
-		check(ctx.begin_message_processing());
-
-		och::time last_report_time = och::time::now();
-
-		uint64_t frames_since_last_report = 0;
-
-		while (!ctx.is_window_closed())
+		if (!strcmp(argv[i], "--brick-format=u16"))
+			program.brick_fmt = brick_format::u16;
+		else if (!strcmp(argv[i], "--brick-format=bitpacked"))
+			program.brick_fmt = brick_format::bitpacked;
+		else if (!strcmp(argv[i], "--brick-format=leaf"))
+			program.brick_fmt = brick_format::leaf;
+		else if (!strcmp(argv[i], "--brick-layout=linear"))
+			program.voxel_layout = brick_layout::linear;
+		else if (!strcmp(argv[i], "--brick-layout=morton"))
+			program.voxel_layout = brick_layout::morton;
+		else if (!strcmp(argv[i], "--brick-storage=buffer"))
+			program.atlas_bricks = false;
+		else if (!strcmp(argv[i], "--brick-storage=atlas"))
+			program.atlas_bricks = true;
+		else if (!strcmp(argv[i], "--depth-prepass"))
+			program.depth_prepass = true;
+		else if (!strcmp(argv[i], "--reproject"))
+			program.reproject_hits = true;
+		else if (!strcmp(argv[i], "--tracer=pixel"))
+			program.persistent_trace = false;
+		else if (!strcmp(argv[i], "--tracer=persistent"))
+			program.persistent_trace = true;
+		else if (!strcmp(argv[i], "--trace-rate=full"))
+			program.ray_rate = trace_rate::full;
+		else if (!strcmp(argv[i], "--trace-rate=checkerboard"))
+			program.ray_rate = trace_rate::checkerboard;
+		else if (!strcmp(argv[i], "--trace-rate=variable"))
+			program.ray_rate = trace_rate::variable;
+		else if (!strcmp(argv[i], "--cpu-build"))
+			is_cpu_build_only = true;
+		else if (!strcmp(argv[i], "--validate"))
+			program.validate_build = true;
+		else if (!strncmp(argv[i], "--ray-query-capacity=", 21) && parse_uint_list(argv[i] + 21, &uint_arg, 1))
+			program.ray_query_capacity = uint_arg;
+		else if (!strcmp(argv[i], "--group-order=raster"))
+			program.swizzle_groups = false;
+		else if (!strcmp(argv[i], "--group-order=swizzled"))
+			program.swizzle_groups = true;
+		else if (!strncmp(argv[i], "--dynamic-resolution=", 21) && parse_positive_float(argv[i] + 21, &float_arg))
+			program.dynamic_resolution_target_ms = float_arg;
+		else if (!strncmp(argv[i], "--threads=", 10) && parse_uint_list(argv[i] + 10, &uint_arg, 1))
+			program.cpu_thread_cnt = uint_arg;
+		else if (!strncmp(argv[i], "--load-volume=", 14))
+			program.volume_load_path = argv[i] + 14;
+		else if (!strncmp(argv[i], "--save-volume=", 14))
+			program.volume_save_path = argv[i] + 14;
+		else if (!strncmp(argv[i], "--profile=", 10) && argv[i][10] != '\0')
+			program.profile_path = argv[i] + 10;
+		else if (!strncmp(argv[i], "--level-cnt=", 12) && parse_uint_list(argv[i] + 12, &uint_arg, 1))
 		{
-			check(vkWaitForFences(ctx.m_device, 1, &frame_inflight_fences[frame_idx], VK_FALSE, UINT64_MAX));
-
-			uint32_t swapchain_idx;
+			program.level_cnt = uint_arg;
 
-			VkResult acquire_rst = vkAcquireNextImageKHR(ctx.m_device, ctx.m_swapchain, UINT64_MAX, image_available_semaphores[frame_idx], nullptr, &swapchain_idx);
+			is_level_cnt_set = true;
+		}
+		else if (!strncmp(argv[i], "--base-dim-log2=", 16) && parse_uint_list(argv[i] + 16, &uint_arg, 1))
+		{
+			program.base_dim_log2 = uint_arg;
 
-			if (acquire_rst == VK_ERROR_OUT_OF_DATE_KHR)
-			{
-				check(recreate_swapchain());
+			is_base_dim_set = true;
+		}
+		else if (!strncmp(argv[i], "--brick-dim-log2=", 17) && parse_uint_list(argv[i] + 17, &uint_arg, 1))
+		{
+			program.brick_dim_log2 = uint_arg;
 
-				continue;
-			}
-			else if (acquire_rst != VK_SUBOPTIMAL_KHR)
-				check(acquire_rst);
+			is_brick_dim_set = true;
+		}
+		else if (!strncmp(argv[i], "--trace-group=", 14) && parse_uint_list(argv[i] + 14, program.trace_group_size, 2))
+			is_trace_group_set = true;
+		else if (!strncmp(argv[i], "--gen-group=", 12) && parse_uint_list(argv[i] + 12, program.checkempty_group_size, 3))
+		{
+			for (uint32_t j = 0; j != 3; ++j)
+				program.assignindex_group_size[j] = program.checkempty_group_size[j];
 
-			if (image_inflight_fences[swapchain_idx] != nullptr)
-				check(vkWaitForFences(ctx.m_device, 1, &image_inflight_fences[swapchain_idx], VK_FALSE, UINT64_MAX));
+			is_gen_group_set = true;
+		}
+		else if (!strcmp(argv[i], "--autotune"))
+			is_autotune = true;
+		else if (!strncmp(argv[i], "--autotune=", 11) && parse_uint_list(argv[i] + 11, &uint_arg, 1))
+		{
+			autotune_frame_cnt = uint_arg;
 
-			image_inflight_fences[swapchain_idx] = frame_inflight_fences[frame_idx];
+			is_autotune = true;
+		}
+		else if (!strcmp(argv[i], "--benchmark-layouts"))
+			is_layout_benchmark = true;
+		else if (!strncmp(argv[i], "--benchmark-layouts=", 20) && parse_uint_list(argv[i] + 20, &uint_arg, 1))
+		{
+			layout_benchmark_frame_cnt = uint_arg;
 
-			check(record_command_buffer(command_buffers[frame_idx], swapchain_idx));
+			is_layout_benchmark = true;
+		}
+		else if (!strcmp(argv[i], "--benchmark-tracers"))
+			is_tracer_benchmark = true;
+		else if (!strncmp(argv[i], "--benchmark-tracers=", 20) && parse_uint_list(argv[i] + 20, &uint_arg, 1))
+		{
+			tracer_benchmark_frame_cnt = uint_arg;
 
-			VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			is_tracer_benchmark = true;
+		}
+		else if (!strcmp(argv[i], "--benchmark-dispatch"))
+			is_dispatch_benchmark = true;
+		else if (!strncmp(argv[i], "--benchmark-dispatch=", 21) && parse_uint_list(argv[i] + 21, &uint_arg, 1))
+		{
+			dispatch_benchmark_frame_cnt = uint_arg;
 
-			VkSubmitInfo submit_info{};
-			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-			submit_info.pNext = nullptr;
-			submit_info.waitSemaphoreCount = 1;
-			submit_info.pWaitSemaphores = &image_available_semaphores[frame_idx];
-			submit_info.pWaitDstStageMask = &wait_stage;
-			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &command_buffers[frame_idx];
-			submit_info.signalSemaphoreCount = 1;
-			submit_info.pSignalSemaphores = &render_complete_semaphores[frame_idx];
+			is_dispatch_benchmark = true;
+		}
+		else
+		{
+			och::print("Unknown argument \"{}\"\n\nUsage: voxels [--brick-format=u16|bitpacked|leaf] [--brick-layout=linear|morton] [--cpu-build] [--validate] [--threads=N] [--load-volume=FILE] [--save-volume=FILE]\n"
+				"              [--level-cnt=N] [--base-dim-log2=N] [--brick-dim-log2=N] [--trace-group=X,Y] [--gen-group=X,Y,Z] [--autotune[=FRAMES]]\n"
+				"              [--brick-storage=buffer|atlas] [--benchmark-layouts[=FRAMES]] [--depth-prepass] [--reproject]\n"
+				"              [--trace-rate=full|checkerboard|variable] [--tracer=pixel|persistent] [--benchmark-tracers[=FRAMES]]\n"
+				"              [--ray-query-capacity=N] [--dynamic-resolution=TARGET_MS] [--group-order=raster|swizzled] [--benchmark-dispatch[=FRAMES]]\n"
+				"              [--profile=FILE.csv|FILE.json]\n", argv[i]);
+
+			return to_status(och::error::argument_invalid);
+		}
+	}
 
-			check(vkResetFences(ctx.m_device, 1, &frame_inflight_fences[frame_idx]));
+	if (program.persistent_trace && program.ray_rate == trace_rate::variable)
+	{
+		och::print("--tracer=persistent does not support --trace-rate=variable\n");
 
-			check(vkQueueSubmit(ctx.m_general_queues[0], 1, &submit_info, frame_inflight_fences[frame_idx]));
+		return to_status(och::error::argument_invalid);
+	}
 
-			VkPresentInfoKHR present_info{};
-			present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-			present_info.pNext = nullptr;
-			present_info.waitSemaphoreCount = 1;
-			present_info.pWaitSemaphores = &render_complete_semaphores[frame_idx];
-			present_info.swapchainCount = 1;
-			present_info.pSwapchains = &ctx.m_swapchain;
-			present_info.pImageIndices = &swapchain_idx;
-			present_info.pResults = nullptr;
+	if (is_autotune)
+		return autotune_voxel_volume(program, is_level_cnt_set, is_base_dim_set, is_brick_dim_set, is_trace_group_set, is_gen_group_set, autotune_frame_cnt);
 
-			VkResult present_rst = vkQueuePresentKHR(ctx.m_general_queues[0], &present_info);
+	if (is_layout_benchmark)
+		return benchmark_brick_layouts(program, layout_benchmark_frame_cnt);
 
-			if (present_rst == VK_ERROR_OUT_OF_DATE_KHR || present_rst == VK_SUBOPTIMAL_KHR || ctx.is_framebuffer_resized())
-			{
-				ctx.m_flags.framebuffer_resized.store(false, std::memory_order::memory_order_release);
+	if (is_tracer_benchmark)
+		return benchmark_tracers(program, tracer_benchmark_frame_cnt);
 
-				recreate_swapchain();
-			}
-			else
-				check(present_rst);
+	if (is_dispatch_benchmark)
+		return benchmark_dispatch(program, dispatch_benchmark_frame_cnt);
 
-			frame_idx = (frame_idx + 1) % MAX_FRAMES_INFLIGHT;
+	// Build the volume on the CPU only, which works without a GPU, e.g. for generating volumes on a server
+	if (is_cpu_build_only)
+	{
+		// cpu_volume only produces bitpacked bricks in linear order, which is also what gets saved
+		if (program.brick_fmt != brick_format::bitpacked || program.voxel_layout != brick_layout::linear)
+		{
+			och::print("--cpu-build only supports --brick-format=bitpacked and --brick-layout=linear\n");
 
-			// FPS counter
-			{
-				++frames_since_last_report;
+			return to_status(och::error::argument_invalid);
+		}
 
-				och::time now = och::time::now();
+		check(program.init_geometry());
 
-				och::timespan elapsed_time = (now - last_report_time);
+		och::timer cpu_timer;
 
-				uint64_t elapsed_ms = elapsed_time.milliseconds();
+		cpu_volume cpu(static_cast<uint32_t>(program.level_cnt), static_cast<uint32_t>(program.base_dim_log2), static_cast<uint32_t>(program.brick_dim_log2));
 
-				if (elapsed_ms > 1000)
-				{
-					char fps_buf[1024];
+		check(cpu.build(program.get_cpu_volume_params(), program.cpu_thread_cnt));
 
-					och::sprint(fps_buf, "    (FPS: {}  x: {:.2}  y: {:.2}  z: {:.2})", (frames_since_last_report * 1000) / (elapsed_ms + 1), input_position.x, input_position.y, input_position.z);
+		och::timespan cpu_time = cpu_timer.read();
 
-					check(ctx.set_window_note(fps_buf));
+		const uint64_t voxel_cnt = program.base_vol * program.level_cnt * program.brick_vol;
 
-					frames_since_last_report = 0;
+		och::print("Built {} bricks on {} threads in {} ({} Mvoxels/s)\n", cpu.brick_cnt, program.cpu_thread_cnt, cpu_time, voxel_cnt / ((cpu_time.milliseconds() + 1) * 1000));
 
-					last_report_time = now;
-				}
-			}
+		if (program.volume_save_path != nullptr)
+		{
+			volume_file_header header{};
+			header.level_cnt = cpu.level_cnt;
+			header.base_dim_log2 = cpu.base_dim_log2;
+			header.brick_dim_log2 = cpu.brick_dim_log2;
+			header.brick_format = static_cast<uint32_t>(brick_format::bitpacked);
+			header.brick_layout = static_cast<uint32_t>(brick_layout::linear);
+			header.gen_offset = program.gen_offset;
+			header.gen_scale = program.gen_scale;
+			header.gen_cutoff = program.gen_cutoff;
+			header.anchor[0] = program.volume_anchor[0];
+			header.anchor[1] = program.volume_anchor[1];
+			header.anchor[2] = program.volume_anchor[2];
+			header.brick_cnt = cpu.brick_cnt;
+			header.base_bytes = cpu.base.size() * sizeof(uint32_t);
+			header.brick_bytes = static_cast<uint64_t>(cpu.brick_cnt) * cpu.brick_words * sizeof(uint32_t);
+			header.leaf_cnt = 0;
+			header.leaf_bytes = 0;
+
+			check(write_volume_file(program.volume_save_path, header, cpu.base.data(), cpu.bricks.data(), nullptr));
+
+			och::print("Saved volume to {}\n", program.volume_save_path);
 		}
 
 		return {};
 	}
-};
-
-och::status run_voxel_volume(int argc, const char** argv) noexcept
-{
-	argc; argv;
-
-	voxel_volume program;
 
 	och::status err = program.create();
 
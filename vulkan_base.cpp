@@ -1,6 +1,7 @@
 #include "vulkan_base.hpp"
 
 #include "heap_buffer.h"
+#include "file_writer.hpp"
 #include <och_fmt.h>
 #include <och_fio.h>
 
@@ -9,6 +10,8 @@
 
 #include "och_err.h"
 
+#include <cstring>
+
 #include <vulkan/vulkan_win32.h>
 
 
@@ -491,9 +494,15 @@ och::status vulkan_context::create(const vulkan_context_create_info* create_info
 			else
 				m_flags.separate_compute_and_general_queue = true;
 
+			// Optional transfer queues are simply left out on devices without enough of them
+			uint32_t transfer_queue_cnt = create_info->requested_transfer_queues;
+
+			if (create_info->transfer_queues_optional && (transfer_queue_index == VK_QUEUE_FAMILY_IGNORED || family_properties[transfer_queue_index].queueCount < transfer_queue_cnt))
+				transfer_queue_cnt = 0;
+
 			if (((general_queue_index == VK_QUEUE_FAMILY_IGNORED && create_info->requested_general_queues) || (create_info->requested_general_queues && family_properties[general_queue_index].queueCount < create_info->requested_general_queues)) ||
 				((compute_queue_index == VK_QUEUE_FAMILY_IGNORED && create_info->requested_compute_queues) || (create_info->requested_compute_queues && family_properties[compute_queue_index].queueCount < create_info->requested_compute_queues)) ||
-				((transfer_queue_index == VK_QUEUE_FAMILY_IGNORED && create_info->requested_transfer_queues) || (create_info->requested_transfer_queues && family_properties[transfer_queue_index].queueCount < create_info->requested_transfer_queues)))
+				((transfer_queue_index == VK_QUEUE_FAMILY_IGNORED && transfer_queue_cnt) || (transfer_queue_cnt && family_properties[transfer_queue_index].queueCount < transfer_queue_cnt)))
 				continue;
 
 			// Check support for window surface
@@ -557,10 +566,10 @@ och::status vulkan_context::create(const vulkan_context_create_info* create_info
 				m_compute_queues.cnt = create_info->requested_compute_queues;
 			}
 
-			if (create_info->requested_transfer_queues)
+			if (transfer_queue_cnt)
 			{
 				m_transfer_queues.family_index = transfer_queue_index;
-				m_transfer_queues.cnt = create_info->requested_transfer_queues;
+				m_transfer_queues.cnt = transfer_queue_cnt;
 
 				m_min_image_transfer_granularity = family_properties[transfer_queue_index].minImageTransferGranularity;
 			}
@@ -616,11 +625,11 @@ och::status vulkan_context::create(const vulkan_context_create_info* create_info
 			++ci_idx;
 		}
 
-		if (create_info->requested_transfer_queues)
+		if (m_transfer_queues.cnt)
 		{
 			queue_cis[ci_idx].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 			queue_cis[ci_idx].queueFamilyIndex = m_transfer_queues.family_index;
-			queue_cis[ci_idx].queueCount = create_info->requested_transfer_queues;
+			queue_cis[ci_idx].queueCount = m_transfer_queues.cnt;
 			queue_cis[ci_idx].pQueuePriorities = transfer_queue_priorities;
 
 			++ci_idx;
@@ -663,7 +672,7 @@ och::status vulkan_context::create(const vulkan_context_create_info* create_info
 		}
 
 
-		for (uint32_t i = 0; i != create_info->requested_transfer_queues; ++i)
+		for (uint32_t i = 0; i != m_transfer_queues.cnt; ++i)
 			vkGetDeviceQueue(m_device, m_transfer_queues.family_index, i, m_transfer_queues.queues + i);
 	}
 
@@ -777,6 +786,12 @@ och::status vulkan_context::create(const vulkan_context_create_info* create_info
 		vkGetPhysicalDeviceMemoryProperties(m_physical_device, &m_memory_properties);
 	}
 
+	if (create_info->staging_ring_bytes != 0)
+		check(create_staging_ring(create_info->staging_ring_bytes));
+
+	if (create_info->profiler_frame_cnt != 0)
+		check(create_profiler(create_info->profiler_frame_cnt));
+
 	return {};
 }
 
@@ -790,7 +805,13 @@ void vulkan_context::destroy() const noexcept
 		vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
 
 	if(m_device)
+	{
+		destroy_staging_ring();
+
+		destroy_profiler();
+
 		vkDestroyDevice(m_device, nullptr);
+	}
 
 	if(m_surface)
 		vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
@@ -1272,3 +1293,559 @@ void vulkan_context::set_mouse_pos(uint16_t x, uint16_t y) noexcept
 
 	m_mouse_y = y;
 }
+
+
+
+och::status vulkan_context::create_staging_ring(VkDeviceSize bytes) noexcept
+{
+	// Keep every allocation aligned by only ever handing out multiples of the alignment
+	bytes = (bytes + STAGING_RING_ALIGNMENT - 1) & ~(STAGING_RING_ALIGNMENT - 1);
+
+	if (m_transfer_queues.cnt != 0)
+	{
+		m_staging_queue = m_transfer_queues[0];
+
+		m_staging_queue_family_index = m_transfer_queues.family_index;
+	}
+	else
+	{
+		m_staging_queue = m_general_queues[0];
+
+		m_staging_queue_family_index = m_general_queues.family_index;
+	}
+
+	check(create_buffer(m_staging_buffer, m_staging_memory, bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+	check(vkMapMemory(m_device, m_staging_memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&m_staging_data)));
+
+	m_staging_bytes = bytes;
+
+	VkCommandPoolCreateInfo command_pool_ci{};
+	command_pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	command_pool_ci.pNext = nullptr;
+	command_pool_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	command_pool_ci.queueFamilyIndex = m_staging_queue_family_index;
+
+	check(vkCreateCommandPool(m_device, &command_pool_ci, nullptr, &m_staging_command_pool));
+
+	VkCommandBuffer command_buffers[STAGING_RING_BATCH_CNT];
+
+	VkCommandBufferAllocateInfo command_buffer_ai{};
+	command_buffer_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	command_buffer_ai.pNext = nullptr;
+	command_buffer_ai.commandPool = m_staging_command_pool;
+	command_buffer_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	command_buffer_ai.commandBufferCount = STAGING_RING_BATCH_CNT;
+
+	check(vkAllocateCommandBuffers(m_device, &command_buffer_ai, command_buffers));
+
+	VkFenceCreateInfo fence_ci{};
+	fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_ci.pNext = nullptr;
+	fence_ci.flags = 0;
+
+	for (uint32_t i = 0; i != STAGING_RING_BATCH_CNT; ++i)
+	{
+		m_staging_batches[i].command_buffer = command_buffers[i];
+
+		check(vkCreateFence(m_device, &fence_ci, nullptr, &m_staging_batches[i].fence));
+	}
+
+	return {};
+}
+
+void vulkan_context::destroy_staging_ring() const noexcept
+{
+	if (m_staging_buffer == nullptr)
+		return;
+
+	vkDeviceWaitIdle(m_device);
+
+	for (uint32_t i = 0; i != STAGING_RING_BATCH_CNT; ++i)
+		vkDestroyFence(m_device, m_staging_batches[i].fence, nullptr);
+
+	vkDestroyCommandPool(m_device, m_staging_command_pool, nullptr);
+
+	vkDestroyBuffer(m_device, m_staging_buffer, nullptr);
+
+	vkFreeMemory(m_device, m_staging_memory, nullptr);
+}
+
+och::status vulkan_context::retire_staging_batches(bool wait_for_oldest) noexcept
+{
+	// Batches are submitted round-robin and complete in order, so stop at the first one still running
+	while (m_staging_retired_batch_cnt != m_staging_submitted_batch_cnt)
+	{
+		staging_ring_batch& batch = m_staging_batches[m_staging_retired_batch_cnt % STAGING_RING_BATCH_CNT];
+
+		if (wait_for_oldest)
+		{
+			check(vkWaitForFences(m_device, 1, &batch.fence, VK_FALSE, UINT64_MAX));
+
+			wait_for_oldest = false;
+		}
+		else
+		{
+			const VkResult fence_rst = vkGetFenceStatus(m_device, batch.fence);
+
+			if (fence_rst == VK_NOT_READY)
+				break;
+
+			check(fence_rst);
+		}
+
+		check(vkResetFences(m_device, 1, &batch.fence));
+
+		// Batches submitted without any allocations end behind a tail that was moved up to the start of the ring
+		if (batch.ring_end > m_staging_tail)
+			m_staging_tail = batch.ring_end;
+
+		++m_staging_retired_batch_cnt;
+	}
+
+	return {};
+}
+
+och::status vulkan_context::allocate_staging_memory(VkDeviceSize bytes, VkDeviceSize& out_offset) noexcept
+{
+	bytes = (bytes + STAGING_RING_ALIGNMENT - 1) & ~(STAGING_RING_ALIGNMENT - 1);
+
+	if (bytes > m_staging_bytes)
+		return to_status(och::error::argument_too_large);
+
+	check(retire_staging_batches(false));
+
+	while (true)
+	{
+		// Allocations never wrap around the end of the ring, so skip the remainder if it is too small
+		const uint64_t head_offset = m_staging_head % m_staging_bytes;
+
+		// Nothing is in use, so start over at the beginning of the ring, without holding the skipped remainder against
+		// the allocation. Otherwise an allocation larger than the remainder would never fit.
+		if (m_staging_head == m_staging_tail && head_offset + bytes > m_staging_bytes)
+		{
+			m_staging_head += m_staging_bytes - head_offset;
+
+			m_staging_tail = m_staging_head;
+
+			continue;
+		}
+
+		const uint64_t padding = head_offset + bytes > m_staging_bytes ? m_staging_bytes - head_offset : 0;
+
+		if (m_staging_head + padding + bytes - m_staging_tail <= m_staging_bytes)
+		{
+			m_staging_head += padding;
+
+			out_offset = m_staging_head % m_staging_bytes;
+
+			m_staging_head += bytes;
+
+			return {};
+		}
+
+		// The ring is full. Free up the space held by the oldest batch, which may have to be the one currently recording.
+		if (m_staging_retired_batch_cnt == m_staging_submitted_batch_cnt)
+			check(flush_staging_ring());
+
+		check(retire_staging_batches(true));
+	}
+}
+
+och::status vulkan_context::begin_staging_batch() noexcept
+{
+	if (m_staging_is_recording)
+		return {};
+
+	// All batches are in flight, so the one we are about to reuse has to complete first
+	if (m_staging_submitted_batch_cnt - m_staging_retired_batch_cnt == STAGING_RING_BATCH_CNT)
+		check(retire_staging_batches(true));
+
+	VkCommandBufferBeginInfo command_buffer_bi{};
+	command_buffer_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	command_buffer_bi.pNext = nullptr;
+	command_buffer_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	command_buffer_bi.pInheritanceInfo = nullptr;
+
+	check(vkBeginCommandBuffer(m_staging_batches[m_staging_submitted_batch_cnt % STAGING_RING_BATCH_CNT].command_buffer, &command_buffer_bi));
+
+	m_staging_is_recording = true;
+
+	return {};
+}
+
+och::status vulkan_context::stage_buffer_upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize bytes) noexcept
+{
+	// Split large uploads, so that at least two batches fit into the ring and copying overlaps with staging the next chunk
+	const VkDeviceSize max_chunk_bytes = m_staging_bytes / 2;
+
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+
+	while (bytes != 0)
+	{
+		const VkDeviceSize chunk_bytes = bytes < max_chunk_bytes ? bytes : max_chunk_bytes;
+
+		VkDeviceSize staging_offset;
+
+		check(allocate_staging_memory(chunk_bytes, staging_offset));
+
+		memcpy(m_staging_data + staging_offset, src, chunk_bytes);
+
+		check(begin_staging_batch());
+
+		VkBufferCopy copy_region{};
+		copy_region.srcOffset = staging_offset;
+		copy_region.dstOffset = dst_offset;
+		copy_region.size = chunk_bytes;
+
+		vkCmdCopyBuffer(m_staging_batches[m_staging_submitted_batch_cnt % STAGING_RING_BATCH_CNT].command_buffer, m_staging_buffer, dst, 1, &copy_region);
+
+		src += chunk_bytes;
+
+		dst_offset += chunk_bytes;
+
+		bytes -= chunk_bytes;
+	}
+
+	return {};
+}
+
+och::status vulkan_context::stage_image_upload(VkImage dst, VkImageLayout dst_layout, VkBufferImageCopy region, const void* data, VkDeviceSize bytes) noexcept
+{
+	VkDeviceSize staging_offset;
+
+	check(allocate_staging_memory(bytes, staging_offset));
+
+	memcpy(m_staging_data + staging_offset, data, bytes);
+
+	check(begin_staging_batch());
+
+	region.bufferOffset = staging_offset;
+
+	vkCmdCopyBufferToImage(m_staging_batches[m_staging_submitted_batch_cnt % STAGING_RING_BATCH_CNT].command_buffer, m_staging_buffer, dst, dst_layout, 1, &region);
+
+	return {};
+}
+
+och::status vulkan_context::flush_staging_ring(uint32_t signal_semaphore_cnt, const VkSemaphore* signal_semaphores) noexcept
+{
+	if (!m_staging_is_recording)
+		return {};
+
+	staging_ring_batch& batch = m_staging_batches[m_staging_submitted_batch_cnt % STAGING_RING_BATCH_CNT];
+
+	check(vkEndCommandBuffer(batch.command_buffer));
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = nullptr;
+	submit_info.waitSemaphoreCount = 0;
+	submit_info.pWaitSemaphores = nullptr;
+	submit_info.pWaitDstStageMask = nullptr;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &batch.command_buffer;
+	submit_info.signalSemaphoreCount = signal_semaphore_cnt;
+	submit_info.pSignalSemaphores = signal_semaphores;
+
+	check(vkQueueSubmit(m_staging_queue, 1, &submit_info, batch.fence));
+
+	batch.ring_end = m_staging_head;
+
+	++m_staging_submitted_batch_cnt;
+
+	m_staging_is_recording = false;
+
+	return {};
+}
+
+och::status vulkan_context::wait_staging_ring_idle() noexcept
+{
+	check(flush_staging_ring());
+
+	while (m_staging_retired_batch_cnt != m_staging_submitted_batch_cnt)
+		check(retire_staging_batches(true));
+
+	return {};
+}
+
+och::status vulkan_context::create_profiler(uint32_t frame_cnt) noexcept
+{
+	if (frame_cnt > PROFILER_MAX_FRAME_CNT)
+		return to_status(och::error::argument_too_large);
+
+	VkPhysicalDeviceProperties properties;
+
+	vkGetPhysicalDeviceProperties(m_physical_device, &properties);
+
+	// Scopes may be recorded on the general as well as the compute queues
+	if (!properties.limits.timestampComputeAndGraphics)
+		return to_status(VK_ERROR_FEATURE_NOT_PRESENT);
+
+	m_profiler_timestamp_ms = properties.limits.timestampPeriod / 1'000'000.0F;
+
+	m_profiler_frame_cnt = frame_cnt;
+
+	VkQueryPoolCreateInfo query_pool_ci{};
+	query_pool_ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	query_pool_ci.pNext = nullptr;
+	query_pool_ci.flags = 0;
+	query_pool_ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	query_pool_ci.queryCount = 2 * PROFILER_MAX_FRAME_SCOPE_CNT;
+	query_pool_ci.pipelineStatistics = 0;
+
+	for (uint32_t i = 0; i != frame_cnt; ++i)
+		check(vkCreateQueryPool(m_device, &query_pool_ci, nullptr, &m_profiler_frames[i].query_pool));
+
+	m_profiler_history.allocate(PROFILER_MAX_SCOPE_CNT * PROFILER_HISTORY_CNT);
+
+	return {};
+}
+
+void vulkan_context::destroy_profiler() const noexcept
+{
+	if (m_profiler_frame_cnt == 0)
+		return;
+
+	vkDeviceWaitIdle(m_device);
+
+	for (uint32_t i = 0; i != m_profiler_frame_cnt; ++i)
+		if (m_profiler_frames[i].query_pool != nullptr)
+			vkDestroyQueryPool(m_device, m_profiler_frames[i].query_pool, nullptr);
+}
+
+och::status vulkan_context::collect_profiler_frame(uint32_t frame_index) noexcept
+{
+	if (m_profiler_frame_cnt == 0)
+		return {};
+
+	if (frame_index >= m_profiler_frame_cnt)
+		return to_status(och::error::argument_invalid);
+
+	profiler_frame& frame = m_profiler_frames[frame_index];
+
+	const uint32_t written_scope_cnt = frame.written_scope_cnt;
+
+	if (written_scope_cnt == 0)
+		return {};
+
+	frame.written_scope_cnt = 0;
+
+	uint64_t timestamps[2 * PROFILER_MAX_FRAME_SCOPE_CNT];
+
+	const VkResult query_rst = vkGetQueryPoolResults(m_device, frame.query_pool, 0, 2 * written_scope_cnt, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	// The frame was recorded but never submitted, or a scope was left open
+	if (query_rst == VK_NOT_READY)
+		return {};
+
+	check(query_rst);
+
+	float scope_ms[PROFILER_MAX_SCOPE_CNT]{};
+
+	bool is_scope_written[PROFILER_MAX_SCOPE_CNT]{};
+
+	for (uint32_t i = 0; i != written_scope_cnt; ++i)
+	{
+		const uint32_t scope = frame.scope_indices[i];
+
+		scope_ms[scope] += static_cast<float>(timestamps[2 * i + 1] - timestamps[2 * i]) * m_profiler_timestamp_ms;
+
+		is_scope_written[scope] = true;
+	}
+
+	for (uint32_t s = 0; s != m_profiler_scope_cnt; ++s)
+	{
+		if (!is_scope_written[s])
+			continue;
+
+		m_profiler_history[s * PROFILER_HISTORY_CNT + static_cast<uint32_t>(m_profiler_sample_cnts[s] % PROFILER_HISTORY_CNT)] = scope_ms[s];
+
+		++m_profiler_sample_cnts[s];
+	}
+
+	return {};
+}
+
+och::status vulkan_context::begin_profiler_frame(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept
+{
+	check(collect_profiler_frame(frame_index));
+
+	if (m_profiler_frame_cnt == 0)
+		return {};
+
+	vkCmdResetQueryPool(command_buffer, m_profiler_frames[frame_index].query_pool, 0, 2 * PROFILER_MAX_FRAME_SCOPE_CNT);
+
+	return {};
+}
+
+och::status vulkan_context::begin_profile_scope(VkCommandBuffer command_buffer, uint32_t frame_index, const char* name, uint32_t& out_slot) noexcept
+{
+	out_slot = ~0u;
+
+	if (m_profiler_frame_cnt == 0)
+		return {};
+
+	if (frame_index >= m_profiler_frame_cnt)
+		return to_status(och::error::argument_invalid);
+
+	profiler_frame& frame = m_profiler_frames[frame_index];
+
+	if (frame.written_scope_cnt == PROFILER_MAX_FRAME_SCOPE_CNT)
+		return to_status(och::error::argument_too_large);
+
+	uint32_t scope = find_profile_scope(name);
+
+	if (scope == ~0u)
+	{
+		scope = m_profiler_scope_cnt;
+
+		const size_t name_len = strlen(name);
+
+		if (scope == PROFILER_MAX_SCOPE_CNT || name_len >= PROFILER_MAX_SCOPE_NAME_CHARS)
+			return to_status(och::error::argument_too_large);
+
+		memcpy(m_profiler_scope_names[scope], name, name_len + 1);
+
+		++m_profiler_scope_cnt;
+	}
+
+	out_slot = frame.written_scope_cnt;
+
+	frame.scope_indices[out_slot] = static_cast<uint8_t>(scope);
+
+	++frame.written_scope_cnt;
+
+	// Waits for all earlier commands, so that the time of the passes before the scope is not counted towards it
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.query_pool, 2 * out_slot);
+
+	return {};
+}
+
+void vulkan_context::end_profile_scope(VkCommandBuffer command_buffer, uint32_t frame_index, uint32_t slot) const noexcept
+{
+	if (slot == ~0u)
+		return;
+
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_profiler_frames[frame_index].query_pool, 2 * slot + 1);
+}
+
+vulkan_context::profile_statistics vulkan_context::get_profile_statistics(uint32_t scope_index, uint64_t first_sample) const noexcept
+{
+	profile_statistics statistics{};
+
+	if (scope_index >= m_profiler_scope_cnt || m_profiler_sample_cnts[scope_index] <= first_sample)
+		return statistics;
+
+	const uint64_t available_cnt = m_profiler_sample_cnts[scope_index] - first_sample;
+
+	const uint32_t sample_cnt = available_cnt < PROFILER_HISTORY_CNT ? static_cast<uint32_t>(available_cnt) : PROFILER_HISTORY_CNT;
+
+	const uint64_t begin_sample = m_profiler_sample_cnts[scope_index] - sample_cnt;
+
+	const float* history = m_profiler_history.data() + scope_index * PROFILER_HISTORY_CNT;
+
+	float sorted_samples[PROFILER_HISTORY_CNT];
+
+	float sample_sum = 0.0F;
+
+	// Insertion sort, which is plenty for a few hundred samples
+	for (uint32_t i = 0; i != sample_cnt; ++i)
+	{
+		const float sample = history[static_cast<uint32_t>((begin_sample + i) % PROFILER_HISTORY_CNT)];
+
+		sample_sum += sample;
+
+		uint32_t j = i;
+
+		while (j != 0 && sorted_samples[j - 1] > sample)
+		{
+			sorted_samples[j] = sorted_samples[j - 1];
+
+			--j;
+		}
+
+		sorted_samples[j] = sample;
+	}
+
+	statistics.sample_cnt = sample_cnt;
+
+	statistics.sum_ms = sample_sum;
+
+	statistics.min_ms = sorted_samples[0];
+
+	statistics.avg_ms = sample_sum / static_cast<float>(sample_cnt);
+
+	// Nearest-rank percentile, i.e. the smallest sample not exceeded by 99% of them
+	statistics.p99_ms = sorted_samples[(sample_cnt * 99 + 99) / 100 - 1];
+
+	return statistics;
+}
+
+uint32_t vulkan_context::find_profile_scope(const char* name) const noexcept
+{
+	for (uint32_t s = 0; s != m_profiler_scope_cnt; ++s)
+		if (strcmp(m_profiler_scope_names[s], name) == 0)
+			return s;
+
+	return ~0u;
+}
+
+float vulkan_context::get_latest_profile_sample(uint32_t scope_index) const noexcept
+{
+	if (scope_index >= m_profiler_scope_cnt || m_profiler_sample_cnts[scope_index] == 0)
+		return 0.0F;
+
+	return m_profiler_history[scope_index * PROFILER_HISTORY_CNT + static_cast<uint32_t>((m_profiler_sample_cnts[scope_index] - 1) % PROFILER_HISTORY_CNT)];
+}
+
+static och::status write_profile_text(file_writer& file, const char* str) noexcept
+{
+	return file.write(str, strlen(str));
+}
+
+och::status vulkan_context::write_profile(const char* filename) const noexcept
+{
+	// Enough for a line of statistics with a name of up to PROFILER_MAX_SCOPE_NAME_CHARS characters
+	static constexpr uint32_t MAX_LINE_CHARS = 256;
+
+	const size_t filename_len = strlen(filename);
+
+	const bool is_json = filename_len >= 5 && strcmp(filename + filename_len - 5, ".json") == 0;
+
+	file_writer file;
+
+	check(file.create(filename));
+
+	char line[MAX_LINE_CHARS];
+
+	check(write_profile_text(file, is_json ? "{\n\t\"scopes\": [\n" : "scope,samples,min_ms,avg_ms,p99_ms\n"));
+
+	for (uint32_t s = 0; s != m_profiler_scope_cnt; ++s)
+	{
+		const profile_statistics statistics = get_profile_statistics(s);
+
+		const char* name = m_profiler_scope_names[s];
+
+		if (is_json)
+		{
+			och::sprint(line, "\"name\": \"{}\", \"samples\": {}, \"min_ms\": {:.4}, \"avg_ms\": {:.4}, \"p99_ms\": {:.4}", name, statistics.sample_cnt, statistics.min_ms, statistics.avg_ms, statistics.p99_ms);
+
+			check(write_profile_text(file, "\t\t{ "));
+
+			check(write_profile_text(file, line));
+
+			check(write_profile_text(file, s + 1 == m_profiler_scope_cnt ? " }\n" : " },\n"));
+		}
+		else
+		{
+			och::sprint(line, "{},{},{:.4},{:.4},{:.4}\n", name, statistics.sample_cnt, statistics.min_ms, statistics.avg_ms, statistics.p99_ms);
+
+			check(write_profile_text(file, line));
+		}
+	}
+
+	if (is_json)
+		check(write_profile_text(file, "\t]\n}\n"));
+
+	return {};
+}
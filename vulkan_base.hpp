@@ -215,13 +215,13 @@ struct queue_family_info
 
 	uint32_t cnt;
 
-	uint32_t offset; // Used if compute and graphics queue families are merged.
+	uint32_t offset; // Index of the first queue within the family. Used if compute and graphics queue families are merged.
 
 	VkQueue queues[MAX_QUEUE_CNT];
 
-	VkQueue& operator[](size_t n) noexcept { return queues[n + offset]; }
+	VkQueue& operator[](size_t n) noexcept { return queues[n]; }
 
-	const VkQueue& operator[](size_t n) const noexcept { return queues[n - offset]; }
+	const VkQueue& operator[](size_t n) const noexcept { return queues[n]; }
 };
 
 
@@ -238,10 +238,13 @@ struct vulkan_context_create_info
 	uint32_t requested_general_queues = 1;
 	uint32_t requested_compute_queues = 0;
 	uint32_t requested_transfer_queues = 0;
+	bool transfer_queues_optional = false; // If set, devices without enough transfer-only queues are still accepted, with m_transfer_queues left empty
 	VkImageUsageFlags swapchain_image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	uint32_t requested_api_version = VK_API_VERSION_1_0;
 	bool allow_compute_graphics_queue_merge = true;
 	bool allow_window_resizing = true;
+	VkDeviceSize staging_ring_bytes = 0; // If non-zero, a staging ring of this size is created. Uploads go to a transfer queue if one was requested.
+	uint32_t profiler_frame_cnt = 0; // If non-zero, a GPU timestamp profiler with this many frame slots is created. At most vulkan_context::PROFILER_MAX_FRAME_CNT.
 	const VkPhysicalDeviceFeatures2* enabled_device_features2 = nullptr;
 	physical_device_suitable_callback_fn physical_device_suitable_callback = nullptr;
 	och::iohandle debug_output_handle = och::get_stdout();
@@ -260,6 +263,20 @@ struct vulkan_context
 
 	static constexpr uint32_t MAX_MESSAGE_PUMP_INITIALIZATION_TIME_MS = 2000;
 
+	static constexpr uint32_t STAGING_RING_BATCH_CNT = 4;
+
+	static constexpr VkDeviceSize STAGING_RING_ALIGNMENT = 256;
+
+	static constexpr uint32_t PROFILER_MAX_FRAME_CNT = 4;
+
+	static constexpr uint32_t PROFILER_MAX_SCOPE_CNT = 32;
+
+	static constexpr uint32_t PROFILER_MAX_FRAME_SCOPE_CNT = 32;
+
+	static constexpr uint32_t PROFILER_MAX_SCOPE_NAME_CHARS = 32;
+
+	static constexpr uint32_t PROFILER_HISTORY_CNT = 256;
+
 
 
 	struct
@@ -322,6 +339,81 @@ struct vulkan_context
 
 
 
+	struct staging_ring_batch
+	{
+		VkCommandBuffer command_buffer;
+
+		VkFence fence;
+
+		uint64_t ring_end; // Ring position just past the last byte staged by this batch
+	};
+
+	VkBuffer m_staging_buffer{};
+
+	VkDeviceMemory m_staging_memory{};
+
+	uint8_t* m_staging_data{};
+
+	VkDeviceSize m_staging_bytes{};
+
+	VkCommandPool m_staging_command_pool{};
+
+	VkQueue m_staging_queue{};
+
+	uint32_t m_staging_queue_family_index{};
+
+	staging_ring_batch m_staging_batches[STAGING_RING_BATCH_CNT]{};
+
+	uint64_t m_staging_head{}; // Monotonic ring position at which the next allocation starts
+
+	uint64_t m_staging_tail{}; // Monotonic ring position of the oldest byte that may still be read by an in-flight batch
+
+	uint64_t m_staging_submitted_batch_cnt{};
+
+	uint64_t m_staging_retired_batch_cnt{};
+
+	bool m_staging_is_recording{};
+
+
+
+	struct profiler_frame
+	{
+		VkQueryPool query_pool;
+
+		uint32_t written_scope_cnt; // Begin- and end-timestamp pairs written since the pool was last reset
+
+		uint8_t scope_indices[PROFILER_MAX_FRAME_SCOPE_CNT]; // Named scope each written pair belongs to
+	};
+
+	struct profile_statistics
+	{
+		uint32_t sample_cnt; // Number of samples the statistics cover, at most PROFILER_HISTORY_CNT
+
+		float sum_ms;
+
+		float min_ms;
+
+		float avg_ms;
+
+		float p99_ms;
+	};
+
+	profiler_frame m_profiler_frames[PROFILER_MAX_FRAME_CNT]{};
+
+	uint32_t m_profiler_frame_cnt{};
+
+	float m_profiler_timestamp_ms{}; // Milliseconds per timestamp tick
+
+	uint32_t m_profiler_scope_cnt{};
+
+	char m_profiler_scope_names[PROFILER_MAX_SCOPE_CNT][PROFILER_MAX_SCOPE_NAME_CHARS]{};
+
+	uint64_t m_profiler_sample_cnts[PROFILER_MAX_SCOPE_CNT]{}; // Samples taken per scope so far, of which the last PROFILER_HISTORY_CNT are kept
+
+	heap_buffer<float> m_profiler_history; // Ring of PROFILER_HISTORY_CNT samples in milliseconds per scope, each the sum of the scope's time in one frame
+
+
+
 	void* m_message_pump_thread_handle{};
 
 	uint32_t m_message_pump_thread_id{};
@@ -375,6 +467,61 @@ struct vulkan_context
 
 	och::status create_images_with_views(uint32_t image_cnt, VkImageView* out_views, VkImage* out_images, VkDeviceMemory& out_memory, VkExtent3D extent, VkImageAspectFlags aspect, VkImageUsageFlags image_usage, VkImageType image_type, VkImageViewType view_type, VkFormat image_format, VkFormat view_format, VkMemoryPropertyFlags memory_properties, VkImageTiling image_tiling = VK_IMAGE_TILING_OPTIMAL, VkSharingMode sharing_mode = VK_SHARING_MODE_EXCLUSIVE, uint32_t queue_family_idx_cnt = 0, const uint32_t* queue_family_indices = nullptr) noexcept;
 
+	// Copies bytes from data into dst at dst_offset through the staging ring. The copy is recorded into the current batch
+	// and only executes once that batch is flushed.
+	och::status stage_buffer_upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize bytes) noexcept;
+
+	// Like stage_buffer_upload, but for an image region. region.bufferOffset is ignored, and bytes must fit into the ring at once.
+	och::status stage_image_upload(VkImage dst, VkImageLayout dst_layout, VkBufferImageCopy region, const void* data, VkDeviceSize bytes) noexcept;
+
+	// Submits all uploads staged since the last flush, optionally signalling semaphores on completion
+	och::status flush_staging_ring(uint32_t signal_semaphore_cnt = 0, const VkSemaphore* signal_semaphores = nullptr) noexcept;
+
+	// Flushes the ring and blocks until all uploads have completed
+	och::status wait_staging_ring_idle() noexcept;
+
+	och::status create_staging_ring(VkDeviceSize bytes) noexcept;
+
+	void destroy_staging_ring() const noexcept;
+
+	och::status allocate_staging_memory(VkDeviceSize bytes, VkDeviceSize& out_offset) noexcept;
+
+	och::status begin_staging_batch() noexcept;
+
+	och::status retire_staging_batches(bool wait_for_oldest) noexcept;
+
+	// Collects the timestamps last written for frame_index and resets its queries. Must be recorded before any scope of
+	// the frame, and only once the previous submission using frame_index has completed.
+	och::status begin_profiler_frame(VkCommandBuffer command_buffer, uint32_t frame_index) noexcept;
+
+	// Adds the timestamps last written for frame_index to the history of their scopes. Frames whose timestamps are not
+	// available yet are dropped.
+	och::status collect_profiler_frame(uint32_t frame_index) noexcept;
+
+	// Starts timing the scope called name, registering it on first use. Scopes of the same name are summed per frame.
+	// out_slot is passed on to end_profile_scope, and is ~0 if no profiler was created.
+	och::status begin_profile_scope(VkCommandBuffer command_buffer, uint32_t frame_index, const char* name, uint32_t& out_slot) noexcept;
+
+	void end_profile_scope(VkCommandBuffer command_buffer, uint32_t frame_index, uint32_t slot) const noexcept;
+
+	// Summarises the most recent samples of the scope_index'th registered scope, leaving out those taken before its
+	// first_sample'th one, so that measurements can be limited to a part of the run
+	profile_statistics get_profile_statistics(uint32_t scope_index, uint64_t first_sample = 0) const noexcept;
+
+	// Index of the registered scope called name, or ~0 if no scope of that name has been recorded yet
+	uint32_t find_profile_scope(const char* name) const noexcept;
+
+	// Milliseconds of the scope_index'th registered scope in the last collected frame that recorded it. Whether that
+	// sample is new can be told from m_profiler_sample_cnts.
+	float get_latest_profile_sample(uint32_t scope_index) const noexcept;
+
+	// Writes the statistics of every scope to filename, as JSON if it ends in ".json" and as CSV otherwise
+	och::status write_profile(const char* filename) const noexcept;
+
+	och::status create_profiler(uint32_t frame_cnt) noexcept;
+
+	void destroy_profiler() const noexcept;
+
 	och::status begin_message_processing() noexcept;
 
 	void end_message_processing() noexcept;